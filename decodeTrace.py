@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+#   This file is part of fastboot 3DS
+#   Copyright (C) 2017 derrek, profi200
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Prints the timeline and per phase totals of a boot trace.
+# Usage: decodeTrace.py fastboot3ds_trace.bin
+
+import struct
+import sys
+
+TRACE_VERSION = 1
+TRACE_ENTRIES = 256
+TRACE_END_FLAG = 0x8000
+TRACE_CPU_ARM9 = 9
+
+# Keep in sync with include/trace.h
+EVENTS = ["SYNC", "FS_MOUNT", "CONFIG_LOAD", "SPLASH", "FIRM_READ",
+          "FIRM_HASH", "FIRM_RSA", "LAUNCH"]
+POINT_EVENTS = (0, 7) # No begin/end pair
+
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<IHBBI")
+BUFFER_SIZE = HEADER.size + ENTRY.size * TRACE_ENTRIES
+
+
+def read_buffer(data):
+	magic, version, _, freq, count = HEADER.unpack_from(data)
+	if magic != b"FBTR" or version != TRACE_VERSION:
+		sys.exit("Not a trace buffer or unsupported version.")
+
+	# Oldest entry first
+	num = min(count, TRACE_ENTRIES)
+	first = count - num
+	entries = []
+	last = None
+	high = 0
+	for i in range(first, count):
+		time, event, cpu, _, arg = ENTRY.unpack_from(data, HEADER.size + ENTRY.size * (i % TRACE_ENTRIES))
+		if last is not None and time < last:
+			high += 1 << 32 # Counter wrapped
+		last = time
+		entries.append([high + time, event, cpu, arg])
+
+	if count > TRACE_ENTRIES:
+		print("Warning: %u old entries were overwritten." % (count - TRACE_ENTRIES))
+
+	# Align both CPUs on the PXI handshake
+	sync = next((e[0] for e in entries if e[1] == 0), None)
+	if sync is None:
+		print("Warning: No sync event. Timeline is not aligned.")
+		sync = entries[0][0] if entries else 0
+
+	for e in entries:
+		e[0] = (e[0] - sync) * 1000.0 / freq
+
+	return entries
+
+
+def event_name(event):
+	ev = event & ~TRACE_END_FLAG
+	return EVENTS[ev] if ev < len(EVENTS) else "EVENT_%u" % ev
+
+
+def cpu_name(cpu):
+	return "ARM9" if cpu == TRACE_CPU_ARM9 else "ARM11.%u" % cpu
+
+
+def main():
+	if len(sys.argv) != 2:
+		sys.exit("Usage: %s fastboot3ds_trace.bin" % sys.argv[0])
+
+	with open(sys.argv[1], "rb") as f:
+		data = f.read()
+	if len(data) != BUFFER_SIZE * 2:
+		sys.exit("Unexpected file size.")
+
+	# ARM11 buffer first, then ARM9
+	entries = read_buffer(data[:BUFFER_SIZE]) + read_buffer(data[BUFFER_SIZE:])
+	entries.sort(key=lambda e: e[0])
+
+	print("%10s  %-8s %-6s %-12s %s" % ("ms", "CPU", "", "EVENT", "ARG"))
+	open_phases = {}
+	totals = {}
+	for time, event, cpu, arg in entries:
+		name = event_name(event)
+		is_end = (event & TRACE_END_FLAG) != 0
+		is_point = event in POINT_EVENTS
+		kind = "end" if is_end else ("" if is_point else "begin")
+		signed_arg = arg - (1 << 32) if arg & 0x80000000 else arg
+		print("%10.3f  %-8s %-6s %-12s %d" % (time, cpu_name(cpu), kind, name, signed_arg))
+
+		key = (cpu, event & ~TRACE_END_FLAG)
+		if is_point:
+			continue
+		if not is_end:
+			open_phases.setdefault(key, []).append(time)
+		elif open_phases.get(key):
+			start = open_phases[key].pop()
+			total = totals.setdefault(key, [0, 0.0])
+			total[0] += 1
+			total[1] += time - start
+
+	print("\n%-8s %-12s %6s %10s" % ("CPU", "PHASE", "COUNT", "TOTAL ms"))
+	for (cpu, ev), (count, total) in sorted(totals.items(), key=lambda t: -t[1][1]):
+		print("%-8s %-12s %6u %10.3f" % (cpu_name(cpu), event_name(ev), count, total))
+
+
+if __name__ == "__main__":
+	main()
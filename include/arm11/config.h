@@ -50,6 +50,16 @@ enum Keys {
 
 	KSplashDuration,
 
+	KBootOption1PubKey,
+	KBootOption2PubKey,
+	KBootOption3PubKey,
+	KBootOption4PubKey,
+	KBootOption5PubKey,
+	KBootOption6PubKey,
+	KBootOption7PubKey,
+	KBootOption8PubKey,
+	KBootOption9PubKey,
+
 	/*
 	KBootOption1NandImage,
 	KBootOption2NandImage,
@@ -83,5 +93,7 @@ const char *configGetKeyText(int key);
 bool configSetKeyData(int key, const void *data);
 void configRestoreDefaults();
 bool configDeleteKey(int key);
+// Returns the first error of the last parse or NULL.
+const char *configGetParseError(u32 *line, u32 *column);
 bool configDevModeEnabled();
 bool configRamFirmBootEnabled();
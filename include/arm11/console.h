@@ -183,6 +183,21 @@ void consoleSetCursor(PrintConsole* console, int x, int y);
 
 void drawConsoleWindow(PrintConsole* console, int thickness, u8 colorIndex);
 
+/**
+ * @brief Rasterises all character cells changed since the last flush.
+ * Printing only updates the cell grid of the console's screen.
+ */
+void consoleFlush(void);
+
+/**
+ * @brief Forgets the cells covering pixel columns drawn outside of the console.
+ * Call consoleFlush() before drawing so pending cells don't end up on top.
+ * @param screen The screen that was drawn to.
+ * @param x First pixel column.
+ * @param width Number of pixel columns.
+ */
+void consoleInvalidate(u8 screen, int x, int width);
+
 u16 consoleGetRGB565Color(u8 colorIndex);
 
 ssize_t con_write(UNUSED struct _reent *r,UNUSED void *fd,const char *ptr, size_t len);
@@ -21,6 +21,17 @@
 #include "types.h"
 
 
+#define FIRM_PUBKEY_SIZE      (0x100) // RSA 2048 modulus, big endian
+
+// Keep in sync with arm9/firm.h
+#define FIRM_ERR_INVALID_SIG  (-17)   // RSA signature verification failed
+#define FIRM_ERR_PUBKEY_LOAD  (-18)   // Public key file missing or invalid
+
+
 
 s32 loadVerifyFirm(const char *const path, bool skipHashCheck);
+s32 loadVerifyFirmSigned(const char *const path, bool skipHashCheck, const u32 *const pubkey);
+// Starts loading the FIRM on ARM9 in the background. A later loadVerifyFirm()
+// with the same arguments picks up the result. Returns immediately.
+void preloadFirm(const char *const path, bool skipHashCheck, const u32 *const pubkey);
 noreturn void firmLaunch(void);
@@ -30,7 +30,33 @@
 #include "types.h"
 
 
+#define FMT_ZEROPAD   (1u<<0) //Pad with zero
+#define FMT_SIGN      (1u<<1) //Unsigned/signed long
+#define FMT_PLUS      (1u<<2) //Show plus
+#define FMT_SPACE     (1u<<3) //Spacer
+#define FMT_LEFT      (1u<<4) //Left justified
+#define FMT_HEX_PREP  (1u<<5) //0x
+#define FMT_UPPERCASE (1u<<6) //'ABCDEF'
 
+//Pre-parsed integer conversion for hot call sites. conv is one of 'd', 'u', 'x', 'X'
+//and width/precision are -1 if unused. Example: FMT_SPEC('X', FMT_ZEROPAD, 8, -1) is "%08X".
+#define FMT_SPEC(conv, flags, width, precision)                             \
+	{(flags) | ((conv) == 'd' ? FMT_SIGN : 0) | ((conv) == 'X' ? FMT_UPPERCASE : 0), \
+	 (conv) == 'x' || (conv) == 'X', (width), (precision)}
+
+
+typedef struct
+{
+	u8 flags;
+	bool isHex;
+	s16 width;
+	s16 precision;
+} FmtSpec;
+
+
+
+//Formats a single number without parsing a format string. Returns the length like ee_snprintf().
+u32 ee_fmtNumber(char *const buf, u32 size, u64 num, const FmtSpec *const spec);
 u32 ee_vsnprintf(char *const buf, u32 size, const char *const fmt, va_list arg);
 u32 ee_vsprintf(char *const buf, const char *const fmt, va_list arg);
 __attribute__ ((format (printf, 2, 3))) u32 ee_sprintf(char *const buf, const char *const fmt, ...);
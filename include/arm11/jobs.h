@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+// Fans a loop out to core 0 and every running worker core. Each core
+// works through its own share of the indices and steals half of another
+// core's remaining share when it runs out. Without worker cores
+// (Old 3DS with core 1 busy, stopped cores) the loop runs on core 0 only.
+// Jobs have the same restrictions as work items (see work.h).
+
+typedef void (*JobFunc)(void *arg, u32 index);
+
+
+
+/**
+ * @brief      Calls func(arg, index) for every index from 0 to count - 1 in
+ *             no particular order and returns when all calls are done.
+ *             Must only be called from core 0.
+ *
+ * @param[in]  func   The job function.
+ * @param      arg    The argument passed to every call.
+ * @param[in]  count  The number of indices.
+ */
+void jobsRun(JobFunc func, void *arg, u32 count);
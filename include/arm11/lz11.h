@@ -22,4 +22,20 @@
 
 
 
-void lz11Decompress(const void *in, void *out, u32 size);
+/**
+ * @brief      Bounds checked LZ11 decompressor (portable C). Writes the output
+ *             in runs of runSize bytes with each run starting stride bytes
+ *             after the previous one. This allows decompressing a rotated
+ *             image straight into a bigger framebuffer.
+ *
+ * @param[in]  in       The compressed stream without LZ11 header.
+ * @param[in]  inSize   The compressed stream size.
+ * @param      out      The output buffer.
+ * @param[in]  size     The decompressed size.
+ * @param[in]  runSize  The run size. Must not be 0.
+ * @param[in]  stride   The stride. Must be >= runSize.
+ *
+ * @return     Returns false on input overrun, output overrun or a
+ *             reference before the start of the output.
+ */
+bool lz11DecompressStrided(const void *in, u32 inSize, void *out, u32 size, u32 runSize, u32 stride);
@@ -28,3 +28,7 @@
 
 u8 readStoredBootslot(void);
 bool storeBootslot(u8 slot);
+// slot is zero based. Verifies the FIRM signature if the slot has a public key.
+s32 loadVerifyBootslot(u32 slot);
+// Starts loading the last loaded slot on ARM9. Needs only the SD card.
+bool preloadLastBootslot(void);
@@ -76,6 +76,7 @@
 
 #define DESC_UPDATE			"Update fastboot3ds. Only signed updates are allowed."
 #define DESC_CREDITS    	"Show fastboot3ds credits."
+#define DESC_PERF_COUNTERS	"Show SD, NAND, crypto and PXI counters since boot.\nPress A in the view to export them to " PERF_CSV_PATH "."
 
 // unused definitions below:
 #define LOREM "Lorem ipsum dolor sit amet, consetetur sadipscing elitr, sed diam nonumy eirmod tempor invidunt ut labore et dolore magna aliquyam erat, sed diam voluptua. At vero eos et accusam et justo duo dolores et ea rebum. Stet clita kasd gubergren, no sea takimata"
@@ -152,11 +153,18 @@ MenuInfo menu_fb3ds[] =
 		}
 	},
 	{ // 6
+#ifdef PERF_MENU
+		"Miscellaneous", 4, NULL, 0,
+#else
 		"Miscellaneous", 3, NULL, 0,
+#endif
 		{
 			{ "Update fastboot3DS",			DESC_UPDATE,				&menuUpdateFastboot3ds,	0 },
 			{ "Dump bootroms & OTP",		DESC_DUMP_BOOTROM,			&menuDumpBootrom,		0 },
-			{ "Credits",					DESC_CREDITS,				&menuShowCredits,		0 }
+			{ "Credits",					DESC_CREDITS,				&menuShowCredits,		0 },
+#ifdef PERF_MENU
+			{ "Hot path counters",			DESC_PERF_COUNTERS,			&menuShowPerfCounters,	0 }
+#endif
 		}
 	},
 	SUBMENU_SLOT_SETUP(1), // 7
@@ -25,6 +25,7 @@
 
 
 #define NAND_BACKUP_PATH	"sdmc:/3DS" // NAND backups standard path
+#define PERF_CSV_PATH		"sdmc:/fastboot3ds_perf.csv" // hot path counters export
 #define DEVICE_BUFSIZE		(((REG_CFG11_SOCINFO & 2) ? 1024 : 512) * 1024) // 1024 / 512 KiB
 #define PROGRESS_WIDTH		20
 #define SPLASH_DEFAULT_MSEC	1000
@@ -63,6 +64,9 @@ u32 menuInstallFirm(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuUpdateFastboot3ds(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuShowCredits(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
 u32 menuDumpBootrom(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
+#ifdef PERF_MENU
+u32 menuShowPerfCounters(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
+#endif
 
 // everything below has to go
 u32 menuDummyFunc(PrintConsole* term_con, PrintConsole* menu_con, u32 param);
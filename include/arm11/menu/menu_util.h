@@ -19,6 +19,7 @@
  */
  
 #include "types.h"
+#include "arm11/menu/splash.h"
 
 
 
@@ -36,10 +37,15 @@ u32 ee_printf_progress(const char *const fmt, u32 w, u64 curr, u64 max);
 
 void clearScreens(void);
 void drawTopBorder(void);
-bool drawCustomSplash(const char* folder);
+bool drawCustomSplash(const char* folder, SplashAnim* anims);
 
 void updateScreens(void);
 bool askConfirmation(const char *const fmt, ...);
 void outputEndWait(void);
 bool userCancelHandler(bool cancelAllowed);
+
+bool progressTaskStart(const char *const fmt, u32 w);
+void progressTaskUpdate(u64 curr, u64 max);
+void progressTaskStop(void);
+bool progressTaskCancelHandler(bool cancelAllowed);
 void sleepmode(void);
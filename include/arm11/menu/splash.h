@@ -24,9 +24,14 @@
 #define CSPLASH_NAME_TOP "splash"
 #define CSPLASH_NAME_SUB "splashbottom"
 
+#define SPLASH_CACHE_VERSION  (1)
+
 #define FLAG_ROTATED     (1u<<3)
 #define FLAG_COMPRESSED  (1u<<4)
 #define FLAG_SWAPPED     (1u<<5)
+#define FLAG_ANIMATED    (1u<<6)
+
+#define ANIM_FLAG_LOOP   (1u<<0)
 
 
 enum
@@ -45,7 +50,77 @@ typedef struct
 	u32 flags;
 } SplashHeader;
 
+// Animated splashes (FLAG_ANIMATED) continue with a SplashAnimHeader and
+// numFrames frames. Each frame is a SplashFrame followed by dataSize bytes of
+// rotated RGB565 columns, LZ11 compressed if FLAG_COMPRESSED is set.
+// Frame 0 must cover the whole image. Later frames only hold the columns
+// firstCol to firstCol + numCols - 1 that changed since the previous frame.
+typedef struct
+{
+	u16 numFrames;
+	u16 flags;
+} SplashAnimHeader;
+
+typedef struct
+{
+	u16 duration; // In milliseconds
+	u16 firstCol;
+	u16 numCols;
+	u16 reserved;
+	u32 dataSize;
+} SplashFrame;
+
+// Framebuffer ready copy of a drawn splash, stored next to the .spla file.
+// numCols full render buffer columns starting at firstCol follow the
+// header, which is padded to 1 sector so they can be read straight into
+// the render buffer.
+typedef struct
+{
+	u32 magic;        // "SPLC"
+	u16 version;
+	u8 screen;
+	u8 reserved0;
+	u32 srcSize;      // Size, FAT date/time and SHA-256 of the .spla file
+	u16 srcDate;
+	u16 srcTime;
+	u32 srcHash[8];
+	u32 imgHash[8];   // SHA-256 of the cached columns
+	u16 firstCol;
+	u16 numCols;
+	u32 reserved1[107];
+} SplashCacheHeader;
+
+// Playback state. Zero initialized it never draws anything.
+typedef struct
+{
+	const u8 *frames;  // First SplashFrame
+	u32 framesSize;
+	u32 pos;           // Offset of the next frame
+	u16 frame;         // Index of the next frame
+	u16 numFrames;
+	u16 animFlags;
+	u16 width;
+	u16 height;
+	u16 xx;            // Left image column on screen
+	u16 *fb;           // Top left image pixel in the render buffer
+	u32 screenHeight;
+	u32 nextVblank;    // VBlank count at which the next frame is due
+	u8 screen;
+	bool compressed;
+	void *buffer;      // Freed by splashAnimStop() if set by the caller
+} SplashAnim;
+
 
 
 void getSplashDimensions(const void *const data, u32 *const width, u32 *const height);
-bool drawSplashscreen(const void *const data, u16 *const tmpBuf, s32 startX, s32 startY, u8 screen);
+// Converts BGR888 pixels (Luma3DS .bin splash) to RGB565 on all available
+// cores. in and out must not overlap.
+void splashConvertRgb888(const u8 *const in, u16 *const out, u32 pixels);
+bool drawSplashscreen(const void *const data, u32 size, s32 startX, s32 startY, u8 screen);
+// Like drawSplashscreen() but keeps the state to play animated splashes.
+// data must stay valid until splashAnimStop().
+bool splashAnimStart(SplashAnim *const anim, const void *const data, u32 size, s32 startX, s32 startY, u8 screen);
+// Draws at most 1 frame if it is due at vblank. Returns true if a frame
+// was drawn and false if none was due, playback ended or the frame is corrupt.
+bool splashAnimUpdate(SplashAnim *const anim, u32 vblank);
+void splashAnimStop(SplashAnim *const anim);
@@ -22,6 +22,7 @@
 
 
 
+#ifdef _3DS
 static inline void spinlockLock(u32 *lock)
 {
 	u32 tmp;
@@ -43,3 +44,15 @@ static inline void spinlockUnlock(u32 *lock)
 	                 "sev"
 	                 : : "r" (0), "r" (lock) : "memory");
 }
+#else
+// Host builds
+static inline void spinlockLock(u32 *lock)
+{
+	while(__atomic_exchange_n(lock, 1u, __ATOMIC_ACQUIRE));
+}
+
+static inline void spinlockUnlock(u32 *lock)
+{
+	__atomic_store_n(lock, 0u, __ATOMIC_RELEASE);
+}
+#endif
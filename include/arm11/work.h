@@ -0,0 +1,108 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+// Work queue for cores 1-3. Any running worker core may pick up an item.
+// Work must not use I2C, PXI or anything else that waits for IRQs only
+// routed to core 0.
+
+typedef void (*WorkFunc)(void *arg);
+
+typedef struct
+{
+	WorkFunc func;
+	void *arg;
+	volatile bool done;
+} WorkItem;
+
+// Single message slot between cores. A new post replaces the old message.
+typedef struct
+{
+	u32 lock;
+	u32 seq;
+	u32 msg[4];
+} Mailbox;
+
+
+
+/**
+ * @brief      Work loop of the worker cores. Called by __systemInit() on
+ *             every core but core 0. Returns the core to boot11 when stopped.
+ */
+noreturn void workCoreMain(void);
+
+/**
+ * @brief      Returns the cores currently running the work loop.
+ *
+ * @return     The CPU mask. Each of the bits 1-3 stands for 1 core.
+ */
+u32 workGetCoreMask(void);
+
+/**
+ * @brief      Queues work for the worker cores.
+ *
+ * @param      item  The work item. Must stay valid until it is done.
+ *
+ * @return     Returns false if no worker core is running or the queue is full.
+ */
+bool workSubmit(WorkItem *item);
+
+/**
+ * @brief      Checks if submitted work is done without waiting.
+ *
+ * @param      item  The work item.
+ *
+ * @return     Returns true if the work is done.
+ */
+bool workIsDone(WorkItem *item);
+
+/**
+ * @brief      Waits until submitted work is done.
+ *
+ * @param      item  The work item.
+ */
+void workWait(WorkItem *item);
+
+/**
+ * @brief      Waits for the queued work and sends all worker cores back to
+ *             boot11. Must be called before launching a FIRM.
+ */
+void workStopCores(void);
+
+/**
+ * @brief      Posts a message, replacing any unread one.
+ *
+ * @param      mb    The mailbox.
+ * @param[in]  msg   The message.
+ */
+void mailboxPost(Mailbox *mb, const u32 msg[4]);
+
+/**
+ * @brief      Fetches the message if it is newer than the last one seen.
+ *
+ * @param      mb    The mailbox.
+ * @param      seq   Sequence number of the last message seen. Updated.
+ * @param      msg   The output message.
+ *
+ * @return     Returns true if there was a new message.
+ */
+bool mailboxFetch(Mailbox *mb, u32 *seq, u32 msg[4]);
@@ -37,3 +37,8 @@ typedef struct
 extern const dev_struct *dev_sdcard;
 extern const dev_struct *dev_rawnand;
 extern const dev_struct *dev_decnand;
+
+
+// Like dev_decnand->read_sector() but also feeds the decrypted
+// data to the SHA engine. SHA_start() must be called before.
+bool dev_decnand_read_sector_sha(u32 sector, u32 count, void *buf);
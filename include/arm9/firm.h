@@ -22,7 +22,15 @@
 #include "mem_map.h"
 
 
-#define FIRM_MAX_SIZE        (0x00400000)
+#define FIRM_MAX_SIZE           (0x00400000)
+#define FIRM_SIG_RSA_KEYSLOT    (3)
+#define FIRM_SIG_CACHE_KEYSLOT  (0x04) // Console unique NAND key, never readable
+#define FIRM_SIG_CACHE_ENTRIES  (8)
+#define FIRM_SIG_CACHE_MAGIC    (0x43475346u) // "FSGC"
+#define FIRM_PRELOAD_CHUNK      (0x20000) // Max time IPC commands wait for a preload step
+
+// Keep in sync with arm11/firm.h
+#define FIRM_ERR_INVALID_SIG    (-17) // RSA signature verification failed
 
 
 typedef struct
@@ -48,5 +56,16 @@ typedef struct
 
 
 bool firm_size(size_t *size, const firm_header *const hdr);
-s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode);
+bool verifyFirmSignature(const firm_header *const hdr, const u32 *const pubkey);
+// pubkey is an optional RSA 2048 modulus. If given the header signature is
+// verified in parallel to the section hashes.
+s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode, const u32 *const pubkey);
+// Speculative loading. The main loop runs the preload in steps with IRQs
+// disabled so IPC commands are still handled in between.
+void firmPreloadStart(const char *const path, bool skipHashCheck, const u32 *const pubkey);
+bool firmPreloadStep(void);
+// Finishes the preload and returns true if it matches and succeeded.
+// Anything else discards it.
+bool firmPreloadCommit(const char *const path, bool skipHashCheck, const u32 *const pubkey, s32 *const result);
+void firmPreloadDiscard(void);
 noreturn void firmLaunch(void);
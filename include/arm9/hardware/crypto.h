@@ -27,6 +27,7 @@
 //////////////////////////////////
 
 #define AES_MAX_BLOCKS        (0xFFFE) // Aligned for 32 bytes transfers
+#define AES_SHA_CHUNK_BLOCKS  (0x4000 / 16) // Decrypt/hash pipeline granularity. Multiple of 4.
 
 #define AES_WRITE_FIFO_COUNT  (REG_AESCNT & 0x1F)
 #define AES_READ_FIFO_COUNT   (REG_AESCNT & 0x3E0)
@@ -74,6 +75,12 @@ typedef struct
 	u32 aesParams;
 } AES_ctx;
 
+typedef struct
+{
+	AES_ctx ctx;    // The counter is the current stream position
+	u32 baseCtr[4]; // Counter at stream offset 0
+} AES_ctrStream;
+
 
 /**
  * @brief      Initializes the AES hardware and the NDMA channels used by it.
@@ -149,6 +156,48 @@ void AES_setCryptParams(AES_ctx *const ctx, u8 inEndianessOrder, u8 outEndianess
  */
 void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma);
 
+/**
+ * @brief      Initializes a CTR stream from a context with counter and crypt params set.
+ *
+ * @param      stream  Pointer to AES_ctrStream.
+ * @param[in]  ctx     Pointer to AES_ctx (AES context). Its counter is stream offset 0.
+ */
+void AES_ctrStreamInit(AES_ctrStream *const stream, const AES_ctx *const ctx);
+
+/**
+ * @brief      Sets the stream position without recalculating the counter from scratch.
+ *
+ * @param      stream  Pointer to AES_ctrStream.
+ * @param[in]  offset  Absolute byte offset. Must be a multiple of 16.
+ */
+void AES_ctrStreamSeek(AES_ctrStream *const stream, u64 offset);
+
+/**
+ * @brief      En-/decrypts data at the current stream position and advances it.
+ * @brief      With DMA any number of blocks is processed with a single NDMA setup.
+ *
+ * @param      stream  Pointer to AES_ctrStream.
+ * @param[in]  in      In data pointer. Can be the same as out.
+ * @param      out     Out data pointer. Can be the same as in.
+ * @param[in]  blocks  Number of blocks to process. 1 block is 16 bytes.
+ * @param[in]  dma     Set to true to enable DMA.
+ */
+void AES_ctrStreamCrypt(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks, bool dma);
+
+/**
+ * @brief      En-/decrypts data at the current stream position with DMA and
+ * @brief      hashes the output in the same pass. SHA_start() must be called
+ * @brief      before and SHA_finish() after. If blocks is not a multiple of 4
+ * @brief      no more data can be hashed afterwards.
+ * @brief      Note: The output buffer must be invalidated after this function.
+ *
+ * @param      stream  Pointer to AES_ctrStream.
+ * @param[in]  in      In data pointer. Can be the same as out.
+ * @param      out     Out data pointer. Can be the same as in.
+ * @param[in]  blocks  Number of blocks to process. 1 block is 16 bytes.
+ */
+void AES_ctrStreamCryptSha(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks);
+
 /**
  * @brief      En-/decrypts data with AES CBC.
  * @brief      Note: With DMA the output buffer must be invalidated
@@ -315,6 +364,33 @@ void RSA_selectKeyslot(u8 keyslot);
  */
 bool RSA_setKey2048(u8 keyslot, const u32 *const mod, u32 exp);
 
+/**
+ * @brief      Starts decrypting a RSA 2048 signature and returns immediately.
+ * @brief      The RSA engine raises IRQ_RSA once done. Collect the result
+ * @brief      with RSA_waitDecrypt2048().
+ *
+ * @param[in]  encSig  Pointer to encrypted source signature.
+ *
+ * @return     Returns true if the operation was started, false otherwise.
+ */
+bool RSA_decrypt2048Async(const u32 *const encSig);
+
+/**
+ * @brief      Checks if a RSA operation started with RSA_decrypt2048Async()
+ * @brief      is still running.
+ *
+ * @return     Returns true while the RSA engine is busy.
+ */
+bool RSA_isBusy(void);
+
+/**
+ * @brief      Waits for a RSA operation started with RSA_decrypt2048Async()
+ * @brief      to finish and copies the decrypted signature.
+ *
+ * @param      decSig  Pointer to decrypted destination signature.
+ */
+void RSA_waitDecrypt2048(u32 *const decSig);
+
 /**
  * @brief      Decrypts a RSA 2048 signature.
  *
@@ -325,8 +401,21 @@ bool RSA_setKey2048(u8 keyslot, const u32 *const mod, u32 exp);
  */
 bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig);
 
+/**
+ * @brief      Checks the padding of a decrypted RSA 2048 SHA 256 signature
+ * @brief      and compares the embedded hash.
+ * @brief      Note: This function skips the ASN.1 data and is therefore not safe.
+ *
+ * @param[in]  decSig  Pointer to the decrypted signature.
+ * @param[in]  hash    The big endian SHA 256 hash to compare against.
+ *
+ * @return     Returns true if the signature matches the hash, false otherwise.
+ */
+bool RSA_checkSigHash2048(const u32 *const decSig, const u32 hash[8]);
+
 /**
  * @brief      Verifies a RSA 2048 SHA 256 signature.
+ * @brief      The data is hashed while the RSA engine decrypts the signature.
  * @brief      Note: This function skips the ASN.1 data and is therefore not safe.
  *
  * @param[in]  encSig  Pointer to encrypted source signature.
@@ -86,6 +86,23 @@ u16 TIMER_getTicks(Timer timer);
  */
 u16 TIMER_stop(Timer timer);
 
+/**
+ * @brief      Starts a free running 32 bit counter made of 2 cascaded timers.
+ *
+ * @param[in]  timer      The low timer. The next timer is used too.
+ * @param[in]  prescaler  The prescaler to use.
+ */
+void TIMER_startCounter(Timer timer, TimerPrescaler prescaler);
+
+/**
+ * @brief      Returns the current value of a counter started with TIMER_startCounter().
+ *
+ * @param[in]  timer  The low timer of the counter.
+ *
+ * @return     The number of ticks.
+ */
+u32 TIMER_getCounter(Timer timer);
+
 /**
  * @brief      Halts the CPU for the specified number of milliseconds.
  *
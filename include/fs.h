@@ -18,6 +18,7 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
 #include "types.h"
 #include "fatfs/ff.h"
 
@@ -28,6 +29,13 @@
 #define FS_MAX_FILES    (3)
 #define FS_MAX_DIRS     (2)
 
+// fReadDirPacked() flags. The pattern only applies to files.
+#define FS_DIR_FILES_ONLY  (1u)
+#define FS_DIR_DIRS_ONLY   (2u)
+
+// Size of a packed dir record including padding to the next one
+#define FS_DIR_RECORD_SIZE(nameLen)  ((offsetof(FsDirRecord, name) + (nameLen) + 1 + 3) & ~3u)
+
 
 typedef enum
 {
@@ -55,6 +63,14 @@ typedef enum
 } FsOpenMode;
 
 typedef FILINFO FsFileInfo;
+
+typedef struct
+{
+	u32 fsize;
+	u8 fattrib;
+	u8 nameLen;  // Without the terminating zero
+	char name[]; // Zero terminated
+} FsDirRecord;
 typedef s32 DevHandle;
 typedef s32 DevBufHandle;
 
@@ -84,6 +100,7 @@ s32  fExpand(s32 handle, u32 size);
 s32  fStat(const char *const path, FsFileInfo *fi);
 s32  fOpenDir(const char *const path);
 s32  fReadDir(s32 handle, FsFileInfo *fi, u32 num);
+s32  fReadDirPacked(s32 handle, u32 offset, u32 flags, const char *const pattern, void *const buf, u32 bufSize);
 s32  fCloseDir(s32 handle);
 s32  fMkdir(const char *const path);
 s32  fRename(const char *const old, const char *const new);
@@ -93,4 +110,6 @@ s32  fSetNandProtection(bool protect);
 
 #ifdef ARM9
 void fsDeinit(void);
+#elif ARM11
+u32  fGetGeneration(void);
 #endif
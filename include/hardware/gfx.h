@@ -62,10 +62,22 @@ typedef enum
 void GX_memoryFill(u64 *buf0a, u32 buf0v, u32 buf0Sz, u32 val0, u64 *buf1a, u32 buf1v, u32 buf1Sz, u32 val1);
 void GX_displayTransfer(u64 *in, u32 indim, u64 *out, u32 outdim, u32 flags);
 void GX_textureCopy(u64 *in, u32 indim, u64 *out, u32 outdim, u32 size);
+// Same as GX_textureCopy() but waits until the copy is done.
+void GX_textureCopyWait(u64 *in, u32 indim, u64 *out, u32 outdim, u32 size);
 void GFX_setBrightness(u32 top, u32 sub);
 void* GFX_getFramebuffer(u8 screen);
 void GFX_swapFramebufs(void);
 void GFX_waitForEvent(GfxEvent event, bool discard);
+// Number of top screen VBlanks so far. Wraps around.
+u32 GFX_getVblankCount(void);
+// Render buffer columns changed since the last present. Clipped to the screen.
+void GFX_markRenderbufDirty(u8 screen, s32 x, s32 width);
+// Copies only the changed columns and swaps. Returns false without
+// swapping if nothing changed.
+bool GFX_presentRenderbufs(void);
+// Fills a render buffer range with the PSC fill engine and waits.
+// Returns false if the engine can't be used.
+bool GFX_fillRenderbuf(u8 screen, u32 offset, u32 size, u16 color);
 void GFX_init(bool clearScreens);
 void GFX_enterLowPowerState(void);
 void GFX_returnFromLowPowerState(void);
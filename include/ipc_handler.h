@@ -64,14 +64,18 @@ typedef enum
 	IPC_CMD9_FVERIFY_NAND_IMG    = MAKE_CMD(28, 1, 0, 0),
 	IPC_CMD9_FSET_NAND_PROT      = MAKE_CMD(29, 0, 0, 1),
 	IPC_CMD9_WRITE_FIRM_PART     = MAKE_CMD(30, 1, 0, 1),
-	IPC_CMD9_LOAD_VERIFY_FIRM    = MAKE_CMD(31, 1, 0, 1),
+	IPC_CMD9_LOAD_VERIFY_FIRM    = MAKE_CMD(31, 2, 0, 1),
 	IPC_CMD9_FIRM_LAUNCH         = MAKE_CMD(32, 0, 0, 0),
 	IPC_CMD9_LOAD_VERIFY_UPDATE  = MAKE_CMD(33, 1, 1, 0),
 	IPC_CMD9_GET_BOOT_ENV        = MAKE_CMD(34, 0, 0, 0),
 	IPC_CMD9_TOGGLE_SUPERHAX     = MAKE_CMD(35, 0, 0, 1),
 	IPC_CMD9_PREPARE_POWER       = MAKE_CMD(36, 0, 0, 0),
 	IPC_CMD9_PANIC               = MAKE_CMD(37, 0, 0, 0),
-	IPC_CMD9_EXCEPTION           = MAKE_CMD(38, 0, 0, 0)
+	IPC_CMD9_EXCEPTION           = MAKE_CMD(38, 0, 0, 0),
+	IPC_CMD9_PRELOAD_FIRM        = MAKE_CMD(39, 2, 0, 1),
+	IPC_CMD9_GET_TRACE           = MAKE_CMD(40, 0, 1, 0),
+	IPC_CMD9_GET_PERF            = MAKE_CMD(41, 0, 1, 0),
+	IPC_CMD9_FREAD_DIR_PACKED    = MAKE_CMD(42, 1, 1, 3)
 } IpcCmd9;
 
 typedef enum
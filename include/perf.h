@@ -0,0 +1,99 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#ifdef ARM9
+	#include "arm9/hardware/timer.h"
+#elif ARM11
+	#include "arm11/hardware/timer.h"
+	#include "arm11/hardware/performance_monitor.h"
+#endif
+
+
+// Always on hot path counters. Every CPU counts what it does itself.
+
+#define PERF_DEV_SD    (0u)
+#define PERF_DEV_NAND  (1u)
+
+#define PERF_COUNT(field, n)  (g_perfCounters.field += (n))
+
+
+typedef struct
+{
+	u32 tickFreq;       // Ticks per second of all *Ticks counters
+	u32 sdmmcCmds[2];   // Index is PERF_DEV_*
+	u64 sdmmcBytes[2];
+	u64 sdmmcTicks[2];  // Time spent in the controller
+	u64 aesBlocks;
+	u64 shaBytes;
+	u32 pxiCmds;        // Commands sent to the other CPU
+	u64 pxiWaitTicks;   // Time until the response arrived
+	u32 fatfsHits;      // Sector window already had the sector
+	u32 fatfsMisses;
+} PerfCounters;
+
+extern PerfCounters g_perfCounters;
+
+
+
+/**
+ * @brief      Starts the tick counter. Called by __systemInit().
+ */
+void perfInit(void);
+
+/**
+ * @brief      Returns the tick frequency for the current clock. On ARM9
+ *             timer 0 and 1 cascaded at the 64 prescaler. On ARM11 the core 0
+ *             cycle counter with the divide by 64 bit set which scales with
+ *             the New 3DS clock multiplier.
+ *
+ * @return     The ticks per second.
+ */
+u32 perfGetTickFreq(void);
+
+/**
+ * @brief      Returns the current tick count. Only valid on core 0 for ARM11.
+ *
+ * @return     The ticks. See perfGetTickFreq().
+ */
+static inline u32 perfGetTicks(void)
+{
+#ifdef ARM9
+	return TIMER_getCounter(TIMER_0);
+#elif ARM11
+	return getCcnt();
+#endif
+}
+
+/**
+ * @brief      Copies the counters of this CPU.
+ *
+ * @param      out   The output.
+ */
+void perfCopy(PerfCounters *const out);
+
+#ifdef ARM11
+/**
+ * @brief      Fetches the ARM9 counters.
+ *
+ * @param      out   The output.
+ */
+void perfGetArm9(PerfCounters *const out);
+#endif
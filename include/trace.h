@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+// Boot time tracing. Build with BOOT_TRACE=1 to enable it. Each CPU records
+// into its own ring buffer and ARM11 dumps both to TRACE_DUMP_PATH right
+// before launching a FIRM. decodeTrace.py prints the timeline.
+
+#define TRACE_DUMP_PATH    "sdmc:/fastboot3ds_trace.bin"
+#define TRACE_VERSION      (1u)
+#define TRACE_ENTRIES      (256u)        // Per CPU. The oldest entries are overwritten.
+#define TRACE_END_FLAG     (0x8000u)
+#define TRACE_ARG_ABORTED  (0x80000000u) // End arg of a span cut short
+#define TRACE_CPU_ARM9     (9u)          // ARM11 entries have the core number instead
+
+
+// Keep in sync with decodeTrace.py
+typedef enum
+{
+	TRACE_SYNC        = 0, // End of the PXI handshake. Same moment on both CPUs.
+	TRACE_FS_MOUNT    = 1, // arg: drive, result at the end
+	TRACE_CONFIG_LOAD = 2,
+	TRACE_SPLASH      = 3,
+	TRACE_FIRM_READ   = 4, // arg: FIRM size or error at the end
+	TRACE_FIRM_HASH   = 5, // SHA of all sections. arg: result at the end
+	TRACE_FIRM_RSA    = 6, // arg: result at the end
+	TRACE_LAUNCH      = 7
+} TraceEvent;
+
+typedef struct
+{
+	u32 time;  // In ticks of the recording CPU
+	u16 event; // TraceEvent, optionally with TRACE_END_FLAG
+	u8 cpu;
+	u8 reserved;
+	u32 arg;
+} TraceEntry;
+
+typedef struct
+{
+	u32 magic;    // "FBTR"
+	u16 version;
+	u16 reserved;
+	u32 tickFreq; // Ticks per second
+	u32 count;    // Number of entries ever recorded
+	TraceEntry entries[TRACE_ENTRIES];
+} TraceBuffer;
+
+
+
+#ifdef BOOT_TRACE
+#define TRACE_BEGIN(ev, arg)  traceEvent((ev), (arg))
+#define TRACE_END(ev, arg)    traceEvent((ev) | TRACE_END_FLAG, (arg))
+#define TRACE_POINT(ev, arg)  traceEvent((ev), (arg))
+
+/**
+ * @brief      Initializes the trace buffer. Called by __systemInit() after perfInit().
+ */
+void traceInit(void);
+
+/**
+ * @brief      Records an event. Use the TRACE_* macros instead. Events
+ * @brief      from ARM11 cores other than core 0 are dropped.
+ *
+ * @param[in]  event  The TraceEvent and flags.
+ * @param[in]  arg    Event specific argument.
+ */
+void traceEvent(u32 event, u32 arg);
+
+/**
+ * @brief      Copies the trace buffer of this CPU.
+ *
+ * @param      out   The output buffer.
+ */
+void traceCopy(TraceBuffer *const out);
+
+#ifdef ARM11
+/**
+ * @brief      Writes the trace buffers of both CPUs to TRACE_DUMP_PATH.
+ *
+ * @return     Returns true on success.
+ */
+bool traceDump(void);
+#endif
+
+#else
+#define TRACE_BEGIN(ev, arg)  ((void)0)
+#define TRACE_END(ev, arg)    ((void)0)
+#define TRACE_POINT(ev, arg)  ((void)0)
+#endif
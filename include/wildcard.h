@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+
+
+// Case insensitive (ASCII only) wildcard patterns. '*' matches any number
+// of chars, '?' exactly one.
+
+#define WILDCARD_MAX_LEN   (63u)
+#define WILDCARD_MAX_SEGS  (8u)
+
+
+typedef struct
+{
+	u8 numSegs;
+	u8 minLen;                        // Shortest name that can match
+	bool anchorStart;                 // Pattern doesn't start with '*'
+	bool anchorEnd;                   // Pattern doesn't end with '*'
+	u8 segStart[WILDCARD_MAX_SEGS];   // Literal segments between the '*'
+	u8 segLen[WILDCARD_MAX_SEGS];
+	char chars[WILDCARD_MAX_LEN + 1]; // Segments back to back in lower case
+} WildcardPattern;
+
+
+
+/**
+ * @brief      Compiles a pattern for wildcardMatch().
+ *
+ * @param      pat      The compiled pattern.
+ * @param[in]  pattern  The pattern string.
+ *
+ * @return     Returns false if the pattern is too long or has too many segments.
+ */
+bool wildcardCompile(WildcardPattern *const pat, const char *pattern);
+
+/**
+ * @brief      Matches a name against a compiled pattern. Linear in the name length
+ *             times the segment length, no backtracking.
+ *
+ * @param[in]  pat   The compiled pattern.
+ * @param[in]  name  The name.
+ *
+ * @return     Returns true if the whole name matches.
+ */
+bool wildcardMatch(const WildcardPattern *const pat, const char *const name);
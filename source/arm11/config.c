@@ -36,6 +36,8 @@
 static const char *SdmcFilepath = "sdmc:/boot/boot.cfg";
 static const char *NandFilepath = "sdmc:/boot/boot.cfg";
 
+static const char *SnapshotFilepath = "sdmc:/boot/boot.cfg.bin";
+
 static const char *filepath;
 
 typedef struct {
@@ -54,6 +56,9 @@ typedef struct {
 static void unloadConfigFile();
 static bool createConfigFile();
 static bool parseConfigFile();
+static bool loadConfigSnapshot(const FILINFO *textStat);
+static void writeConfigSnapshot();
+static u32 fnv1a(const void *data, u32 len);
 static bool parsePath(AttributeEntryType *attr);
 static bool writePath(AttributeEntryType *attr, const void *newData, int key);
 static bool parseBootOptionPad(AttributeEntryType *attr);
@@ -92,7 +97,17 @@ static const char *keyStrings[] = {
 	"DEV_MODE",
 	"RAM_FIRM_BOOT",
 
-	"SPLASH_DURATION"
+	"SPLASH_DURATION",
+
+	"BOOT_OPTION1_PUBKEY",
+	"BOOT_OPTION2_PUBKEY",
+	"BOOT_OPTION3_PUBKEY",
+	"BOOT_OPTION4_PUBKEY",
+	"BOOT_OPTION5_PUBKEY",
+	"BOOT_OPTION6_PUBKEY",
+	"BOOT_OPTION7_PUBKEY",
+	"BOOT_OPTION8_PUBKEY",
+	"BOOT_OPTION9_PUBKEY"
 	
 	/*
 	"BOOT_OPTION1_NAND_IMAGE",
@@ -103,6 +118,59 @@ static const char *keyStrings[] = {
 
 static AttributeEntryType attributes[numKeys];
 
+/*	Copy of the config with its parse results, written next to the
+	text file. Layout: header, one entry per key, the native data of
+	all keys with data in key order, then the text. It belongs to the
+	text file as long as size and modification time in the directory
+	entry match, so booting reads the snapshot only. The first parse
+	error is kept as well to still report it on later boots.	*/
+#define SNAPSHOT_VERSION	3
+
+typedef struct {
+	u32 magic;		// "FBCS"
+	u16 version;
+	u16 numEntries;
+	u32 textSize;
+	u16 textDate;	// FAT modification date and time of the text file
+	u16 textTime;
+	u32 errLine;
+	u16 errColumn;
+	u16 errMsg;		// index into parseErrorMsgs, 0 if none
+	u32 checksum;	// FNV-1a of everything after the header
+} SnapshotHeader;
+
+typedef struct {
+	u16 textOffset;
+	u16 textLength;
+	u16 dataSize;	// 0 if the key has no data
+	u16 hasText;
+} SnapshotEntry;
+
+#define KEY_LOOKUP_SIZE	64	// power of 2, at least twice numKeys
+
+static s8 keyLookup[KEY_LOOKUP_SIZE];
+static bool keyLookupReady = false;
+
+enum ParseErrors {
+	ParseErrNone = 0,
+	ParseErrUnknownKey,
+	ParseErrInvalidValue,
+	ParseErrExpectedEq
+};
+
+static const char *parseErrorMsgs[] = {
+	NULL,
+	"Unknown key",
+	"Invalid value",
+	"Expected '='"
+};
+
+static struct {
+	u32 line;
+	u32 column;
+	u32 msg;	// one of ParseErrors
+} parseError;
+
 static char *filebuf = NULL;
 
 static bool configLoaded = false;
@@ -120,6 +188,8 @@ static const FunctionsEntryType *getKeyFunctions(int key)
 	
 	if(key <= KSplashScreen && key >= KBootOption1)
 		return &keyFunctions[0];
+	if(key <= KBootOption9PubKey && key >= KBootOption1PubKey)
+		return &keyFunctions[0];
 	if(key <= KBootOption9Buttons && key >= KBootOption1Buttons)
 		return &keyFunctions[1];
 	if(key == KBootMode)
@@ -212,6 +282,10 @@ bool loadConfigFile()
 		return false;
 	}
 	
+	// an up to date snapshot has the text and its parse results
+	if(!createFile && !adpotChanges && loadConfigSnapshot(&fileStat))
+		return true;
+	
 	if(fileSize)
 	{
 		if((file = fOpen(filepath, FS_OPEN_READ)) < 0)
@@ -242,6 +316,7 @@ bool loadConfigFile()
 		filepath = SdmcFilepath;
 		configDirty = true;
 	}
+	else writeConfigSnapshot();
 	
 	return true;
 	
@@ -342,6 +417,8 @@ bool writeConfigFile()
 
 	fClose(file);
 	
+	writeConfigSnapshot();
+	
 	return true;
 	
 fail:
@@ -349,6 +426,199 @@ fail:
 	return false;
 }
 
+/* size of a key's native data, see the parse functions */
+static u32 getKeyDataSize(int key)
+{
+	const void *data = attributes[key].data;
+	const FunctionsEntryType *keyFunc = getKeyFunctions(key);
+	
+	if(!data || !keyFunc)
+		return 0;
+	
+	if(keyFunc->parse == parsePath)
+		return strlen((const char *)data) + 1;
+	if(keyFunc->parse == parseBool)
+		return sizeof(bool);
+	
+	return sizeof(u32);
+}
+
+/* The snapshot is only ever an optimization, it is */
+/* removed whenever it can't be written completely. */
+static void writeConfigSnapshot()
+{
+	SnapshotHeader header;
+	SnapshotEntry entries[numKeys];
+	FILINFO textStat;
+	u32 checksum;
+	u32 dataSize = 0;
+	s32 file;
+	
+	if(!configLoaded || !filebuf || filepath != SdmcFilepath)
+		return;
+	
+	const u32 textSize = strlen(filebuf);
+	
+	// the text file must hold exactly what was parsed
+	if(fStat(filepath, &textStat) != FR_OK || textStat.fsize != textSize)
+		goto fail;
+	
+	for(int key=0; key<numKeys; key++)
+	{
+		const AttributeEntryType *attr = &attributes[key];
+		
+		entries[key].hasText = attr->textData != NULL;
+		entries[key].textOffset = attr->textData ? attr->textData - filebuf : 0;
+		entries[key].textLength = attr->textLength;
+		entries[key].dataSize = getKeyDataSize(key);
+		dataSize += entries[key].dataSize;
+	}
+	
+	u8 *buf = (u8 *) malloc(sizeof entries + dataSize + textSize);
+	if(!buf)
+		goto fail;
+	
+	u8 *p = buf;
+	memcpy(p, entries, sizeof entries);
+	p += sizeof entries;
+	for(int key=0; key<numKeys; key++)
+	{
+		if(!entries[key].dataSize)
+			continue;
+		memcpy(p, attributes[key].data, entries[key].dataSize);
+		p += entries[key].dataSize;
+	}
+	memcpy(p, filebuf, textSize);
+	p += textSize;
+	checksum = fnv1a(buf, p - buf);
+	
+	memcpy(&header.magic, "FBCS", 4);
+	header.version = SNAPSHOT_VERSION;
+	header.numEntries = numKeys;
+	header.textSize = textSize;
+	header.textDate = textStat.fdate;
+	header.textTime = textStat.ftime;
+	header.errLine = parseError.line;
+	header.errColumn = parseError.column;
+	header.errMsg = parseError.msg;
+	header.checksum = checksum;
+	
+	bool ok = false;
+	if((file = fOpen(SnapshotFilepath, FS_CREATE_ALWAYS | FS_OPEN_WRITE)) >= 0)
+	{
+		ok = (fWrite(file, &header, sizeof header) == FR_OK) &&
+			(fWrite(file, buf, p - buf) == FR_OK) &&
+			(fSync(file) == FR_OK);
+		fClose(file);
+	}
+	free(buf);
+	
+	if(ok)
+		return;
+	
+fail:
+	
+	fUnlink(SnapshotFilepath);
+}
+
+/* Loads text and parse results from the snapshot with a single */
+/* read if it belongs to the text file described by textStat. */
+static bool loadConfigSnapshot(const FILINFO *textStat)
+{
+	const SnapshotHeader *header;
+	const SnapshotEntry *entries;
+	s32 file;
+	u32 size;
+	u8 *buf = NULL;
+	
+	if(filepath != SdmcFilepath)
+		return false;
+	
+	if((file = fOpen(SnapshotFilepath, FS_OPEN_READ)) < 0)
+		return false;
+	
+	// the native data is never bigger than the text it came from
+	size = fSize(file);
+	if(size < sizeof(SnapshotHeader) + sizeof(SnapshotEntry[numKeys]) ||
+		size > sizeof(SnapshotHeader) + sizeof(SnapshotEntry[numKeys]) + 2 * (MAX_FILE_SIZE + 1) ||
+		!(buf = (u8 *) malloc(size)) ||
+		fRead(file, buf, size) != FR_OK)
+	{
+		fClose(file);
+		goto fail;
+	}
+	fClose(file);
+	
+	header = (const SnapshotHeader *)buf;
+	entries = (const SnapshotEntry *)(buf + sizeof(SnapshotHeader));
+	const u8 *data = (const u8 *)&entries[numKeys];
+	const u8 *end = buf + size;
+	const u32 textSize = header->textSize;
+	
+	if(memcmp(&header->magic, "FBCS", 4) != 0 || header->version != SNAPSHOT_VERSION ||
+		header->numEntries != (u16)numKeys || textSize != textStat->fsize ||
+		textSize > MAX_FILE_SIZE || textSize > (u32)(end - data) ||
+		header->textDate != textStat->fdate || header->textTime != textStat->ftime ||
+		header->errMsg >= arrayEntries(parseErrorMsgs) ||
+		header->checksum != fnv1a(entries, end - (const u8 *)entries))
+		goto fail;
+	
+	// the text is at the end, the native data in front of it
+	end -= textSize;
+	memcpy(filebuf, end, textSize);
+	filebuf[textSize] = '\0';
+	
+	memset(attributes, 0, sizeof attributes);
+	
+	for(int key=0; key<numKeys; key++)
+	{
+		const SnapshotEntry *entry = &entries[key];
+		AttributeEntryType *attr = &attributes[key];
+		
+		if(entry->hasText)
+		{
+			if((u32)entry->textOffset + entry->textLength > textSize)
+				goto fail;
+			attr->textData = filebuf + entry->textOffset;
+			attr->textLength = entry->textLength;
+		}
+		
+		if(entry->dataSize)
+		{
+			if(entry->dataSize > (u32)(end - data))
+				goto fail;
+			if(!(attr->data = malloc(entry->dataSize)))
+				goto fail;
+			memcpy(attr->data, data, entry->dataSize);
+			data += entry->dataSize;
+		}
+	}
+	
+	parseError.line = header->errLine;
+	parseError.column = header->errColumn;
+	parseError.msg = header->errMsg;
+	
+	free(buf);
+	configLoaded = true;
+	
+	return true;
+	
+fail:
+	
+	if(buf)
+		free(buf);
+	
+	// the text file gets read and parsed instead
+	for(int key=0; key<numKeys; key++)
+	{
+		if(attributes[key].data)
+			free(attributes[key].data);
+	}
+	memset(attributes, 0, sizeof attributes);
+	
+	return false;
+}
+
 static bool createConfigFile()
 {
 	// set default settings for new config files
@@ -377,147 +647,136 @@ static inline bool isEOL(const char c)
 	return false;
 }
 
-/* returns the start of an attribute's data */
-/* or NULL when no next definition was found. */
-static char *findNextDefinition(char **curp, int *key)
+static inline bool isKeyChar(const char c)
 {
-	int keyIdx;
-	char *cur;
-	bool keyFound;
-	size_t keyLen;
-	char *start = NULL;
+	return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-	for(cur = *curp; *cur != '\0'; )
+/* FNV-1a */
+static u32 fnv1a(const void *data, u32 len)
+{
+	const u8 *p = (const u8 *)data;
+	u32 hash = 2166136261u;
+	
+	for(u32 i=0; i<len; i++)
 	{
-		// match key
-		keyFound = false;
-		keyLen = 0;
-		for(int i=0; i<numKeys; i++)
-		{
-			size_t curLen = strlen(keyStrings[i]);
-
-			if(strncmp(cur, keyStrings[i], curLen) == 0)
-			{
-				// find the longest matching sequence
-				if(curLen > keyLen)
-				{
-					keyIdx = i;
-					keyLen = curLen;
-				}
-				keyFound = true;
-			}
-		}
-
-		if(keyFound)
-		{
-			cur += keyLen;
-
-			/* verify definition */
-
-			while(*cur == ' ') cur++;
-			
-			if(*cur != '=')
-				start = NULL;
-			else
-			{
-				cur++;
-				while(*cur == ' ') cur++;
-				start = cur;
-			}
-		}
-
-		// advance the current pointer to a new line
-		while(*cur != '\0')
-		{
-			if(isEOL(*cur))
-			{
-				cur++;
-				break;
-			}
-			cur++;
-		}
-
-		// update cur ptr
-		*curp = cur;
-
-		// found a definition? Return it.
-		if(start)
-		{
-			*key = keyIdx;
-			return start;
-		}
+		hash ^= p[i];
+		hash *= 16777619u;
 	}
-
-	// no more definitions found
-	return NULL;
+	
+	return hash;
 }
 
-/* returns the length of an attribute's data. */
-static u32 parseDefinition(char *attrData)
+/* open addressing table of key indices, built once from keyStrings */
+static void initKeyLookup()
 {
-	u32 len = 0;
-	char *cur = attrData;
-	char c;
+	memset(keyLookup, -1, sizeof keyLookup);
 	
-	if(!attrData)
-		return 0;
+	for(int key=0; key<numKeys; key++)
+	{
+		u32 i = fnv1a(keyStrings[key], strlen(keyStrings[key]));
+		
+		while(keyLookup[i % KEY_LOOKUP_SIZE] >= 0)
+			i++;
+		keyLookup[i % KEY_LOOKUP_SIZE] = key;
+	}
 	
-	// look for linebreaks that mark the end of a definition
-	for(; (c = *cur) != '\0'; cur++)
+	keyLookupReady = true;
+}
+
+/* returns the key named by the len chars at name or -1 */
+static int lookupKey(const char *name, u32 len)
+{
+	int key;
+	
+	for(u32 i = fnv1a(name, len); (key = keyLookup[i % KEY_LOOKUP_SIZE]) >= 0; i++)
 	{
-		if(isEOL(c))
-			break;
-		len ++;
-		c = *cur;
+		if(strncmp(keyStrings[key], name, len) == 0 && keyStrings[key][len] == '\0')
+			return key;
 	}
 	
-	return len;
+	return -1;
 }
 
+/* only the first error is kept */
+static void setParseError(u32 line, u32 column, u32 msg)
+{
+	if(parseError.msg)
+		return;
+	
+	parseError.line = line;
+	parseError.column = column;
+	parseError.msg = msg;
+}
+
+/* Parses the whole file in one pass. Every line is split into a key */
+/* token and its data, the key is looked up by hash and its data */
+/* converted right away. Lines without definition are ignored. */
 static bool parseConfigFile()
 {
 	AttributeEntryType *curAttr;
 	const FunctionsEntryType *keyFunc;
-	u32 len;
-	char *curp;
-	char *text;
-	int i = 0;
+	char *cur = filebuf;
+	u32 line = 1;
+	
+	if(!keyLookupReady)
+		initKeyLookup();
 	
-	// pass #0: pre-initialize attributes
 	memset(attributes, 0, sizeof attributes);
-
-	// pass #1: look for definitions and populate our lookup table.
-	curp = filebuf;
-	while((text = findNextDefinition(&curp, &i)) != NULL)
-	{
-		curAttr = &attributes[i];
-		if(curAttr->textData)
-			continue;	// key was already parsed
-		curAttr->textData = text;
-		if(!text)
-		{
-			curAttr->textLength = 0;
-			continue;
-		}
-		len = parseDefinition(text);
-		curAttr->textLength = len;
-	}
+	memset(&parseError, 0, sizeof parseError);
 	
-	// pass #2: parse text-data and convert it into a native form
-	for(i=0; i<numKeys; i++)
+	while(*cur != '\0')
 	{
-		curAttr = &attributes[i];
-		if(!curAttr->textData)
+		char *lineStart = cur;
+		bool keyLike = true;
+		
+		// key token
+		for(; *cur != '\0' && *cur != ' ' && *cur != '=' && !isEOL(*cur); cur++)
+			keyLike &= isKeyChar(*cur);
+		const u32 keyLen = cur - lineStart;
+		const int key = (keyLen && keyLike) ? lookupKey(lineStart, keyLen) : -1;
+		
+		while(*cur == ' ') cur++;
+		
+		if(keyLen && *cur == '=')
 		{
-			curAttr->data = NULL;
-			continue;
+			cur++;
+			while(*cur == ' ') cur++;
+			
+			char *text = cur;
+			while(*cur != '\0' && !isEOL(*cur)) cur++;
+			
+			if(key < 0)
+			{
+				if(keyLike)
+					setParseError(line, 1, ParseErrUnknownKey);
+			}
+			else if(!attributes[key].textData)	// first definition wins
+			{
+				curAttr = &attributes[key];
+				curAttr->textData = text;
+				curAttr->textLength = cur - text;
+				
+				keyFunc = getKeyFunctions(key);
+				if(keyFunc && keyFunc->parse)
+				{
+					if(!keyFunc->parse(curAttr))
+						setParseError(line, text - lineStart + 1, ParseErrInvalidValue);
+				}
+				else curAttr->data = NULL;
+			}
 		}
-		else
+		else if(key >= 0)
+			setParseError(line, cur - lineStart + 1, ParseErrExpectedEq);
+		
+		// advance to the next line
+		while(*cur != '\0' && !isEOL(*cur)) cur++;
+		if(*cur != '\0')
 		{
-			keyFunc = getKeyFunctions(i);
-			if(keyFunc && keyFunc->parse)
-				keyFunc->parse(curAttr);
-			else curAttr->data = NULL;
+			if(cur[0] == 0x0D && cur[1] == 0x0A)
+				cur++;
+			cur++;
+			line++;
 		}
 	}
 	
@@ -1148,6 +1407,17 @@ static inline bool safeReadBoolKey(int key)
 	return true;
 }
 
+const char *configGetParseError(u32 *line, u32 *column)
+{
+	if(!configLoaded || !parseError.msg)
+		return NULL;
+	
+	if(line) *line = parseError.line;
+	if(column) *column = parseError.column;
+	
+	return parseErrorMsgs[parseError.msg];
+}
+
 bool configDevModeEnabled()
 {
 	return safeReadBoolKey(KDevMode);
@@ -11,6 +11,7 @@
 #include "hardware/gfx.h"
 #include "util.h"
 #include "arm11/console.h"
+#include "arm11/spinlock.h"
 
 #include "arm11/font_6x10.h"
 
@@ -78,6 +79,43 @@ PrintConsole* consoleGetDefault(void){return &defaultConsole;}
 void consolePrintChar(int c);
 void consoleDrawChar(int c);
 
+static bool consoleGetBlankCell(u32 *cell);
+static void consoleFillCells(int cx, int cy, int cw, int ch, u32 cell);
+static void consoleScrollCells(void);
+static void consoleFlushCells(void);
+static void consoleInvalidateCells(u8 screen, int x, int width);
+
+// Retained cell grids, one per screen since console windows on the same
+// screen can overlap. Printing only updates the wanted cells and
+// consoleFlush() rasterises the ones that differ from the drawn cells.
+// A cell is the glyph index, fg and bg palette indices and attributes.
+#define CELL_COLS        (SCREEN_WIDTH_TOP / 6)
+#define CELL_ROWS        (SCREEN_HEIGHT_TOP / 10)
+#define CELL_UNDERLINE   (1u<<24)
+#define CELL_CROSSED_OUT (1u<<25)
+#define CELL_VALID       (1u<<31) // Zero cells are pixels the console doesn't own
+
+// Core 1 draws progress lines while core 0 may print. Printing, flushing
+// and invalidating take this lock so they never interleave.
+static u32 consoleLock = 0;
+
+static u32 cellsWanted[2][CELL_ROWS][CELL_COLS];
+static u32 cellsDrawn[2][CELL_ROWS][CELL_COLS];
+static u32 cellsPendingRows[2];
+static const u8 *cellsFont[2];
+
+static u8 consoleGetScreen(PrintConsole* console) {
+	return (console->frameBuffer == (u16*)RENDERBUF_TOP ? SCREEN_TOP : SCREEN_SUB);
+}
+
+static int consoleGetCellCols(u8 screen) {
+	return (screen == SCREEN_TOP ? SCREEN_WIDTH_TOP : SCREEN_WIDTH_SUB) / 6;
+}
+
+static void consoleMarkDirty(PrintConsole* console, int x, int width) {
+	GFX_markRenderbufDirty(consoleGetScreen(console), x, width);
+}
+
 //---------------------------------------------------------------------------------
 static void consoleCls(char mode) {
 //---------------------------------------------------------------------------------
@@ -117,6 +155,14 @@ static void consoleCls(char mode) {
 		}
 	case '2':
 		{
+			u32 cell;
+			if(consoleGetBlankCell(&cell)) {
+				consoleFillCells(0, 0, currentConsole->windowWidth, currentConsole->windowHeight, cell);
+				currentConsole->cursorY  = 0;
+				currentConsole->cursorX  = 0;
+				break;
+			}
+
 			currentConsole->cursorY  = 0;
 			currentConsole->cursorX  = 0;
 
@@ -168,6 +214,12 @@ static void consoleClearLine(char mode) {
 		}
 	case '2':
 		{
+			u32 cell;
+			if(consoleGetBlankCell(&cell)) {
+				consoleFillCells(0, currentConsole->cursorY, currentConsole->windowWidth, 1, cell);
+				break;
+			}
+
 			colTemp = currentConsole->cursorX ;
 
 			currentConsole->cursorX  = 0;
@@ -241,6 +293,8 @@ ssize_t con_write(UNUSED struct _reent *r,UNUSED void *fd,const char *ptr, size_
 
 	if(!tmp || (int)len<=0) return -1;
 
+	spinlockLock(&consoleLock);
+
 	i = 0;
 
 	while(i<(int)len) {
@@ -509,6 +563,8 @@ ssize_t con_write(UNUSED struct _reent *r,UNUSED void *fd,const char *ptr, size_
 		consolePrintChar(chr);
 	}
 
+	spinlockUnlock(&consoleLock);
+
 	return count;
 }
 
@@ -534,7 +590,11 @@ PrintConsole* consoleInit(int screen, PrintConsole* console, bool clear) {
 	else console->frameBuffer = (u16*)RENDERBUF_SUB;
 
 
-	if(clear) consoleCls('2');
+	if(clear) {
+		spinlockLock(&consoleLock);
+		consoleCls('2');
+		spinlockUnlock(&consoleLock);
+	}
 
 	return currentConsole;
 
@@ -580,30 +640,59 @@ static void newRow() {
 
 	if(currentConsole->cursorY  >= currentConsole->windowHeight)  {
 		currentConsole->cursorY --;
-		u16 *dst = &currentConsole->frameBuffer[(currentConsole->windowX * 6 * 240) + (239 - (currentConsole->windowY * 10))];
-		u16 *src = dst - 10;
-
-		int i,j;
-
-		for (i=0; i<currentConsole->windowWidth*6; i++) {
-			u32 *from = (u32*)((int)src & ~3);
-			u32 *to = (u32*)((int)dst & ~3);
-			for (j=0;j<(((currentConsole->windowHeight-1)*10)/2);j++) *(to--) = *(from--);
-			dst += 240;
-			src += 240;
+		// Move everything but the last line of each window column up
+		// by one text line. The transfer engines need 8 byte aligned
+		// addresses so this 20 byte move stays on the CPU. The cell
+		// grids move along so they still describe the pixels.
+		const int rowPixels = (currentConsole->windowHeight - 1) * 10;
+		u16 *col = &currentConsole->frameBuffer[(currentConsole->windowX * 6 * 240) +
+		                                        (240 - ((currentConsole->windowY + currentConsole->windowHeight) * 10))];
+
+		for (int i=0; i<currentConsole->windowWidth*6; i++) {
+			memmove(col + 10, col, rowPixels * 2);
+			col += 240;
 		}
 
+		consoleMarkDirty(currentConsole, currentConsole->windowX * 6, currentConsole->windowWidth * 6);
+		consoleScrollCells();
 		consoleClearLine('2');
 	}
 }
-//---------------------------------------------------------------------------------
-void consoleDrawChar(int c) {
-//---------------------------------------------------------------------------------
-	c -= currentConsole->font.asciiOffset;
-	if ( c < 0 || c > currentConsole->font.numChars ) return;
+// Column masks of the glyphs in the current font. Bit 0 is the bottom pixel.
+static const u8 *glyphCacheFont;
+static u16 glyphColumns[256][6];
+static u32 glyphCached[256 / 32];
+
+// fg/bg pixel pairs for all 2 bit column mask values. First pixel in the low half.
+static u16 pairFg = 0, pairBg = 0;
+static u32 pairTable[4] = {0, 0, 0, 0};
+
+static void expandGlyphColumns(const u8 *fontdata, u16 cols[6]) {
+	for (int i=0;i<6;i++) {
+		const u8 mask = 0x80>>i;
+		u16 col = 0;
+		for (int row=0;row<10;row++) {
+			if (fontdata[row] & mask) col |= 1u<<(9 - row);
+		}
+		cols[i] = col;
+	}
+}
+
+static const u16* getGlyphColumns(const u8 *font, int c) {
+	if (glyphCacheFont != font) {
+		glyphCacheFont = font;
+		memset(glyphCached, 0, sizeof(glyphCached));
+	}
+
+	if (!(glyphCached[c / 32] & 1u<<(c % 32))) {
+		expandGlyphColumns(font + (10 * c), glyphColumns[c]);
+		glyphCached[c / 32] |= 1u<<(c % 32);
+	}
 
-	const u8 *fontdata = currentConsole->font.gfx + (10 * c);
+	return glyphColumns[c];
+}
 
+static u32 consoleMakeCell(int c) {
 	int writingColor = currentConsole->fg;
 	int screenColor = currentConsole->bg;
 
@@ -619,49 +708,227 @@ void consoleDrawChar(int c) {
 		screenColor = tmp;
 	}
 
-	u16 bg = colorTable[screenColor];
-	u16 fg = colorTable[writingColor];
+	u32 cell = CELL_VALID | (u32)screenColor<<16 | (u32)writingColor<<8 | (u32)c;
+	if (currentConsole->flags & CONSOLE_UNDERLINE) cell |= CELL_UNDERLINE;
+	if (currentConsole->flags & CONSOLE_CROSSED_OUT) cell |= CELL_CROSSED_OUT;
+	return cell;
+}
+
+// Cells only store the glyph index. On a font switch the pixels of the
+// old font are left alone and handed over to the framebuffer.
+static void consoleCheckCellFont(u8 screen) {
+	if (cellsFont[screen] == currentConsole->font.gfx) return;
+
+	consoleFlushCells();
+	memset(cellsWanted[screen], 0, sizeof(cellsWanted[screen]));
+	memset(cellsDrawn[screen], 0, sizeof(cellsDrawn[screen]));
+	cellsFont[screen] = currentConsole->font.gfx;
+}
+
+// Clears write the space glyph straight into the cell grid unless a
+// PrintChar callback wants to see every character.
+static bool consoleGetBlankCell(u32 *cell) {
+	if (currentConsole->PrintChar) return false;
 
-	u8 b1 = *(fontdata++);
-	u8 b2 = *(fontdata++);
-	u8 b3 = *(fontdata++);
-	u8 b4 = *(fontdata++);
-	u8 b5 = *(fontdata++);
-	u8 b6 = *(fontdata++);
-	u8 b7 = *(fontdata++);
-	u8 b8 = *(fontdata++);
-	u8 b9 = *(fontdata++);
-	u8 b10 = *(fontdata++);
+	int c = ' ' - currentConsole->font.asciiOffset;
+	if ( c < 0 || c >= currentConsole->font.numChars || c > 0xFF ) return false;
 
-	if (currentConsole->flags & CONSOLE_UNDERLINE) b10 = 0xff;
+	*cell = consoleMakeCell(c);
+	return true;
+}
 
-	if (currentConsole->flags & CONSOLE_CROSSED_OUT) b5 = 0xff;
+// Sets character cells of the current window. Clipped to the screen.
+static void consoleFillCells(int cx, int cy, int cw, int ch, u32 cell) {
+	const u8 screen = consoleGetScreen(currentConsole);
+	consoleCheckCellFont(screen);
+
+	const int cols = consoleGetCellCols(screen);
+	int x = currentConsole->windowX + cx;
+	int y = currentConsole->windowY + cy;
+	int endX = x + cw;
+	int endY = y + ch;
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (endX > cols) endX = cols;
+	if (endY > CELL_ROWS) endY = CELL_ROWS;
+
+	for (; y < endY; y++) {
+		u32 *row = cellsWanted[screen][y];
+		for (int i=x;i<endX;i++) row[i] = cell;
+		cellsPendingRows[screen] |= 1u<<y;
+	}
+}
 
-	u8 mask = 0x80;
+static void consoleScrollCells(void) {
+	const u8 screen = consoleGetScreen(currentConsole);
+	const int cols = consoleGetCellCols(screen);
+	const int x = currentConsole->windowX;
+	int width = currentConsole->windowWidth;
+	int endY = currentConsole->windowY + currentConsole->windowHeight;
+	if (x < 0 || x >= cols) return;
+	if (x + width > cols) width = cols - x;
+	if (endY > CELL_ROWS) endY = CELL_ROWS;
+
+	for (int y=currentConsole->windowY;y<endY - 1;y++) {
+		if (y < 0) continue;
+		memcpy(&cellsWanted[screen][y][x], &cellsWanted[screen][y + 1][x], width * 4);
+		memcpy(&cellsDrawn[screen][y][x], &cellsDrawn[screen][y + 1][x], width * 4);
+		cellsPendingRows[screen] |= 1u<<y;
+	}
+}
 
+static void consoleDrawCell(u8 screen, int x, int y, u32 cell) {
+	const u16 fg = colorTable[cell>>8 & 0xFFu];
+	const u16 bg = colorTable[cell>>16 & 0xFFu];
+
+	if (fg != pairFg || bg != pairBg) {
+		pairFg = fg;
+		pairBg = bg;
+		pairTable[0] = (u32)bg<<16 | bg;
+		pairTable[1] = (u32)bg<<16 | fg;
+		pairTable[2] = (u32)fg<<16 | bg;
+		pairTable[3] = (u32)fg<<16 | fg;
+	}
 
-	int i;
+	const u16 *cols = getGlyphColumns(cellsFont[screen], cell & 0xFFu);
 
-	int x = (currentConsole->cursorX + currentConsole->windowX) * 6;
-	int y = ((currentConsole->cursorY + currentConsole->windowY) * 10);
+	u16 extra = 0;
+	if (cell & CELL_UNDERLINE) extra |= 1u<<0;
+	if (cell & CELL_CROSSED_OUT) extra |= 1u<<5;
 
-	u16 *screen = &currentConsole->frameBuffer[(x * 240) + (239 - (y + 9))];
+	// y is a multiple of 10 so each glyph column starts word aligned
+	u16 *fb = (screen == SCREEN_TOP ? (u16*)RENDERBUF_TOP : (u16*)RENDERBUF_SUB);
+	u32 *out = (u32*)&fb[(x * 6 * 240) + (239 - (y * 10 + 9))];
 
-	for (i=0;i<6;i++) {
-		if (b10 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b9 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b8 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b7 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b6 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b5 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b4 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b3 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b2 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		if (b1 & mask) { *(screen++) = fg; }else{ *(screen++) = bg; }
-		mask >>= 1;
-		screen += 240 - 10;
+	for (int i=0;i<6;i++) {
+		const u32 col = cols[i] | extra;
+		out[0] = pairTable[col & 3u];
+		out[1] = pairTable[col>>2 & 3u];
+		out[2] = pairTable[col>>4 & 3u];
+		out[3] = pairTable[col>>6 & 3u];
+		out[4] = pairTable[col>>8 & 3u];
+		out += 240 / 2;
 	}
+}
 
+//---------------------------------------------------------------------------------
+void consoleDrawChar(int c) {
+//---------------------------------------------------------------------------------
+	c -= currentConsole->font.asciiOffset;
+	if ( c < 0 || c >= currentConsole->font.numChars || c > 0xFF ) return;
+
+	consoleFillCells(currentConsole->cursorX, currentConsole->cursorY, 1, 1, consoleMakeCell(c));
+}
+
+// A cell whose pixels are all background, like a cleared one.
+static bool consoleIsBlankCell(u8 screen, u32 cell) {
+	if (!cell || (cell & (CELL_UNDERLINE | CELL_CROSSED_OUT))) return false;
+
+	const u16 *cols = getGlyphColumns(cellsFont[screen], cell & 0xFFu);
+	for (int i=0;i<6;i++) {
+		if (cols[i]) return false;
+	}
+	return true;
+}
+
+// True if a cell column wants the same cell top to bottom and
+// at least one of them is not drawn yet.
+static bool consoleIsFillColumn(u8 screen, int x, u32 cell) {
+	bool pending = false;
+	for (int y=0;y<CELL_ROWS;y++) {
+		if (cellsWanted[screen][y][x] != cell) return false;
+		if (cellsDrawn[screen][y][x] != cell) pending = true;
+	}
+	return pending;
+}
+
+// Cell columns that are blank from top to bottom (full screen clears)
+// are one contiguous render buffer range. They are filled with the
+// PSC fill engine instead of drawing every blank cell.
+static void consoleFillBlankColumns(u8 screen, int *first, int *end) {
+	const int cols = consoleGetCellCols(screen);
+	for (int x=0;x<cols;) {
+		const u32 cell = cellsWanted[screen][0][x];
+		int w = 0;
+		if (consoleIsBlankCell(screen, cell)) {
+			while (x + w < cols && consoleIsFillColumn(screen, x + w, cell)) w++;
+		}
+		if (!w) {
+			x++;
+			continue;
+		}
+
+		if (GFX_fillRenderbuf(screen, x * 6 * 240 * 2, w * 6 * 240 * 2, colorTable[cell>>16 & 0xFFu])) {
+			for (int y=0;y<CELL_ROWS;y++) {
+				for (int i=x;i<x + w;i++) cellsDrawn[screen][y][i] = cell;
+			}
+			if (x < *first) *first = x;
+			if (x + w > *end) *end = x + w;
+		}
+		x += w;
+	}
+}
+
+static void consoleFlushCells(void) {
+	for (u8 screen=0;screen<2;screen++) {
+		u32 rows = cellsPendingRows[screen];
+		if (!rows) continue;
+		cellsPendingRows[screen] = 0;
+
+		const int cols = consoleGetCellCols(screen);
+		int first = cols, end = 0;
+		if (rows == (1u<<CELL_ROWS) - 1) consoleFillBlankColumns(screen, &first, &end);
+		while (rows) {
+			const int y = __builtin_ctz(rows);
+			rows &= rows - 1;
+
+			const u32 *wanted = cellsWanted[screen][y];
+			u32 *drawn = cellsDrawn[screen][y];
+			for (int x=0;x<cols;x++) {
+				const u32 cell = wanted[x];
+				if (cell == drawn[x]) continue;
+
+				drawn[x] = cell;
+				if (!cell) continue;
+				consoleDrawCell(screen, x, y, cell);
+				if (x < first) first = x;
+				if (x + 1 > end) end = x + 1;
+			}
+		}
+
+		if (end > first) GFX_markRenderbufDirty(screen, first * 6, (end - first) * 6);
+	}
+}
+
+//---------------------------------------------------------------------------------
+void consoleFlush(void) {
+//---------------------------------------------------------------------------------
+	spinlockLock(&consoleLock);
+	consoleFlushCells();
+	spinlockUnlock(&consoleLock);
+}
+
+static void consoleInvalidateCells(u8 screen, int x, int width) {
+	if (screen > SCREEN_TOP) return;
+
+	const int cols = consoleGetCellCols(screen);
+	int first = (x < 0 ? 0 : x / 6);
+	int end = (x + width + 5) / 6;
+	if (end > cols) end = cols;
+	if (end <= first) return;
+
+	for (int y=0;y<CELL_ROWS;y++) {
+		memset(&cellsWanted[screen][y][first], 0, (end - first) * 4);
+		memset(&cellsDrawn[screen][y][first], 0, (end - first) * 4);
+	}
+}
+
+//---------------------------------------------------------------------------------
+void consoleInvalidate(u8 screen, int x, int width) {
+//---------------------------------------------------------------------------------
+	spinlockLock(&consoleLock);
+	consoleInvalidateCells(screen, x, width);
+	spinlockUnlock(&consoleLock);
 }
 
 //---------------------------------------------------------------------------------
@@ -755,6 +1022,10 @@ void drawConsoleWindow(PrintConsole* console, int thickness, u8 colorIndex) {
 	int endy = console->windowHeight * 8 + thickness;
 
 	u16 color = colorTable[colorIndex];
+	spinlockLock(&consoleLock);
+	consoleFlushCells();
+	consoleMarkDirty(currentConsole, startx, endx - startx);
+	consoleInvalidateCells(consoleGetScreen(currentConsole), startx, endx - startx);
 	
 	// upper line
 	for(int y = starty; y < starty + thickness; y++)
@@ -783,6 +1054,7 @@ void drawConsoleWindow(PrintConsole* console, int thickness, u8 colorIndex) {
 			*screen = color;
 		}
 	}
+	spinlockUnlock(&consoleLock);
 }
 
 void consoleSetCursor(PrintConsole* console, int x, int y) {
@@ -39,6 +39,7 @@ noreturn void panic()
 
 	consoleInit(SCREEN_SUB, NULL, false);
 	ee_printf("\x1b[41m\x1b[0J\x1b[15C****PANIC!!!****\n");
+	consoleFlush();
 	GX_textureCopy((u64*)RENDERBUF_TOP, 0, (u64*)GFX_getFramebuffer(SCREEN_TOP),
 	               0, SCREEN_SIZE_TOP + SCREEN_SIZE_SUB);
 	GFX_swapFramebufs();
@@ -62,6 +63,7 @@ noreturn void panicMsg(const char *msg)
 	consoleInit(SCREEN_SUB, NULL, false);
 	ee_printf("\x1b[41m\x1b[0J\x1b[15C****PANIC!!!****\n\n");
 	ee_printf("\nERROR MESSAGE:\n%s\n", msg);
+	consoleFlush();
 	GX_textureCopy((u64*)RENDERBUF_TOP, 0, (u64*)GFX_getFramebuffer(SCREEN_TOP),
 				   0, SCREEN_SIZE_TOP + SCREEN_SIZE_SUB);
 	GFX_swapFramebufs();
@@ -131,6 +133,7 @@ noreturn void guruMeditation(u8 type, const u32 *excStack)
 	}
 
 	//if(codeChanged) ee_printf("Attention: RO section data changed!!");
+	consoleFlush();
 	GX_textureCopy((u64*)RENDERBUF_TOP, 0, (u64*)GFX_getFramebuffer(SCREEN_TOP),
 				   0, SCREEN_SIZE_TOP + SCREEN_SIZE_SUB);
 	GFX_swapFramebufs();
@@ -20,6 +20,8 @@
 #include "types.h"
 #include "mem_map.h"
 #include "arm11/start.h"
+#include "arm11/firm.h"
+#include "arm11/work.h"
 #include "hardware/pxi.h"
 #include "system.h"
 #include "ipc_handler.h"
@@ -47,12 +49,31 @@ void NAKED firmLaunchStub(void)
 
 s32 loadVerifyFirm(const char *const path, bool skipHashCheck)
 {
-	u32 cmdBuf[3];
+	return loadVerifyFirmSigned(path, skipHashCheck, NULL);
+}
+
+s32 loadVerifyFirmSigned(const char *const path, bool skipHashCheck, const u32 *const pubkey)
+{
+	u32 cmdBuf[5];
+	cmdBuf[0] = (u32)path;
+	cmdBuf[1] = strlen(path) + 1;
+	cmdBuf[2] = (u32)pubkey;
+	cmdBuf[3] = (pubkey ? FIRM_PUBKEY_SIZE : 0);
+	cmdBuf[4] = skipHashCheck;
+
+	return PXI_sendCmd(IPC_CMD9_LOAD_VERIFY_FIRM, cmdBuf, 5);
+}
+
+void preloadFirm(const char *const path, bool skipHashCheck, const u32 *const pubkey)
+{
+	u32 cmdBuf[5];
 	cmdBuf[0] = (u32)path;
 	cmdBuf[1] = strlen(path) + 1;
-	cmdBuf[2] = skipHashCheck;
+	cmdBuf[2] = (u32)pubkey;
+	cmdBuf[3] = (pubkey ? FIRM_PUBKEY_SIZE : 0);
+	cmdBuf[4] = skipHashCheck;
 
-	return PXI_sendCmd(IPC_CMD9_LOAD_VERIFY_FIRM, cmdBuf, 3);
+	PXI_sendCmd(IPC_CMD9_PRELOAD_FIRM, cmdBuf, 5);
 }
 
 noreturn void firmLaunch(void)
@@ -62,6 +83,8 @@ noreturn void firmLaunch(void)
 	// Relocate ARM11 stub
 	memcpy((void*)A11_STUB_ENTRY, (const void*)firmLaunchStub, A11_STUB_SIZE);
 
+	// The FIRM expects the other cores waiting in boot11
+	workStopCores();
 	__systemDeinit();
 	deinitCpu();
 
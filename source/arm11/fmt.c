@@ -65,16 +65,16 @@ This code is based on a file that contains the following:
 #include "arm11/fmt.h"
 #include "arm11/console.h"
 
-#define ZEROPAD   (1<<0) //Pad with zero
-#define SIGN      (1<<1) //Unsigned/signed long
-#define PLUS      (1<<2) //Show plus
-#define SPACE     (1<<3) //Spacer
-#define LEFT      (1<<4) //Left justified
-#define HEX_PREP  (1<<5) //0x
-#define UPPERCASE (1<<6) //'ABCDEF'
-
 #define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
 
+static const char lowerDigits[] = "0123456789abcdef",
+                  upperDigits[] = "0123456789ABCDEF";
+
+// "00" to "99". Halves the divisions for decimal numbers.
+static const char digitPairs[200] =
+	"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+	"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
 static s32 skipAtoi(const char **s)
 {
 	s32 i = 0;
@@ -84,57 +84,113 @@ static s32 skipAtoi(const char **s)
 	return i;
 }
 
+// Digits come out in reverse order.
+static s32 reverseDigits32(char *tmp, u32 num, s32 minDigits)
+{
+	s32 i = 0;
+
+	// Division by constant is a multiply on ARM11, no libgcc call
+	while(num >= 100)
+	{
+		const u32 q = num / 100;
+		const char *const pair = &digitPairs[(num - q * 100) * 2];
+		tmp[i++] = pair[1];
+		tmp[i++] = pair[0];
+		num = q;
+	}
+	if(num >= 10)
+	{
+		tmp[i++] = digitPairs[num * 2 + 1];
+		tmp[i++] = digitPairs[num * 2];
+	}
+	else tmp[i++] = '0' + num;
+
+	while(i < minDigits) tmp[i++] = '0';
+
+	return i;
+}
+
+static s32 reverseDecDigits(char *tmp, u64 num)
+{
+	s32 i = 0;
+
+	// 64 bit division only once per 9 digits
+	while(num >> 32)
+	{
+		const u64 q = num / 1000000000u;
+		i += reverseDigits32(&tmp[i], (u32)(num - q * 1000000000u), 9);
+		num = q;
+	}
+
+	return i + reverseDigits32(&tmp[i], (u32)num, 0);
+}
+
+static s32 reverseHexDigits(char *tmp, u64 num, const char *const dig)
+{
+	s32 i = 0;
+
+	// All 8 nibbles of the low word, zeros included
+	if(num >> 32)
+	{
+		u32 low = (u32)num;
+		for(u32 k = 0; k < 8; k++)
+		{
+			tmp[i++] = dig[low & 0xFu];
+			low >>= 4;
+		}
+		num >>= 32;
+	}
+
+	u32 num32 = (u32)num;
+	while(num32)
+	{
+		tmp[i++] = dig[num32 & 0xFu];
+		num32 >>= 4;
+	}
+
+	return i;
+}
+
 static char *processNumber(char *str, const char *const strEnd, s64 num, bool isHex, s32 size, s32 precision, u32 type)
 {
 	char sign = 0;
 
-	if(type & SIGN)
+	if(type & FMT_SIGN)
 	{
 		if(num < 0)
 		{
 			sign = '-';
-			num = -num;
+			num = -(u64)num;
 			size--;
 		}
-		else if(type & PLUS)
+		else if(type & FMT_PLUS)
 		{
 			sign = '+';
 			size--;
 		}
-		else if(type & SPACE)
+		else if(type & FMT_SPACE)
 		{
 			sign = ' ';
 			size--;
 		}
 	}
 
-	static const char *lowerDigits = "0123456789abcdef",
-					  *upperDigits = "0123456789ABCDEF";
-
 	s32 i = 0;
 	char tmp[20];
-	const char *dig = (type & UPPERCASE) ? upperDigits : lowerDigits;
 
 	if(num == 0)
 	{
 		if(precision != 0) tmp[i++] = '0';
-		type &= ~HEX_PREP;
-	}
-	else
-	{
-		while(num != 0)
-		{
-			u64 base = isHex ? 16ULL : 10ULL;
-			tmp[i++] = dig[(u64)num % base];
-			num = (s64)((u64)num / base);
-		}
+		type &= ~FMT_HEX_PREP;
 	}
+	else if(isHex) i = reverseHexDigits(tmp, num, (type & FMT_UPPERCASE) ? upperDigits : lowerDigits);
+	else i = reverseDecDigits(tmp, num);
 
-	if(type & LEFT || precision != -1) type &= ~ZEROPAD;
-	if(type & HEX_PREP && isHex) size -= 2;
+	if(type & FMT_LEFT || precision != -1) type &= ~FMT_ZEROPAD;
+	if(type & FMT_HEX_PREP && isHex) size -= 2;
 	if(i > precision) precision = i;
 	size -= precision;
-	if(!(type & (ZEROPAD | LEFT)))
+	if(!(type & (FMT_ZEROPAD | FMT_LEFT)))
 		while(size-- > 0)
 		{
 			if(str >= strEnd) goto end;
@@ -146,14 +202,15 @@ static char *processNumber(char *str, const char *const strEnd, s64 num, bool is
 		*str++ = sign;
 	}
 
-	if(type & HEX_PREP && isHex)
+	if(type & FMT_HEX_PREP && isHex)
 	{
-		if(str + 2 >= strEnd) goto end;
+		if(str >= strEnd) goto end;
 		*str++ = '0';
-		*str++ = 'x';
+		if(str >= strEnd) goto end;
+		*str++ = (type & FMT_UPPERCASE ? 'X' : 'x');
 	}
 
-	if(type & ZEROPAD)
+	if(type & FMT_ZEROPAD)
 		while(size-- > 0)
 		{
 			if(str >= strEnd) goto end;
@@ -189,8 +246,13 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 	{
 		if(*fmt != '%')
 		{
+			// Copy the whole run up to the next conversion at once
+			u32 len = strcspn(fmt, "%");
+			if(len > (u32)(strEnd - str)) len = strEnd - str;
+			memcpy(str, fmt, len);
+			str += len;
 			if(str >= strEnd) break;
-			*str++ = *fmt;
+			fmt += len - 1;
 			continue;
 		}
 
@@ -202,11 +264,11 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 		{
 			switch(*++fmt)
 			{
-				case '-': flags |= LEFT; break;
-				case '+': flags |= PLUS; break;
-				case ' ': flags |= SPACE; break;
-				case '#': flags |= HEX_PREP; break;
-				case '0': flags |= ZEROPAD; break;
+				case '-': flags |= FMT_LEFT; break;
+				case '+': flags |= FMT_PLUS; break;
+				case ' ': flags |= FMT_SPACE; break;
+				case '#': flags |= FMT_HEX_PREP; break;
+				case '0': flags |= FMT_ZEROPAD; break;
 				default: loop = false; break;
 			}
 		}
@@ -223,7 +285,7 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 			if(fieldWidth < 0)
 			{
 				fieldWidth = -fieldWidth;
-				flags |= LEFT;
+				flags |= FMT_LEFT;
 			}
 		}
 
@@ -269,7 +331,7 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 		switch(*fmt)
 		{
 			case 'c':
-				if(!(flags & LEFT))
+				if(!(flags & FMT_LEFT))
 					while(--fieldWidth > 0)
 					{
 						if(str >= strEnd) goto end;
@@ -289,7 +351,7 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 				char *s = va_arg(args, char *);
 				if(!s) s = "<NULL>";
 				u32 len = (precision != -1) ? strnlen(s, precision) : strlen(s);
-				if(!(flags & LEFT))
+				if(!(flags & FMT_LEFT))
 					while((s32)len < fieldWidth--)
 					{
 						if(str >= strEnd) goto end;
@@ -312,14 +374,14 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 				if(fieldWidth == -1)
 				{
 					fieldWidth = 8;
-					flags |= ZEROPAD;
+					flags |= FMT_ZEROPAD;
 				}
 				str = processNumber(str, strEnd, va_arg(args, u32), true, fieldWidth, precision, flags);
 				continue;
 
 			//Integer number formats - set up the flags and "break"
 			case 'X':
-				flags |= UPPERCASE;
+				flags |= FMT_UPPERCASE;
 				//Falls through
 			case 'x':
 				isHex = true;
@@ -327,7 +389,7 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 
 			case 'd':
 			case 'i':
-				flags |= SIGN;
+				flags |= FMT_SIGN;
 				//Falls through
 			case 'u':
 				isHex = false;
@@ -350,7 +412,7 @@ u32 ee_vsnprintf(char *buf, u32 size, const char *fmt, va_list args)
 
 		s64 num;
 
-		if(flags & SIGN)
+		if(flags & FMT_SIGN)
 		{
 			if(integerType == 1) num = va_arg(args, s64);
 			else num = va_arg(args, s32);
@@ -375,6 +437,15 @@ end:
 	return str - buf;
 }
 
+u32 ee_fmtNumber(char *const buf, u32 size, u64 num, const FmtSpec *const spec)
+{
+	if(size == 0) return 0;
+
+	char *const str = processNumber(buf, buf + size - 1, (s64)num, spec->isHex, spec->width, spec->precision, spec->flags);
+	*str = 0;
+	return str - buf;
+}
+
 u32 ee_vsprintf(char *const buf, const char *const fmt, va_list arg)
 {
 	return ee_vsnprintf(buf, 0x1000, fmt, arg);
@@ -23,16 +23,23 @@
 #include "hardware/pxi.h"
 
 
+// Bumped by everything that can change a directory listing. FatFs is
+// built without RTC so directory timestamps alone don't catch that.
+static u32 fsGeneration = 0;
+
+
 
 s32 fMount(FsDrive drive)
 {
 	const u32 cmdBuf = drive;
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FMOUNT, &cmdBuf, 1);
 }
 
 s32 fUnmount(FsDrive drive)
 {
 	const u32 cmdBuf = drive;
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FUNMOUNT, &cmdBuf, 1);
 }
 
@@ -73,6 +80,7 @@ s32 fPrepareRawAccess(FsDevice dev)
 s32 fFinalizeRawAccess(DevHandle handle)
 {
 	const u32 cmdBuf = handle;
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FFINAL_RAW_ACCESS, &cmdBuf, 1);
 }
 
@@ -107,6 +115,7 @@ s32 fsWriteFromDeviceBuffer(s32 destHandle, u32 destOffset, u32 destSize, DevBuf
 	cmdBuf[2] = destSize;
 	cmdBuf[3] = devBufHandle;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FWRITE_FROM_DEV_BUF, cmdBuf, 4);
 }
 
@@ -117,6 +126,7 @@ s32 fOpen(const char *const path, FsOpenMode mode)
 	cmdBuf[1] = strlen(path) + 1;
 	cmdBuf[2] = mode;
 
+	if(mode & (FS_OPEN_WRITE | FS_CREATE_NEW | FS_CREATE_ALWAYS | FS_OPEN_ALWAYS)) fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FOPEN, cmdBuf, 3);
 }
 
@@ -137,6 +147,7 @@ s32 fWrite(s32 handle, const void *const buf, u32 size)
 	cmdBuf[1] = size;
 	cmdBuf[2] = handle;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FWRITE, cmdBuf, 3);
 }
 
@@ -179,6 +190,7 @@ s32 fExpand(s32 handle, u32 size)
 	cmdBuf[0] = handle;
 	cmdBuf[1] = size;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FEXPAND, cmdBuf, 2);
 }
 
@@ -213,6 +225,20 @@ s32 fReadDir(s32 handle, FsFileInfo *fi, u32 num)
 	return PXI_sendCmd(IPC_CMD9_FREAD_DIR, cmdBuf, 4);
 }
 
+s32 fReadDirPacked(s32 handle, u32 offset, u32 flags, const char *const pattern, void *const buf, u32 bufSize)
+{
+	u32 cmdBuf[7];
+	cmdBuf[0] = (u32)pattern;
+	cmdBuf[1] = (pattern ? strlen(pattern) + 1 : 0);
+	cmdBuf[2] = (u32)buf;
+	cmdBuf[3] = bufSize;
+	cmdBuf[4] = handle;
+	cmdBuf[5] = offset;
+	cmdBuf[6] = flags;
+
+	return PXI_sendCmd(IPC_CMD9_FREAD_DIR_PACKED, cmdBuf, 7);
+}
+
 s32 fCloseDir(s32 handle)
 {
 	const u32 cmdBuf = handle;
@@ -225,6 +251,7 @@ s32 fMkdir(const char *const path)
 	cmdBuf[0] = (u32)path;
 	cmdBuf[1] = strlen(path) + 1;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FMKDIR, cmdBuf, 2);
 }
 
@@ -236,6 +263,7 @@ s32 fRename(const char *const old, const char *const new)
 	cmdBuf[2] = (u32)new;
 	cmdBuf[3] = strlen(new) + 1;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FRENAME, cmdBuf, 4);
 }
 
@@ -245,6 +273,7 @@ s32 fUnlink(const char *const path)
 	cmdBuf[0] = (u32)path;
 	cmdBuf[1] = strlen(path) + 1;
 
+	fsGeneration++;
 	return PXI_sendCmd(IPC_CMD9_FUNLINK, cmdBuf, 2);
 }
 
@@ -262,3 +291,8 @@ s32 fSetNandProtection(bool protect)
 	const u32 cmdBuf = protect;
 	return PXI_sendCmd(IPC_CMD9_FSET_NAND_PROT, &cmdBuf, 1);
 }
+
+u32 fGetGeneration(void)
+{
+	return fsGeneration;
+}
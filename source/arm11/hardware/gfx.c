@@ -30,6 +30,7 @@
 #include "arm11/hardware/interrupt.h"
 #include "arm11/hardware/timer.h"
 #include "arm.h"
+#include "arm11/spinlock.h"
 
 
 #define PDN_REGS_BASE           (IO_MEM_ARM9_ARM11 + 0x40000)
@@ -56,6 +57,19 @@
 
 static u32 activeFb = 0;
 static volatile bool eventTable[6] = {0};
+static volatile u32 vblankCount = 0;
+
+// Dirty column ranges {first, end} of the render buffers. Index 0 is
+// SCREEN_SUB and 1 is SCREEN_TOP. first >= end means clean.
+// The back buffer is one present behind so the previous changes are
+// copied again on the next present.
+static u16 renderbufDirty[2][2] = {{0, SCREEN_WIDTH_SUB}, {0, SCREEN_WIDTH_TOP}};
+static u16 renderbufPrevDirty[2][2] = {{0, SCREEN_WIDTH_SUB}, {0, SCREEN_WIDTH_TOP}};
+static bool swapPending = false;
+static u32 swapVblank = 0;
+static bool gfxInitialized = false;
+// The dirty ranges and the swap state are shared by both cores
+static u32 renderbufLock = 0;
 
 
 
@@ -209,6 +223,15 @@ void GX_textureCopy(u64 *in, u32 indim, u64 *out, u32 outdim, u32 size)
 	REGs_TRANS_ENGINE[6] = 1;
 }
 
+void GX_textureCopyWait(u64 *in, u32 indim, u64 *out, u32 outdim, u32 size)
+{
+	if(!in || !out) return;
+
+	eventTable[GFX_EVENT_PPF] = false;
+	GX_textureCopy(in, indim, out, outdim, size);
+	GFX_waitForEvent(GFX_EVENT_PPF, false);
+}
+
 void GFX_setBrightness(u32 top, u32 sub)
 {
 	REG_LCD_BACKLIGHT_MAIN = top;
@@ -236,7 +259,9 @@ void GFX_swapFramebufs(void)
 
 static void gfxIrqHandler(u32 intSource)
 {
+	if(intSource == IRQ_PDC0) vblankCount++;
 	eventTable[intSource - IRQ_PSC0] = true;
+	__sev(); // Wake up waiters on core 1
 }
 
 void GFX_waitForEvent(GfxEvent event, bool discard)
@@ -246,6 +271,97 @@ void GFX_waitForEvent(GfxEvent event, bool discard)
 	eventTable[event] = false;
 }
 
+u32 GFX_getVblankCount(void)
+{
+	return vblankCount;
+}
+
+void GFX_markRenderbufDirty(u8 screen, s32 x, s32 width)
+{
+	const s32 screenWidth = (screen ? SCREEN_WIDTH_TOP : SCREEN_WIDTH_SUB);
+
+	if(x < 0)
+	{
+		width += x;
+		x = 0;
+	}
+	if(width <= 0 || x >= screenWidth) return;
+	const s32 end = (width > screenWidth - x ? screenWidth : x + width);
+
+	spinlockLock(&renderbufLock);
+	u16 *const dirty = renderbufDirty[screen != 0];
+	if(x < dirty[0]) dirty[0] = x;
+	if(end > dirty[1]) dirty[1] = end;
+	spinlockUnlock(&renderbufLock);
+}
+
+bool GFX_presentRenderbufs(void)
+{
+	u32 ranges[2][2];
+	bool changed = false;
+	spinlockLock(&renderbufLock);
+	for(u32 i = 0; i < 2; i++)
+	{
+		const u16 *const cur = renderbufDirty[i];
+		const u16 *const prev = renderbufPrevDirty[i];
+		ranges[i][0] = (cur[0] < prev[0] ? cur[0] : prev[0]);
+		ranges[i][1] = (cur[1] > prev[1] ? cur[1] : prev[1]);
+		if(ranges[i][0] < ranges[i][1]) changed = true;
+	}
+	if(!changed)
+	{
+		spinlockUnlock(&renderbufLock);
+		return false;
+	}
+
+	// The back buffer may still be scanned out until the last swap latched
+	if(swapPending)
+	{
+		while(gfxInitialized && vblankCount == swapVblank) __wfe();
+		swapPending = false;
+	}
+
+	// Both render buffers are column major with 240 pixels per column
+	const u32 colSize = SCREEN_HEIGHT_TOP * 2;
+	for(u32 i = 0; i < 2; i++)
+	{
+		if(ranges[i][0] < ranges[i][1])
+		{
+			const u32 offset = ranges[i][0] * colSize;
+			u8 *const src = (u8*)(i ? RENDERBUF_TOP : RENDERBUF_SUB) + offset;
+			u8 *const dst = (u8*)GFX_getFramebuffer(i) + offset;
+			GX_textureCopyWait((u64*)src, 0, (u64*)dst, 0, (ranges[i][1] - ranges[i][0]) * colSize);
+		}
+
+		renderbufPrevDirty[i][0] = renderbufDirty[i][0];
+		renderbufPrevDirty[i][1] = renderbufDirty[i][1];
+		renderbufDirty[i][0] = 0xFFFF;
+		renderbufDirty[i][1] = 0;
+	}
+
+	// Sample the counter after the swap was requested. A VBlank that hits
+	// in between must not count as the one latching the new buffers.
+	GFX_swapFramebufs();
+	swapVblank = vblankCount;
+	swapPending = true;
+	spinlockUnlock(&renderbufLock);
+
+	return true;
+}
+
+bool GFX_fillRenderbuf(u8 screen, u32 offset, u32 size, u16 color)
+{
+	// Needs the PSC0 IRQ
+	if(!gfxInitialized || (offset | size) & 7u) return false;
+
+	u8 *const buf = (u8*)(screen ? RENDERBUF_TOP : RENDERBUF_SUB) + offset;
+	eventTable[GFX_EVENT_PSC0] = false;
+	GX_memoryFill((u64*)buf, 1u<<9, size, (u32)color<<16 | color, NULL, 0, 0, 0);
+	GFX_waitForEvent(GFX_EVENT_PSC0, false);
+
+	return true;
+}
+
 void GFX_init(bool clearScreens)
 {
 	if(REG_PDN_GPU_CNT != 0x1007F) // Check if screens are already initialized
@@ -277,6 +393,7 @@ void GFX_init(bool clearScreens)
 	IRQ_registerHandler(IRQ_PDC0, 14, 0, true, gfxIrqHandler);
 	IRQ_registerHandler(IRQ_PPF, 14, 0, true, gfxIrqHandler);
 	//IRQ_registerHandler(IRQ_P3D, 14, 0, true, gfxIrqHandler);
+	gfxInitialized = true;
 
 	if(clearScreens)
 	{
@@ -320,6 +437,7 @@ void GFX_deinit(bool keepLcdsOn)
 	IRQ_disable(IRQ_PDC0);
 	IRQ_disable(IRQ_PPF);
 	//IRQ_disable(IRQ_P3D);
+	gfxInitialized = false;
 
 	if(keepLcdsOn)
 	{
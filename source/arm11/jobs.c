@@ -0,0 +1,185 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "arm11/jobs.h"
+#include "arm11/work.h"
+#include "arm11/spinlock.h"
+#ifdef _3DS
+#include "arm.h"
+#define jobsIdle()  __wfe()
+#else
+#include <sched.h>
+#define jobsIdle()  sched_yield()
+#endif
+
+
+#define JOBS_MAX_SLOTS  (4u) // Core 0 + up to 3 worker cores
+
+
+typedef struct
+{
+	u32 lock;
+	u32 next;
+	u32 end;
+} JobRange;
+
+
+static JobRange ranges[JOBS_MAX_SLOTS];
+static u32 groupLock = 0;
+static bool groupOpen = false; // Both protected by groupLock
+static u32 groupJoined = 0;
+static JobFunc groupFunc;
+static void *groupArg;
+static WorkItem helpers[JOBS_MAX_SLOTS - 1] = {{.done = true}, {.done = true}, {.done = true}};
+
+
+
+static bool rangePopFront(JobRange *r, u32 *index)
+{
+	spinlockLock(&r->lock);
+	const bool ok = (r->next < r->end);
+	if(ok) *index = r->next++;
+	spinlockUnlock(&r->lock);
+
+	return ok;
+}
+
+// Takes the back half of the indices left in another slot's range.
+static bool rangeSteal(u32 slot, u32 *first, u32 *end)
+{
+	for(u32 i = 1; i < JOBS_MAX_SLOTS; i++)
+	{
+		JobRange *const victim = &ranges[(slot + i) % JOBS_MAX_SLOTS];
+
+		spinlockLock(&victim->lock);
+		const u32 left = victim->end - victim->next;
+		if(left)
+		{
+			*end = victim->end;
+			victim->end -= (left + 1) / 2;
+			*first = victim->end;
+		}
+		spinlockUnlock(&victim->lock);
+
+		if(left) return true;
+	}
+
+	return false;
+}
+
+static void jobsWork(u32 slot)
+{
+	JobRange *const own = &ranges[slot];
+	const JobFunc func = groupFunc;
+	void *const arg = groupArg;
+
+	while(1)
+	{
+		u32 index;
+		if(rangePopFront(own, &index))
+		{
+			func(arg, index);
+			continue;
+		}
+
+		u32 first, end;
+		if(!rangeSteal(slot, &first, &end)) break;
+
+		// Only we pop from our range but others may steal from it.
+		spinlockLock(&own->lock);
+		own->next = first;
+		own->end = end;
+		spinlockUnlock(&own->lock);
+	}
+}
+
+static void jobsHelper(void *arg)
+{
+	const u32 slot = (u32)(uintptr_t)arg;
+
+	// Late helpers from an earlier run must not touch the ranges anymore.
+	spinlockLock(&groupLock);
+	const bool open = groupOpen;
+	if(open) groupJoined++;
+	spinlockUnlock(&groupLock);
+	if(!open) return;
+
+	jobsWork(slot);
+
+	spinlockLock(&groupLock);
+	groupJoined--;
+	spinlockUnlock(&groupLock);
+}
+
+void jobsRun(JobFunc func, void *arg, u32 count)
+{
+	if(!count) return;
+
+	u32 slots = 1 + __builtin_popcount(workGetCoreMask());
+	if(slots > JOBS_MAX_SLOTS) slots = JOBS_MAX_SLOTS;
+	if(slots > count) slots = count;
+	if(slots == 1)
+	{
+		for(u32 i = 0; i < count; i++) func(arg, i);
+		return;
+	}
+
+	for(u32 i = 0; i < JOBS_MAX_SLOTS; i++)
+	{
+		JobRange *const r = &ranges[i];
+		spinlockLock(&r->lock);
+		r->next = (i < slots ? (u64)count * i / slots : count);
+		r->end = (i < slots ? (u64)count * (i + 1) / slots : count);
+		spinlockUnlock(&r->lock);
+	}
+
+	spinlockLock(&groupLock);
+	groupFunc = func;
+	groupArg = arg;
+	groupOpen = true;
+	spinlockUnlock(&groupLock);
+
+	// A helper still queued from an earlier run joins this one instead.
+	for(u32 i = 1; i < slots; i++)
+	{
+		WorkItem *const helper = &helpers[i - 1];
+		if(!workIsDone(helper)) continue;
+
+		helper->func = jobsHelper;
+		helper->arg = (void*)(uintptr_t)i;
+		if(!workSubmit(helper)) helper->done = true;
+	}
+
+	jobsWork(0);
+
+	spinlockLock(&groupLock);
+	groupOpen = false;
+	spinlockUnlock(&groupLock);
+
+	// Helpers that joined may still run stolen jobs.
+	while(1)
+	{
+		spinlockLock(&groupLock);
+		const u32 joined = groupJoined;
+		spinlockUnlock(&groupLock);
+		if(!joined) break;
+
+		jobsIdle();
+	}
+}
@@ -0,0 +1,115 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "arm11/lz11.h"
+
+
+
+bool lz11DecompressStrided(const void *in, u32 inSize, void *out, u32 size, u32 runSize, u32 stride)
+{
+	if(!runSize || runSize > stride) return false;
+
+	const u8 *src = (const u8*)in;
+	const u8 *const srcEnd = src + inSize;
+	u8 *dst = (u8*)out;
+	const u32 gap = stride - runSize;
+	u32 left = runSize; // Bytes left in the current output run
+	u32 written = 0;
+	u32 flags = 0, mask = 0;
+
+	// Matches reach back at most 0x1000 bytes. Longer runs are at most 1 run
+	// end away. For shorter ones the runs back are counted with a multiply
+	// instead of a division per match since ARM11 has no divider.
+	const bool longRuns = runSize > 0x1000;
+	const u64 runRecip = 0xFFFFFFFFu / runSize + 1ull;
+
+	while(written < size)
+	{
+		if(!mask)
+		{
+			if(src == srcEnd) return false;
+			flags = *src++;
+			mask = 0x80;
+		}
+
+		const bool isMatch = flags & mask;
+		mask >>= 1;
+
+		if(!isMatch)
+		{
+			if(src == srcEnd) return false;
+			*dst++ = *src++;
+			written++;
+			if(!--left) {dst += gap; left = runSize;}
+			continue;
+		}
+
+		if(srcEnd - src < 2) return false;
+		u32 tmp = *src++;
+		u32 len;
+		switch(tmp>>4)
+		{
+			case 0:
+				if(srcEnd - src < 2) return false;
+				len = (tmp<<4 | *src>>4) + 0x11;
+				tmp = *src++;
+				break;
+			case 1:
+				if(srcEnd - src < 3) return false;
+				len = ((tmp & 0xFu)<<12 | (u32)src[0]<<4 | src[1]>>4) + 0x111;
+				tmp = src[1];
+				src += 2;
+				break;
+			default:
+				len = (tmp>>4) + 1;
+		}
+		const u32 disp = ((tmp & 0xFu)<<8 | *src++) + 1;
+		if(disp > written || len > size - written) return false;
+
+		const u32 back = disp + left - 1; // From the end of the current run
+		const u32 runsBack = (longRuns ? back >= runSize : (u32)(back * runRecip>>32));
+		const u8 *from = dst - disp - runsBack * gap;
+		u32 fromLeft = left + disp - runsBack * runSize;
+		written += len;
+
+		if(len < left && len < fromLeft)
+		{
+			// Neither side reaches a run end.
+			left -= len;
+			do *dst++ = *from++; while(--len);
+			continue;
+		}
+
+		do
+		{
+			// Copy up to the next run end on either side
+			u32 n = (len < left ? len : left);
+			if(n > fromLeft) n = fromLeft;
+			len -= n;
+			left -= n;
+			fromLeft -= n;
+			do *dst++ = *from++; while(--n);
+
+			if(!left) {dst += gap; left = runSize;}
+			if(!fromLeft) {from += gap; fromLeft = runSize;}
+		} while(len);
+	}
+
+	return true;
+}
@@ -37,6 +37,7 @@
 #include "banner_spla.h"
 #include "menu_spla.h"
 #include "fsutils.h"
+#include "trace.h"
 
 extern const bool __superhaxEnabled;
 
@@ -58,7 +59,11 @@ int main(void)
 	// filesystem / load config
 	fsMountSdmc();
 	fsMountNandFilesystems();
+	// ARM9 loads the last booted FIRM while we deal with config and splash
+	preloadLastBootslot();
+	TRACE_BEGIN(TRACE_CONFIG_LOAD, 0);
 	loadConfigFile();
+	TRACE_END(TRACE_CONFIG_LOAD, 0);
 
 
 	hidScanInput();
@@ -94,14 +99,16 @@ int main(void)
 	
 	// show splash if cold boot and (bootmode != BootModeQuiet)
 	bool splash_wait = false;
+	SplashAnim splash_anims[2] = {0};
 	if(show_menu || (!nextBootSlot && (bootmode != BootModeQuiet)))
 	{
+		TRACE_BEGIN(TRACE_SPLASH, 0);
 		if (!gfx_initialized) GFX_init(true);
 		gfx_initialized = true;
 		if(configDataExist(KSplashScreen))
 		{
 			char* folder = (char*) configGetData(KSplashScreen);
-			splash_wait = drawCustomSplash(folder); // || drawSplashscreen(banner_spla, -1, -1, SCREEN_TOP);
+			splash_wait = drawCustomSplash(folder, splash_anims); // || drawSplashscreen(banner_spla, -1, -1, SCREEN_TOP);
 			if (!splash_wait)
 			{
 				err_string = (char*) malloc(512);
@@ -111,20 +118,9 @@ int main(void)
 		}
 		else
 		{
-			u16 *const tmpBuf = malloc(SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP * 2);
-			if(tmpBuf)
-			{
-				splash_wait = drawSplashscreen(banner_spla, tmpBuf, -1, -1, SCREEN_TOP);
-				if (bootmode == BootModeQuick)
-					drawSplashscreen(menu_spla, tmpBuf, -1, 16, SCREEN_SUB);
-				free(tmpBuf);
-			}
-			else
-			{
-				err_string = (char*) malloc(512);
-				if(!err_string) panicMsg("Out of memory");
-				ee_sprintf(err_string, "Internal splash screen error\n");
-			}
+			splash_wait = drawSplashscreen(banner_spla, banner_spla_size, -1, -1, SCREEN_TOP);
+			if (bootmode == BootModeQuick)
+				drawSplashscreen(menu_spla, menu_spla_size, -1, 16, SCREEN_SUB);
 		}
 		updateScreens();
 	}
@@ -156,7 +152,7 @@ int main(void)
 				char* path = (char*) configGetData(KBootOption1 + i);
 				err_ptr += ee_sprintf(err_ptr, "Keys match boot slot #%lu.\nBoot path is %s\n", (i+1), path);
 				
-				firm_err = loadVerifyFirm(path, false);
+				firm_err = loadVerifyBootslot(i);
 				if (firm_err >= 0)
 				{
 					startFirmLaunch = true;
@@ -197,10 +193,16 @@ int main(void)
 		}
 
 		// convert msecs to vblanks and wait for the specified amount
+		// VBlanks spent drawing animation frames count towards it
 		u32 dvblank = (dmsec + (VBLANK_APPROX_MSEC-1)) / VBLANK_APPROX_MSEC;
-		for (u32 i = 0; i < dvblank; i++)
+		const u32 vblank_start = GFX_getVblankCount();
+		while (GFX_getVblankCount() - vblank_start < dvblank)
 		{
 			GFX_waitForEvent(GFX_EVENT_PDC0, true);
+			const u32 vblank = GFX_getVblankCount();
+			const bool top_changed = splashAnimUpdate(&splash_anims[SCREEN_TOP], vblank);
+			if (splashAnimUpdate(&splash_anims[SCREEN_SUB], vblank) || top_changed)
+				updateScreens();
 			hidScanInput();
 			if (hidGetExtraKeys(0) & KEY_HOME)
 			{
@@ -218,6 +220,19 @@ int main(void)
 				GFX_waitForEvent(GFX_EVENT_PDC0, true);
 		}
 	}
+	splashAnimStop(&splash_anims[SCREEN_TOP]);
+	splashAnimStop(&splash_anims[SCREEN_SUB]);
+	if (gfx_initialized) TRACE_END(TRACE_SPLASH, splash_wait);
+	
+	// report config file errors, but only if we stop in the menu anyways
+	u32 cfg_line, cfg_column;
+	const char* cfg_err = configGetParseError(&cfg_line, &cfg_column);
+	if (show_menu && !startFirmLaunch && !err_string && cfg_err)
+	{
+		err_string = (char*) malloc(512);
+		if(!err_string) panicMsg("Out of memory");
+		ee_sprintf(err_string, "Config file error (line %lu, column %lu):\n%s\n", cfg_line, cfg_column, cfg_err);
+	}
 
 	
 menu_start: ;
@@ -320,7 +335,7 @@ menu_start: ;
 					char* path = (char*) configGetData(KBootOption1 + i);
 					err_ptr += ee_sprintf(err_ptr, "Trying boot slot #%lu.\nBoot path is %s\n", (i+1), path);
 					
-					firm_err = loadVerifyFirm(path, false);
+					firm_err = loadVerifyBootslot(i);
 					if (firm_err >= 0)
 					{
 						startFirmLaunch = true;
@@ -344,7 +359,7 @@ menu_start: ;
 					char* path = (char*) configGetData(KBootOption1 + (nextBootSlot-1));
 					err_ptr += ee_sprintf(err_ptr, "Boot path is %s\n", path);
 					
-					firm_err = loadVerifyFirm(path, false);
+					firm_err = loadVerifyBootslot(nextBootSlot-1);
 					startFirmLaunch = (firm_err >= 0);
 					// no need to store the bootslot here as it stays as is
 					
@@ -385,6 +400,15 @@ menu_end:
 	// deinit GFX if it was initialized
 	if(gfx_initialized) GFX_deinit(firm_err == 1);
 	
+	// dump the boot trace while the SD card is still mounted
+	if(startFirmLaunch)
+	{
+		TRACE_POINT(TRACE_LAUNCH, firm_err);
+#ifdef BOOT_TRACE
+		traceDump();
+#endif
+	}
+	
 	// deinit filesystem
 	fsUnmountAll();
 	
@@ -16,14 +16,34 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include "arm11/bootenv.h"
+#include "arm11/config.h"
+#include "arm11/firm.h"
 #include "arm11/hardware/i2c.h"
 #include "arm11/menu/bootslot.h"
+#include "fsutils.h"
 
 #define BOOTSLOT_STORE_REG	((u8) 0x1E)
+#define BOOT_HINT_PATH		"sdmc:/boot/boot.hint"
+#define BOOT_HINT_VERSION	1
+
+
+// Boot path of the last loaded slot. Lets ARM9 start loading it
+// before the config is parsed.
+typedef struct
+{
+	u32 magic;		// "FBBH"
+	u16 version;
+	u16 hasPubkey;
+	char path[256];
+	u32 pubkey[FIRM_PUBKEY_SIZE / 4];
+} BootHint;
 
 
 static u8 stored_slot = INVALID_BOOT_SLOT;
+static BootHint boot_hint;
+static bool boot_hint_valid = false;
 
 
 u8 readStoredBootslot(void)
@@ -60,3 +80,65 @@ bool storeBootslot(u8 slot)
 		return true;
 	}
 }
+
+static void updateBootHint(const char *const path, const u32 *const pubkey)
+{
+	// already up to date? (the usual case, saves the write)
+	if (boot_hint_valid && (strncmp(boot_hint.path, path, sizeof(boot_hint.path)) == 0) &&
+		(boot_hint.hasPubkey == (pubkey != NULL)) &&
+		(!pubkey || (memcmp(boot_hint.pubkey, pubkey, FIRM_PUBKEY_SIZE) == 0)))
+		return;
+	
+	if (strlen(path) >= sizeof(boot_hint.path))
+		return;
+	
+	memset(&boot_hint, 0, sizeof(BootHint));
+	memcpy(&boot_hint.magic, "FBBH", 4);
+	boot_hint.version = BOOT_HINT_VERSION;
+	boot_hint.hasPubkey = (pubkey != NULL);
+	strcpy(boot_hint.path, path);
+	if (pubkey) memcpy(boot_hint.pubkey, pubkey, FIRM_PUBKEY_SIZE);
+	
+	boot_hint_valid = fsQuickCreate(BOOT_HINT_PATH, &boot_hint, sizeof(BootHint));
+}
+
+bool preloadLastBootslot(void)
+{
+	if (!fsQuickRead(BOOT_HINT_PATH, &boot_hint, sizeof(BootHint), 0) ||
+		(memcmp(&boot_hint.magic, "FBBH", 4) != 0) ||
+		(boot_hint.version != BOOT_HINT_VERSION) ||
+		!*boot_hint.path)
+		return false;
+	
+	boot_hint.path[sizeof(boot_hint.path) - 1] = '\0';
+	boot_hint_valid = true;
+	
+	// loadVerifyBootslot() commits it if the slot path and key match
+	preloadFirm(boot_hint.path, false, boot_hint.hasPubkey ? boot_hint.pubkey : NULL);
+	
+	return true;
+}
+
+s32 loadVerifyBootslot(u32 slot)
+{
+	const char *const path = (const char*) configGetData(KBootOption1 + slot);
+	if (!path)
+		return -1;
+	
+	// no public key set for this slot -> hash check only
+	const char *const keyPath = (const char*) configGetData(KBootOption1PubKey + slot);
+	if (!keyPath)
+	{
+		const s32 res = loadVerifyFirm(path, false);
+		if (res >= 0) updateBootHint(path, NULL);
+		return res;
+	}
+	
+	alignas(4) u32 pubkey[FIRM_PUBKEY_SIZE / 4];
+	if (!fsQuickRead(keyPath, pubkey, FIRM_PUBKEY_SIZE, 0))
+		return FIRM_ERR_PUBKEY_LOAD;
+	
+	const s32 res = loadVerifyFirmSigned(path, false, pubkey);
+	if (res >= 0) updateBootHint(path, pubkey);
+	return res;
+}
@@ -300,7 +300,9 @@ u32 menuProcess(PrintConsole* menu_con, PrintConsole* desc_con, MenuInfo* info)
 	u32 index = 0;
 	u32 last_index = (u32) -1;
 	
-	u64 n_vblanks = 0;
+	// updateScreens() doesn't wait for VBlank so loop iterations
+	// are not frames. Poll the battery by VBlank count instead.
+	u32 battery_vblank = GFX_getVblankCount();
 	getBatteryState(&battery);
 	
 	// main menu processing loop
@@ -311,17 +313,21 @@ u32 menuProcess(PrintConsole* menu_con, PrintConsole* desc_con, MenuInfo* info)
 		if(hidGetExtraKeys(0) & (KEY_POWER | KEY_POWER_HELD))
 			break; // deinits & poweroff outside of this function
 		
-		// handle battery state
-		if ((++n_vblanks % 250) == 0)
+		// handle battery state (every 250 VBlanks, ~4 sec)
+		const bool battery_update = (GFX_getVblankCount() - battery_vblank >= 250);
+		if (battery_update)
+		{
+			battery_vblank = GFX_getVblankCount();
 			getBatteryState(&battery);
+		}
 		
 		// update menu and description (on demand)
-		if ((index != last_index) || (curr_menu != last_menu) || (n_vblanks % 250 == 0)) {
+		if ((index != last_index) || (curr_menu != last_menu) || battery_update) {
 			menuDraw(curr_menu, menu_con, index);
 			menuShowDesc(curr_menu, desc_con, index);
 			last_index = index;
 			last_menu = curr_menu;
-			updateScreens(); // update screens (VBlank included)
+			updateScreens(); // update screens (no VBlank wait)
 		} else GFX_waitForEvent(GFX_EVENT_PDC0, true); // VBlank
 		
 		hidScanInput();
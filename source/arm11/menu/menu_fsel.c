@@ -24,6 +24,7 @@
 #include "fs.h"
 #include "util.h"
 #include "fsutils.h"
+#include "wildcard.h"
 #include "arm11/menu/menu_fsel.h"
 #include "arm11/menu/menu_util.h"
 #include "arm11/menu/menu_color.h"
@@ -34,221 +35,442 @@
 #include "arm11/debug.h"
 #include "arm11/fmt.h"
 
-#define MAX_DIR_ENTRIES	0x100 // 256 -> worst case approx 64kiB (yes, this is limited)
-#define N_DIR_READ		0x10  // 16 at a time
+#define MAX_DIR_ENTRIES		0x400   // 1024 (yes, this is still limited, must fit in u16 for sorting)
+#define DIR_READ_BUF_SIZE	0x400   // 1kiB of packed records at a time (~30 entries)
+#define N_DIR_STREAM		2       // reads of DIR_READ_BUF_SIZE streamed in per idle frame
+#define DIR_ENTRIES_STEP	0x40    // entry array grows by 64 entries at a time
+#define DIR_NAMES_STEP		0x1000  // name arena grows by 4kiB at a time
+#define DIR_CACHE_SLOTS		4       // number of directory listings kept around
+#define DIR_CACHE_BUDGET	0x10000 // 64kiB, least recently used listings are dropped above this
 
 typedef struct {
 	u32 fsize;		// size of the file
 	u8  is_dir;		// > 0 if is directory
-	char* fname;	// filename (handle via malloc)
+	u16 fname_len;	// length of the filename
+	u32 fname;		// offset of the filename in the name arena, followed by the sort key
 } DirBufferEntry;
 
+typedef struct {
+	char path[FF_MAX_LFN + 1];		// listed directory
+	char pattern[WILDCARD_MAX_LEN + 1];	// wildcard pattern, empty for dirs only
+	bool valid;						// listing is complete and may be reused
+	bool streaming;					// rest of the listing is still being read
+	bool stat_ok;					// dir timestamp below is available (not for drive roots)
+	u16 fdate;						// dir timestamp at the time of reading
+	u16 ftime;
+	u32 generation;					// fGetGeneration() at the time of reading
+	u32 last_used;					// for least recently used eviction
+	s32 dhandle;					// dir handle while streaming
+	u8* rbuf;						// packed record buffer while streaming (handle via malloc)
+	DirBufferEntry* entries;		// the listing (handle via malloc)
+	s32 n_entries;
+	s32 max_entries;
+	char* names;					// all filenames and sort keys back to back (handle via malloc)
+	u32 names_used;
+	u32 names_size;
+} DirListing;
+
+static DirListing dir_cache[DIR_CACHE_SLOTS];
+static u32 dir_cache_clock = 0;
+
+
+
+static inline const char* entryName(const DirListing* dl, const DirBufferEntry* entry)
+{
+	return &(dl->names[entry->fname]);
+}
+
+
+// case folded copy of the filename, stored right behind it
+static inline const char* entryKey(const DirListing* dl, const DirBufferEntry* entry)
+{
+	return &(dl->names[entry->fname + entry->fname_len + 1]);
+}
+
+
+static void stopDirStream(DirListing* dl)
+{
+	if (!dl->streaming)
+		return;
+	
+	fCloseDir(dl->dhandle);
+	free(dl->rbuf);
+	dl->rbuf = NULL;
+	dl->streaming = false;
+}
+
+
+static void freeDirListing(DirListing* dl)
+{
+	stopDirStream(dl);
+	free(dl->entries);
+	free(dl->names);
+	memset(dl, 0, sizeof(DirListing));
+}
 
 
-// inspired by http://www.geeksforgeeks.org/wildcard-character-matching/
-static bool matchName(const char* path, const char* pattern)
+static bool addDirEntry(DirListing* dl, u32 fsize, u8 is_dir, const char* fname)
 {
-	// handling non asterisk chars
-	for (; *pattern != '*'; pattern++, path++)
+	const u32 fname_len = strlen(fname);
+	const u32 fname_size = (fname_len + 1) * 2; // name + sort key
+	
+	// grow entry array (if required)
+	if (dl->n_entries >= dl->max_entries)
 	{
-		if ((*pattern == '\0') && (*path == '\0'))
-		{
-			// end reached simultaneously, match found
-			return true;
-		}
-		else if ((*pattern == '\0') || (*path == '\0'))
-		{
-			// end reached on only one, failure
-			return false;
-		}
-		else if ((*pattern != '?') && (tolower(*pattern) != tolower(*path)))
-		{
-			// chars don't match, failure
-			return false;
-		}
+		s32 max_entries = dl->max_entries + DIR_ENTRIES_STEP;
+		DirBufferEntry* entries = (DirBufferEntry*) realloc(dl->entries, max_entries * sizeof(DirBufferEntry));
+		if (!entries) return false;
+		dl->entries = entries;
+		dl->max_entries = max_entries;
+	}
+	
+	// grow name arena (if required)
+	// entries refer to names by offset, so moving the arena is fine
+	if (dl->names_used + fname_size > dl->names_size)
+	{
+		u32 names_size = dl->names_size + DIR_NAMES_STEP;
+		char* names = (char*) realloc(dl->names, names_size);
+		if (!names) return false;
+		dl->names = names;
+		dl->names_size = names_size;
+	}
+	
+	DirBufferEntry* entry = &(dl->entries[dl->n_entries++]);
+	entry->fsize = fsize;
+	entry->is_dir = is_dir;
+	entry->fname_len = fname_len;
+	entry->fname = dl->names_used;
+	
+	char* name = &(dl->names[dl->names_used]);
+	char* key = name + fname_len + 1;
+	memcpy(name, fname, fname_len + 1);
+	for (u32 i = 0; i <= fname_len; i++)
+		key[i] = tolower((unsigned char) fname[i]);
+	dl->names_used += fname_size;
+	
+	return true;
+}
+
+
+static int compareDirEntries(const DirListing* dl, const DirBufferEntry* a, const DirBufferEntry* b)
+{
+	// dirs first, then by case folded name
+	if (!a->is_dir != !b->is_dir)
+		return a->is_dir ? -1 : 1;
+	return strcmp(entryKey(dl, a), entryKey(dl, b));
+}
+
+
+// merges the sorted index runs src[lo, mid) and src[mid, hi) into dst
+static void mergeDirRuns(const DirListing* dl, const u16* src, u16* dst, s32 lo, s32 mid, s32 hi)
+{
+	s32 i = lo, j = mid;
+	for (s32 k = lo; k < hi; k++)
+	{
+		// take from the left run on ties, keeps the sort stable
+		if ((i < mid) && ((j >= hi) ||
+			(compareDirEntries(dl, &(dl->entries[src[i]]), &(dl->entries[src[j]])) <= 0)))
+			dst[k] = src[i++];
+		else dst[k] = src[j++];
 	}
+}
+
+
+/**
+ * @brief Sorts a listing, dirs first, then by name (case insensitive).
+ * Bottom up merge sort over an index array, the entries are only moved once
+ * at the end. When streaming, the first n_sorted entries are already sorted,
+ * so only the new ones are sorted and merged in.
+ * @param dl The directory listing.
+ * @param n_sorted Number of entries at the start that are already in order.
+ */
+static void sortDirBuffer(DirListing* dl, s32 n_sorted)
+{
+	const s32 n_entries = dl->n_entries;
+	if (n_sorted >= n_entries)
+		return;
+	
+	u16* idx = (u16*) malloc(n_entries * 2 * sizeof(u16));
+	if (!idx) return; // out of memory, stays unsorted
+	u16* tmp = idx + n_entries;
+	
+	// the passes below leave the sorted part alone, so it is set up in both
+	for (s32 i = 0; i < n_entries; i++)
+		idx[i] = tmp[i] = i;
 	
-	// handling the asterisk (matches any # of chars in path)
-	if ((*(pattern+1) == '?') || (*(pattern+1) == '*'))
+	// sort the unsorted tail, run width doubles each pass
+	for (s32 width = 1; width < n_entries - n_sorted; width <<= 1)
 	{
-		// stupid user/dev shenanigans, failure
-		return false;
+		for (s32 lo = n_sorted; lo < n_entries; lo += width << 1)
+		{
+			s32 mid = min(lo + width, n_entries);
+			s32 hi = min(lo + (width << 1), n_entries);
+			mergeDirRuns(dl, idx, tmp, lo, mid, hi);
+		}
+		u16* swap = idx; idx = tmp; tmp = swap;
 	}
-	else if (*(pattern+1) == '\0')
+	
+	// merge with the already sorted part
+	if (n_sorted > 0)
 	{
-		// nothing after the asterisk, match found
-		return true;
+		mergeDirRuns(dl, idx, tmp, 0, n_sorted, n_entries);
+		u16* swap = idx; idx = tmp; tmp = swap;
 	}
-	else
+	
+	// move entries into place, following the permutation cycles
+	DirBufferEntry* entries = dl->entries;
+	for (s32 i = 0; i < n_entries; i++)
 	{
-		// we couldn't really go without recursion here
-		for (; *path != '\0'; path++)
+		if (idx[i] == i)
+			continue;
+		
+		DirBufferEntry swap = entries[i];
+		s32 j = i;
+		while (idx[j] != i)
 		{
-			if (matchName(path, pattern + 1) == true) return true;
+			s32 k = idx[j];
+			entries[j] = entries[k];
+			idx[j] = j;
+			j = k;
 		}
+		entries[j] = swap;
+		idx[j] = j;
 	}
 	
-	return false;
+	free((idx < tmp) ? idx : tmp);
 }
 
 
-static void freeDirBufferContent(DirBufferEntry* dir_buffer, s32 n_entries)
+static s32 findDirEntry(const DirListing* dl, const char* fname)
 {
-	for(s32 i = 0; i < n_entries; i++)
+	for (s32 i = 0; i < dl->n_entries; i++)
 	{
-		if(dir_buffer[i].fname == NULL)
-			break; // this should never happen
-		
-		free (dir_buffer[i].fname);
-		dir_buffer[i].fname = NULL;
+		if (strncmp(entryName(dl, &(dl->entries[i])), fname, FF_MAX_LFN + 1) == 0)
+			return i;
 	}
+	
+	return -1;
 }
 
 
-static void sortDirBuffer(DirBufferEntry* dir_buffer, s32 n_entries)
+/**
+ * @brief Reads the next few entries of a listing that is still streaming in.
+ * @param dl The directory listing.
+ * @param n_chunks Maximum number of DIR_READ_BUF_SIZE sized reads.
+ * @return false on error, the listing is then incomplete and won't be cached.
+ */
+static bool streamDirListing(DirListing* dl, u32 n_chunks)
 {
-	for(s32 s = 0; s < n_entries; s++)
+	const s32 n_entries_old = dl->n_entries;
+	
+	for (u32 c = 0; (c < n_chunks) && dl->streaming; c++)
 	{
-		DirBufferEntry* cmp0 = &(dir_buffer[s]);
-		DirBufferEntry* min0 = cmp0;
+		// filtered on ARM9 side, an empty pattern means dirs only
+		s32 n_read = fReadDirPacked(dl->dhandle, dl->n_entries,
+			*dl->pattern ? 0 : FS_DIR_DIRS_ONLY, *dl->pattern ? dl->pattern : NULL,
+			dl->rbuf, DIR_READ_BUF_SIZE);
+		if (n_read < 0) // error reading dir
+		{
+			stopDirStream(dl);
+			return false;
+		}
 		
-		for(s32 c = s + 1; c < n_entries; c++)
+		const u8* rec_ptr = dl->rbuf;
+		for(s32 i = 0; i < n_read; i++)
 		{
-			DirBufferEntry* cmp1 = &(dir_buffer[c]);
-			if(min0->is_dir != cmp1->is_dir)
+			const FsDirRecord* rec = (const FsDirRecord*) rec_ptr;
+			rec_ptr += FS_DIR_RECORD_SIZE(rec->nameLen);
+			
+			// max dir buffer size reached?
+			if (dl->n_entries >= MAX_DIR_ENTRIES)
 			{
-				if (cmp1->is_dir)
-					min0 = cmp1;
-				continue;
+				n_read = 0; // WARNING: no errors here - list just isn't complete
+				break;
 			}
-			if(strnicmp(min0->fname, cmp1->fname, FF_MAX_LFN + 1) > 0)
+			
+			// take over data (check for out of memory)
+			if (!addDirEntry(dl, rec->fsize, rec->fattrib & AM_DIR, rec->name))
 			{
-				min0 = cmp1;
+				stopDirStream(dl);
+				return false;
 			}
 		}
 		
-		if(min0 != cmp0)
+		// end of dir reached?
+		if (n_read == 0)
 		{
-			DirBufferEntry swap; // swap entries
-			memcpy(&swap, cmp0, sizeof(DirBufferEntry));
-			memcpy(cmp0, min0, sizeof(DirBufferEntry));
-			memcpy(min0, &swap, sizeof(DirBufferEntry));
+			stopDirStream(dl);
+			dl->valid = true;
 		}
 	}
+	
+	sortDirBuffer(dl, n_entries_old);
+	
+	return true;
 }
 
 
-static s32 readDirToBuffer(DirBufferEntry* dir_buffer, const char* path, const char* pattern)
+static void readRootToListing(DirListing* dl)
 {
-	s32 n_entries = 0;
+	const char* root_paths[] = { "sdmc:", "twln:", "twlp:", "nand:" };
+	const char* firm_paths[] = { "firm1:" };
+	const u32 firm_size = 0x400000; // 4MB
+	bool devmode = configDevModeEnabled();
+	WildcardPattern filter;
 	
-	// set dir_buffer to all zeroes
-	memset(dir_buffer, 0, sizeof(DirBufferEntry) * MAX_DIR_ENTRIES);
-	
-	// special handling when in root
-	if(!*path)
+	for(u32 i = 0; i < sizeof(root_paths) / sizeof(const char*); i++)
 	{
-		const char* root_paths[] = { "sdmc:", "twln:", "twlp:", "nand:" };
-		const char* firm_paths[] = { "firm1:" };
-		const u32 firm_size = 0x400000; // 4MB
-		bool devmode = configDevModeEnabled();
+		if (!fsEnsureMounted(root_paths[i]))
+		 	continue;
 		
-		for(u32 i = 0; i < sizeof(root_paths) / sizeof(const char*); i++)
+		addDirEntry(dl, 0, 1, root_paths[i]);
+	}
+	
+	if(devmode && wildcardCompile(&filter, dl->pattern))
+	{
+		for(u32 i = 0; i < sizeof(firm_paths) / sizeof(const char*); i++)
 		{
-			if (!fsEnsureMounted(root_paths[i]))
-			 	continue;
+			if (!wildcardMatch(&filter, firm_paths[i]))
+				continue;
 			
-			dir_buffer[n_entries].fsize = 0;
-			dir_buffer[n_entries].is_dir = 1;
-			dir_buffer[n_entries].fname = strdup(root_paths[i]);
-			n_entries++;
+			addDirEntry(dl, firm_size, 0, firm_paths[i]);
 		}
-		
-		if(devmode)
+	}
+	
+	// never marked valid, mount state may change any time
+}
+
+
+/**
+ * @brief Gets the listing of a directory, either from the cache or freshly read.
+ * Fresh listings only have the first screen of entries read, the rest is
+ * streamed in via streamDirListing().
+ * @param path The directory, empty for root.
+ * @param pattern Only files matching this wildcard pattern will be listed.
+ * @return The listing or NULL on error.
+ */
+static DirListing* openDirListing(const char* path, const char* pattern)
+{
+	FsFileInfo fi;
+	const bool stat_ok = *path && (fStat(path, &fi) == FR_OK);
+	const u32 generation = fGetGeneration();
+	DirListing* dl = NULL;
+	
+	if (!pattern) pattern = ""; // no pattern: dirs only
+	if (strlen(pattern) > WILDCARD_MAX_LEN) return NULL;
+	
+	// check the cache, otherwise pick the slot to replace
+	for (u32 i = 0; i < DIR_CACHE_SLOTS; i++)
+	{
+		DirListing* slot = &(dir_cache[i]);
+		if (slot->valid &&
+			(strncmp(slot->path, path, FF_MAX_LFN + 1) == 0) &&
+			(strncmp(slot->pattern, pattern, WILDCARD_MAX_LEN + 1) == 0))
 		{
-			for(u32 i = 0; i < sizeof(firm_paths) / sizeof(const char*); i++)
+			// a cached listing is only good until anything was written
+			if ((slot->generation == generation) && (slot->stat_ok == stat_ok) &&
+				(!stat_ok || ((slot->fdate == fi.fdate) && (slot->ftime == fi.ftime))))
 			{
-				if (!pattern || !matchName(firm_paths[i], pattern))
-					continue;
-				
-				dir_buffer[n_entries].fsize = firm_size;
-				dir_buffer[n_entries].is_dir = 0;
-				dir_buffer[n_entries].fname = strdup(firm_paths[i]);
-				n_entries++;
+				slot->last_used = ++dir_cache_clock;
+				return slot;
 			}
+			
+			freeDirListing(slot);
 		}
 		
-		return n_entries;
+		if (!dl || (dl->valid && (!slot->valid || (slot->last_used < dl->last_used))))
+			dl = slot;
 	}
-
+	
+	freeDirListing(dl);
+	strncpy(dl->path, path, FF_MAX_LFN);
+	strncpy(dl->pattern, pattern, WILDCARD_MAX_LEN);
+	dl->stat_ok = stat_ok;
+	dl->fdate = stat_ok ? fi.fdate : 0;
+	dl->ftime = stat_ok ? fi.ftime : 0;
+	dl->generation = generation;
+	dl->last_used = ++dir_cache_clock;
+	
+	// special handling when in root
+	if (!*path)
+	{
+		readRootToListing(dl);
+		return dl;
+	}
+	
 	// open directory
-	s32 dhandle = fOpenDir(path);
-	if(dhandle < 0) return -1;
-    
-	FsFileInfo* finfo = (FsFileInfo*) malloc(N_DIR_READ * sizeof(FsFileInfo));
-	if (!finfo) // out of memory
+	dl->dhandle = fOpenDir(path);
+	if (dl->dhandle < 0)
+		return NULL;
+	
+	dl->rbuf = (u8*) malloc(DIR_READ_BUF_SIZE);
+	if (!dl->rbuf) // out of memory
 	{
-		fCloseDir(dhandle);
-		return -1; 
+		fCloseDir(dl->dhandle);
+		return NULL;
 	}
-        
-	s32 n_read = 0;
-	while((n_read = fReadDir(dhandle, finfo, N_DIR_READ)) != 0)
+	dl->streaming = true;
+	
+	// read the first screen right away
+	while (dl->streaming && (dl->n_entries < BRWS_MAX_ENTRIES))
 	{
-		if (n_read < 0) // error reading dir
-			goto fail;
+		if (!streamDirListing(dl, 1))
+		{
+			freeDirListing(dl);
+			return NULL;
+		}
+	}
+	
+	return dl;
+}
+
+
+/**
+ * @brief Done with a listing, keeps it in the cache if it is complete.
+ * @param dl The directory listing.
+ */
+static void closeDirListing(DirListing* dl)
+{
+	if (!dl->valid)
+	{
+		freeDirListing(dl);
+		return;
+	}
+	
+	// drop least recently used listings until within budget
+	while (true)
+	{
+		DirListing* lru = NULL;
+		u32 cache_size = 0;
 		
-		for(s32 i = 0; i < n_read; i++)
+		for (u32 i = 0; i < DIR_CACHE_SLOTS; i++)
 		{
-			if(!(finfo[i].fattrib & AM_DIR) && (!pattern || !matchName(finfo[i].fname, pattern)))
-				continue; // not a match with the provided pattern and not a dir
-			
-			// take over data
-			dir_buffer[n_entries].fsize = finfo[i].fsize;
-			dir_buffer[n_entries].is_dir = finfo[i].fattrib & AM_DIR;
-			dir_buffer[n_entries].fname = strdup(finfo[i].fname);
-			
-			// check for out of memory
-			if (!dir_buffer[n_entries].fname)
-				goto fail;
+			DirListing* slot = &(dir_cache[i]);
+			if (!slot->valid)
+				continue;
 			
-			// max dir buffer size reached?
-			if (++n_entries >= MAX_DIR_ENTRIES)
-				break;
+			cache_size += slot->names_size + (slot->max_entries * sizeof(DirBufferEntry));
+			if (!lru || (slot->last_used < lru->last_used))
+				lru = slot;
 		}
 		
-		// max dir buffer size reached?
-		if (n_entries >= MAX_DIR_ENTRIES)
-			break; // WARNING: no errors here - list just isn't complete
+		if (cache_size <= DIR_CACHE_BUDGET)
+			break;
+		
+		freeDirListing(lru);
 	}
-	
-	fCloseDir(dhandle);
-	free(finfo);
-	
-	if (n_entries > 0)
-		sortDirBuffer(dir_buffer, n_entries);
-	
-	return n_entries;
-	
-	fail:
-	
-	fCloseDir(dhandle);
-	free(finfo);
-	
-	return -1;	
 }
 
 
 /**
  * @brief Draws the file listing to the given console.
  * @param curr_path Current path displayed on screen.
- * @param dir_buffer An array of structs containing the file listing.
- * @param n_entries Number of elements in the above struct.
+ * @param dl The directory listing.
  * @param menu_con Console that the file browser is displayed on.
  * @param index Current placement of the cursor.
  * @param scroll Current scroll offset, will be written to by this function.
  */
-void browserDraw(const char* curr_path, DirBufferEntry* dir_buffer, s32 n_entries, PrintConsole* menu_con, s32 index, s32* scroll)
+void browserDraw(const char* curr_path, const DirListing* dl, PrintConsole* menu_con, s32 index, s32* scroll)
 {
 	int brws_x = (menu_con->windowWidth - BRWS_WIDTH) >> 1;
 	int brws_y = BRWS_OFFSET_TITLE;
@@ -278,21 +500,22 @@ void browserDraw(const char* curr_path, DirBufferEntry* dir_buffer, s32 n_entrie
 	for (s32 i = 0; i < BRWS_MAX_ENTRIES; i++)
 	{
 		s32 pos = i + *scroll;
-		if (pos >= n_entries)
+		if (pos >= dl->n_entries)
 			break;
 		
-		DirBufferEntry* entry = &(dir_buffer[pos]);
+		const DirBufferEntry* entry = &(dl->entries[pos]);
+		const char* fname = entryName(dl, entry);
 		bool is_selected = (pos == index);
 		
 		if(!entry->is_dir)
 			formatBytes(byte_str, entry->fsize);
 		else if (!*curr_path)
-			strncpy(byte_str, (strncmp(entry->fname, "sdmc:", 5+1) == 0) ? "(SD Card)" : "(System)", 31);
+			strncpy(byte_str, (strncmp(fname, "sdmc:", 5+1) == 0) ? "(SD Card)" : "(System)", 31);
 		else
 			strncpy(byte_str, "(DIR)", 31);
 		
 		consoleSetCursor(menu_con, brws_x, brws_y++);
-		truncateString(temp_str, entry->fname, BRWS_WIDTH-13, 8);
+		truncateString(temp_str, fname, BRWS_WIDTH-13, 8);
 		ee_printf(entry->is_dir ? ESC_SCHEME_WEAK : ESC_SCHEME_STD);
 		if (is_selected)ee_printf(ESC_INVERT);
 		ee_printf(" %-*.*s %10.10s ", BRWS_WIDTH-13, BRWS_WIDTH-13, temp_str, byte_str);
@@ -319,12 +542,8 @@ void browserDraw(const char* curr_path, DirBufferEntry* dir_buffer, s32 n_entrie
  */
 bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start, const char* pattern, bool allow_root, bool select_dirs)
 {
-	DirBufferEntry* dir_buffer;
 	bool result = true; // <--- should be handled differently 
 	
-	dir_buffer = (DirBufferEntry*) malloc(MAX_DIR_ENTRIES * sizeof(DirBufferEntry));
-	if (!dir_buffer) return false;
-	
 	// res_path has to be at least 256 byte long (including '\0') and
 	// is also used as temporary buffer
 	*res_path = '\0'; // root dir if start is NULL
@@ -364,12 +583,12 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 	bool is_dir = true; // we are not finished while we have a dir in res_path
 	while(is_dir && result)
 	{
-		s32 n_entries = readDirToBuffer(dir_buffer, res_path, pattern);
+		DirListing* dl = openDirListing(res_path, pattern);
 		s32 last_index = (u32) -1;
 		s32 scroll = 0;
 		s32 index = 0;
 		
-		if (n_entries < 0)
+		if (!dl)
 		{
 			if (*res_path)
 			{
@@ -380,28 +599,36 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 			} else panicMsg("Root filesystem failure!");
 		}
 		
-		// find lastname in listing
-		if (lastname)
-		{
-			for (s32 i = 0; i < n_entries; i++)
-			{
-				if (strncmp(dir_buffer[i].fname, lastname, FF_MAX_LFN + 1) == 0)
-				{
-					index = i;
-					break;
-				}
-			}
-			lastname = NULL;
-		}
-		
 		u32 dbutton_cooldown = 0;
 		while(result)
 		{
+			// find lastname in listing (may still be streaming in)
+			if (lastname)
+			{
+				s32 i = findDirEntry(dl, lastname);
+				if (i >= 0) index = i;
+				if ((i >= 0) || !dl->streaming) lastname = NULL;
+			}
+			
 			// update file browser (on demand)
 			if (index != last_index) {
-				browserDraw(res_path, dir_buffer, n_entries, menu_con, index, &scroll);
+				browserDraw(res_path, dl, menu_con, index, &scroll);
 				last_index = index;
-				updateScreens(); // update screens (VBlank included)
+				updateScreens(); // update screens (no VBlank wait)
+			} else if (dl->streaming) {
+				// stream in the rest of the listing while idle
+				// once moved, the cursor sticks to its entry
+				u32 sel_fname = index ? dl->entries[index].fname : 0;
+				streamDirListing(dl, N_DIR_STREAM);
+				for (s32 i = 0; index && (i < dl->n_entries); i++)
+				{
+					if (dl->entries[i].fname == sel_fname)
+					{
+						index = i;
+						break;
+					}
+				}
+				last_index = (u32) -1; // redraw
 			} else GFX_waitForEvent(GFX_EVENT_PDC0, true); // VBlank
 			
 			// directional button cooldown
@@ -431,20 +658,20 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 			{
 				result = false;
 			}
-			else if ((kDown & (KEY_A|KEY_X)) && n_entries)
+			else if ((kDown & (KEY_A|KEY_X)) && dl->n_entries)
 			{
 				// build new res_path
 				char* name = &(res_path[strlen(res_path)]);
 				if (name > res_path) *(name++) = '/';
-				strncpy(name, dir_buffer[index].fname, ((FF_MAX_LFN + 1) - (name - res_path)));
+				strncpy(name, entryName(dl, &(dl->entries[index])), ((FF_MAX_LFN + 1) - (name - res_path)));
 				
 				// is this a dir? (override when X is detected)
-				is_dir = !(select_dirs && (kDown & KEY_X)) && dir_buffer[index].is_dir;
+				is_dir = !(select_dirs && (kDown & KEY_X)) && dl->entries[index].is_dir;
 				
 				lastname = NULL;
 				break;
 			}
-			else if ((kDown & KEY_X) && !n_entries && select_dirs)
+			else if ((kDown & KEY_X) && !dl->n_entries && select_dirs)
 			{
 				// override when inside a empty DIR in dirselect mode
 				is_dir = false;
@@ -472,23 +699,23 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 					result = false;
 				break;
 			}
-			else if (kHeld & (KEY_DDOWN|KEY_DUP|KEY_DLEFT|KEY_DRIGHT) && n_entries)
+			else if (kHeld & (KEY_DDOWN|KEY_DUP|KEY_DLEFT|KEY_DRIGHT) && dl->n_entries)
 			{
 				if (kHeld & KEY_DDOWN)
 				{
 					// cursor down
-					index = (index == n_entries - 1) ? 0 : index + 1;
+					index = (index == dl->n_entries - 1) ? 0 : index + 1;
 				}
 				else if (kHeld & KEY_DUP)
 				{
 					// cursor up
-					index = (index == 0) ? n_entries - 1 : index - 1;
+					index = (index == 0) ? dl->n_entries - 1 : index - 1;
 				}
 				else if (kHeld & KEY_DRIGHT)
 				{
 					// cursor down a page
 					index += BRWS_MAX_ENTRIES;
-					if (index >= n_entries) index = n_entries - 1;
+					if (index >= dl->n_entries) index = dl->n_entries - 1;
 				}
 				else if (kHeld & KEY_DLEFT)
 				{
@@ -502,10 +729,8 @@ bool menuFileSelector(char* res_path, PrintConsole* menu_con, const char* start,
 			}
 		}
 		
-		freeDirBufferContent(dir_buffer, n_entries);
+		closeDirListing(dl);
 	}
 	
-	free(dir_buffer);
-	
 	return result;
 }
\ No newline at end of file
@@ -44,6 +44,7 @@
 #include "arm11/debug.h"
 #include "arm11/fmt.h"
 #include "arm11/firm.h"
+#include "perf.h"
 
 
 
@@ -146,6 +147,15 @@ u32 menuPresetBootMode(void)
 }
 
 
+static const char* firmErrorType(s32 res)
+{
+	// codes past the generic load/verify ones (see arm11/firm.h)
+	if (res == FIRM_ERR_PUBKEY_LOAD) return "key load";
+	if (res == FIRM_ERR_INVALID_SIG) return "signature";
+	return (res > -8) ? "load" : "verify";
+}
+
+
 u32 menuReturn(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 {
 	(void) term_con;
@@ -248,25 +258,16 @@ u32 menuSetSplash(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 			if (fHandle < 0) continue; // can not open
 			
 			u8* splash_buffer = (u8*) malloc(splash_bin_size);
-			if (!splash_buffer) panicMsg("Out of memory");
+			u8* splash_out = (u8*) malloc(splash_bin_width[i] * splash_bin_height[i] * 2);
+			if (!splash_buffer || !splash_out) panicMsg("Out of memory");
 			
 			fRead(fHandle, splash_buffer, splash_bin_size);
 			fClose(fHandle);
 			
-			// convert RGB888 -> RGB565
-			u8* ptr_out = splash_buffer;
-			for (u8* ptr_in = splash_buffer;
-				ptr_in - splash_buffer < (int) splash_bin_size;
-				ptr_in += 3, ptr_out += 2)
-			{
-				u16 rgb565 =
-					(ptr_in[2] >> 3) << (6 + 5) |
-					(ptr_in[1] >> 2) << 5 |
-					(ptr_in[0] >> 3);
-				
-				ptr_out[0] = rgb565 & 0xFF;
-				ptr_out[1] = rgb565 >> 8; 
-			}
+			// convert RGB888 -> RGB565 on all available cores
+			splashConvertRgb888(splash_buffer, (u16*) splash_out, splash_bin_width[i] * splash_bin_height[i]);
+			free(splash_buffer);
+			splash_buffer = splash_out;
 			
 			// build the .spla header
 			SplashHeader hdr;
@@ -396,6 +397,7 @@ u32 menuSetupBootSlot(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	// if bit4 of param is set, reset slot and return
 	if (param & 0x10)
 	{
+		configDeleteKey(KBootOption1PubKey + slot);
 		configDeleteKey(KBootOption1Buttons + slot);
 		configDeleteKey(KBootOption1 + slot);
 		return MENU_OK;
@@ -546,10 +548,10 @@ u32 menuLaunchFirm(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	
 	// try load and verify
 	ee_printf("\nLoading %s...\n", path);
-	s32 res = loadVerifyFirm(path, false);
+	s32 res = (param < N_BOOTSLOTS) ? loadVerifyBootslot(param) : loadVerifyFirm(path, false);
 	if (res < 0)
 	{
-		ee_printf("Firm %s error code %li!\n", (res > -8) ? "load" : "verify", res);
+		ee_printf("Firm %s error code %li!\n", firmErrorType(res), res);
 		goto fail;
 	}
 	
@@ -656,29 +658,33 @@ u32 menuBackupNand(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	
 	
 	// all done, ready to do the NAND backup
+	// progress is drawn on core 1 while core 0 waits for the ARM9
 	ee_printf("\n");
+	progressTaskStart("NAND backup", PROGRESS_WIDTH);
 	for (s64 p = 0; p < nand_size; p += DEVICE_BUFSIZE)
 	{
 		s64 readBytes = (nand_size - p > DEVICE_BUFSIZE) ? DEVICE_BUFSIZE : nand_size - p;
 		s32 errcode = 0;
-		ee_printf_progress("NAND backup", PROGRESS_WIDTH, p, nand_size);
-		updateScreens();
+		progressTaskUpdate(p, nand_size);
 		
 		if ((errcode = fReadToDeviceBuffer(devHandle, p, readBytes, dbufHandle)) != 0)
 		{
+			progressTaskStop();
 			ee_printf("\nError: Cannot read from NAND (%li)!\n", errcode);
 			goto fail_close_handles;
 		}
 		
 		if ((errcode = fsWriteFromDeviceBuffer(fHandle, p, readBytes, dbufHandle)) != 0)
 		{
+			progressTaskStop();
 			ee_printf("\nError: Cannot write to file (%li)!\n", errcode);
 			goto fail_close_handles;
 		}
 		
 		// check for user cancel request
-		if (userCancelHandler(true))
+		if (progressTaskCancelHandler(true))
 		{
+			progressTaskStop();
 			fFinalizeRawAccess(devHandle);
 			fFreeDeviceBuffer(dbufHandle);
 			fClose(fHandle);
@@ -688,6 +694,7 @@ u32 menuBackupNand(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	}
 	
 	// NAND access finalized
+	progressTaskStop();
 	ee_printf_progress("NAND backup", PROGRESS_WIDTH, nand_size, nand_size);
 	ee_printf("\n" ESC_SCHEME_GOOD "NAND backup finished.\n" ESC_RESET);
 	result = MENU_OK;
@@ -833,29 +840,32 @@ u32 menuRestoreNand(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	
 	// all done, ready to do the NAND backup
 	ee_printf("\n");
+	progressTaskStart("NAND restore", PROGRESS_WIDTH);
 	for (s64 p = 0; p < file_size; p += DEVICE_BUFSIZE)
 	{
 		s64 readBytes = (file_size - p > DEVICE_BUFSIZE) ? DEVICE_BUFSIZE : file_size - p;
 		s32 errcode = 0;
-		ee_printf_progress("NAND restore", PROGRESS_WIDTH, p, file_size);
-		updateScreens();
+		progressTaskUpdate(p, file_size);
 		
 		if ((errcode = fReadToDeviceBuffer(fHandle, p, readBytes, dbufHandle)) != 0)
 		{
+			progressTaskStop();
 			ee_printf("\nError: Cannot read from file (%li)!\n", errcode);
 			goto fail_close_handles;
 		}
 		
 		if ((errcode = fsWriteFromDeviceBuffer(devHandle, p, readBytes, dbufHandle)) != 0)
 		{
+			progressTaskStop();
 			ee_printf("\nError: Cannot write to NAND (%li)!\n", errcode);
 			goto fail_close_handles;
 		}
 		
 		// check for user cancel request
 		// cancel is forbidden(!) here, but we need to handle force poweroff
-		if (userCancelHandler(false))
+		if (progressTaskCancelHandler(false))
 		{
+			progressTaskStop();
 			fFinalizeRawAccess(devHandle);
 			fFreeDeviceBuffer(dbufHandle);
 			fClose(fHandle);
@@ -864,6 +874,7 @@ u32 menuRestoreNand(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	}
 	
 	// NAND access finalized
+	progressTaskStop();
 	ee_printf_progress("NAND restore", PROGRESS_WIDTH, file_size, file_size);
 	ee_printf("\n" ESC_SCHEME_GOOD "NAND restore finished.\n" ESC_RESET);
 	result = MENU_OK;
@@ -926,7 +937,7 @@ u32 menuInstallFirm(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	if (res < 0)
 	{
 		ee_printf(ESC_SCHEME_BAD "failed!\n" ESC_RESET);
-		ee_printf("Firm %s error code %li!\n", (res > -8) ? "load" : "verify", res);
+		ee_printf("Firm %s error code %li!\n", firmErrorType(res), res);
 		goto fail;
 	}
 	
@@ -1284,6 +1295,105 @@ u32 debugSettingsView(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 	return 0;
 }
 
+#ifdef PERF_MENU
+static u64 perfTicksToUs(u64 ticks, u32 tickFreq)
+{
+	return (ticks * 1000000) / tickFreq;
+}
+
+static bool exportPerfCounters(const char* path, const PerfCounters* arm9, const PerfCounters* arm11)
+{
+	// storage, crypto and FatFs only run on ARM9, ARM11 only has PXI
+	const struct
+	{
+		const char* name;
+		u64 value;
+	} rows[] =
+	{
+		{ "arm9_sd_cmds",       arm9->sdmmcCmds[PERF_DEV_SD] },
+		{ "arm9_sd_bytes",      arm9->sdmmcBytes[PERF_DEV_SD] },
+		{ "arm9_sd_us",         perfTicksToUs(arm9->sdmmcTicks[PERF_DEV_SD], arm9->tickFreq) },
+		{ "arm9_nand_cmds",     arm9->sdmmcCmds[PERF_DEV_NAND] },
+		{ "arm9_nand_bytes",    arm9->sdmmcBytes[PERF_DEV_NAND] },
+		{ "arm9_nand_us",       perfTicksToUs(arm9->sdmmcTicks[PERF_DEV_NAND], arm9->tickFreq) },
+		{ "arm9_aes_blocks",    arm9->aesBlocks },
+		{ "arm9_sha_bytes",     arm9->shaBytes },
+		{ "arm9_pxi_cmds",      arm9->pxiCmds },
+		{ "arm9_pxi_wait_us",   perfTicksToUs(arm9->pxiWaitTicks, arm9->tickFreq) },
+		{ "arm9_fatfs_hits",    arm9->fatfsHits },
+		{ "arm9_fatfs_misses",  arm9->fatfsMisses },
+		{ "arm11_pxi_cmds",     arm11->pxiCmds },
+		{ "arm11_pxi_wait_us",  perfTicksToUs(arm11->pxiWaitTicks, arm11->tickFreq) }
+	};
+	const u32 n_rows = sizeof(rows) / sizeof(rows[0]);
+	
+	char* csv = (char*) malloc(64 * (n_rows + 1));
+	if (!csv) return false;
+	
+	char* ptr = csv;
+	ptr += ee_sprintf(ptr, "counter,value\n");
+	for (u32 i = 0; i < n_rows; i++)
+		ptr += ee_sprintf(ptr, "%s,%llu\n", rows[i].name, rows[i].value);
+	
+	const bool res = fsQuickCreate(path, csv, ptr - csv);
+	free(csv);
+	
+	return res;
+}
+
+u32 menuShowPerfCounters(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
+{
+	(void) menu_con;
+	(void) param;
+	
+	// ARM9 first so the PXI counters below include this request
+	PerfCounters arm9, arm11;
+	perfGetArm9(&arm9);
+	perfCopy(&arm11);
+	
+	// clear console
+	consoleSelect(term_con);
+	consoleClear();
+	
+	const char* dev_names[2] = { "SD", "NAND" };
+	for (u32 dev = PERF_DEV_SD; dev <= PERF_DEV_NAND; dev++)
+	{
+		const u64 us = perfTicksToUs(arm9.sdmmcTicks[dev], arm9.tickFreq);
+		ee_printf("%-5s %lu cmds, %llu bytes, %llu ms", dev_names[dev],
+			arm9.sdmmcCmds[dev], arm9.sdmmcBytes[dev], us / 1000);
+		if (us) ee_printf(" (%llu KiB/s)", (arm9.sdmmcBytes[dev] * 1000000 / 1024) / us);
+		ee_printf("\n");
+	}
+	ee_printf("AES   %llu blocks\n", arm9.aesBlocks);
+	ee_printf("SHA   %llu bytes\n", arm9.shaBytes);
+	ee_printf("PXI   ARM11: %lu cmds, %llu ms waited\n", arm11.pxiCmds,
+		perfTicksToUs(arm11.pxiWaitTicks, arm11.tickFreq) / 1000);
+	ee_printf("      ARM9:  %lu cmds, %llu ms waited\n", arm9.pxiCmds,
+		perfTicksToUs(arm9.pxiWaitTicks, arm9.tickFreq) / 1000);
+	ee_printf("FatFs %lu window hits, %lu misses\n", arm9.fatfsHits, arm9.fatfsMisses);
+	ee_printf("\nPress A to export to %s.\nPress B to return.\n", PERF_CSV_PATH);
+	updateScreens();
+	
+	// wait for B / HOME button, A exports
+	do
+	{
+		GFX_waitForEvent(GFX_EVENT_PDC0, true);
+		if(hidGetPowerButton(false)) // handle power button
+			return 0;
+		
+		hidScanInput();
+		if (hidKeysDown() & KEY_A)
+		{
+			ee_printf("Export %s.\n", exportPerfCounters(PERF_CSV_PATH, &arm9, &arm11) ? "success" : "failed");
+			updateScreens();
+		}
+	}
+	while (!(hidKeysDown() & KEY_B || hidGetExtraKeys(0) & KEY_HOME));
+	
+	return 0;
+}
+#endif
+
 u32 debugEscapeTest(PrintConsole* term_con, PrintConsole* menu_con, u32 param)
 {
 	(void) menu_con;
@@ -21,6 +21,7 @@
 #include "types.h"
 #include "fs.h"
 #include "hardware/gfx.h"
+#include "arm11/hardware/hash.h"
 #include "arm11/hardware/hid.h"
 #include "arm11/hardware/mcu.h"
 #include "arm.h"
@@ -29,6 +30,8 @@
 #include "arm11/menu/splash.h"
 #include "arm11/console.h"
 #include "arm11/fmt.h"
+#include "arm11/work.h"
+#include "arm11/spinlock.h"
 
 #define BORDER_WIDTH	2 // in pixel
 
@@ -56,18 +59,25 @@ void truncateString(char* dest, const char* orig, int nsize, int tpos)
 void formatBytes(char* str, u64 bytes)
 {
 	// str should be 32 byte in size, just to be safe
+	// called for every file on each browser redraw, so no format string parsing
+	static const FmtSpec decimal = FMT_SPEC('u', 0, -1, -1);
 	const char* units[] = {"  Byte", " kiB", " MiB", " GiB"};
+	u32 len;
 	
 	if (bytes < 1024)
 	{
-		ee_snprintf(str, 32, "%llu%s", bytes, units[0]);
+		len = ee_fmtNumber(str, 32, bytes, &decimal);
+		strncpy(str + len, units[0], 32 - len);
 	}
 	else
 	{
 		u32 scale = 1;
 		u64 bytes100 = (bytes * 100) >> 10;
 		for(; (bytes100 >= 1024*100) && (scale < 3); scale++, bytes100 >>= 10);
-		ee_snprintf(str, 32, "%llu.%llu%s", bytes100 / 100, (bytes100 % 100) / 10, units[scale]);
+		len = ee_fmtNumber(str, 32, bytes100 / 100, &decimal);
+		str[len++] = '.';
+		str[len++] = '0' + (bytes100 % 100) / 10;
+		strncpy(str + len, units[scale], 32 - len);
 	}
 }
 
@@ -178,32 +188,33 @@ u32 ee_printf_screen_center(const char *const fmt, ...)
 // prints a progress indicator (no args allowed, for byte values)
 u32 ee_printf_progress(const char *const fmt, u32 w, u64 curr, u64 max)
 {
-	u32 res = 0;
-	
 	u32 prog_w = (u32) ((max > 0) && (curr <= max)) ? ((u64) curr * w) / max : 0;
     u32 prog_p = (u32) ((max > 0) && (curr <= max)) ? ((u64) curr * 100) / max : 0;
 	
-	
-	res += ee_printf(ESC_SCHEME_ACCENT1 "%s" ESC_RESET " | ", fmt);
-	
-	u32 i = 0;
-	ee_printf(ESC_SCHEME_WEAK);
-	for (; i < prog_w; i++) res += ee_printf("\xDB");
-	for (; i < w; i++) res += ee_printf("\xB1");
-	ee_printf(ESC_RESET);
-	
-	res += ee_printf(" | %s%lu%%%s | %s%llu / %llu MiB%s\r",
+	// whole bar in one go instead of a printf per char
+	char bar[64];
+	if (w > sizeof(bar) - 1) w = sizeof(bar) - 1;
+	if (prog_w > w) prog_w = w;
+	memset(bar, '\xDB', prog_w);
+	memset(bar + prog_w, '\xB1', w - prog_w);
+	bar[w] = '\0';
+	
+	// one printf so the line is written under a single console lock
+	// (the progress task prints from core 1)
+	return ee_printf(ESC_SCHEME_ACCENT1 "%s" ESC_RESET " | " ESC_SCHEME_WEAK "%s" ESC_RESET " | %s%lu%%%s | %s%llu / %llu MiB%s\r",
+		fmt, bar,
 		(curr == max) ? ESC_SCHEME_GOOD : "", prog_p, (curr == max) ? ESC_RESET : "",
 		(curr == max) ? ESC_SCHEME_GOOD : "", curr / 0x100000, max / 0x100000, (curr == max) ? ESC_RESET : "");
-	
-	
-	return res;
 }
 
 void clearScreens(void)
 {
 	GX_memoryFill((u64*)RENDERBUF_TOP, 1u<<9, SCREEN_SIZE_TOP, 0, (u64*)RENDERBUF_SUB, 1u<<9, SCREEN_SIZE_SUB, 0);
 	GFX_waitForEvent(GFX_EVENT_PSC0, true);
+	GFX_markRenderbufDirty(SCREEN_TOP, 0, SCREEN_WIDTH_TOP);
+	GFX_markRenderbufDirty(SCREEN_SUB, 0, SCREEN_WIDTH_SUB);
+	consoleInvalidate(SCREEN_TOP, 0, SCREEN_WIDTH_TOP);
+	consoleInvalidate(SCREEN_SUB, 0, SCREEN_WIDTH_SUB);
 }
 
 void drawTopBorder(void)
@@ -219,6 +230,7 @@ void drawTopBorder(void)
 		color = consoleGetRGB565Color((rtc[0] % 6) + 1);
 	}
 	
+	consoleFlush();
 	for(u32 x = 0; x < SCREEN_WIDTH_TOP; x++)
 	{
 		for(u32 y = 0; y < SCREEN_HEIGHT_TOP; y++)
@@ -229,62 +241,173 @@ void drawTopBorder(void)
 			fb++;
 		}
 	}
+	GFX_markRenderbufDirty(SCREEN_TOP, 0, SCREEN_WIDTH_TOP);
+	consoleInvalidate(SCREEN_TOP, 0, SCREEN_WIDTH_TOP);
 }
 
-bool drawCustomSplash(const char* folder)
+static void hashSplashData(const void* data, u32 size, u32* out)
 {
-	// this assumes top and bottom screens cleared
-	const u32 splash_max_size = sizeof(SplashHeader) + (SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP * 2);
-	char* splash_path =  (char*) malloc(FF_MAX_LFN + 1);
-	u8* splash_buffer = (u8*) malloc(splash_max_size + (30 * 1024));
-	bool res = false;
-	s32 fHandle;
+	hash((const u32*) data, size, out, HASH_INPUT_BIG | HASH_MODE_256, HASH_OUTPUT_BIG);
+}
+
+// loads the cached splash for the .spla described by src_info into the
+// render buffer in a single read, false if there is no valid cache
+static bool loadSplashCache(const char* cache_path, const FsFileInfo* src_info, u8 screen)
+{
+	const u32 screen_width = (screen == SCREEN_TOP) ? SCREEN_WIDTH_TOP : SCREEN_WIDTH_SUB;
+	const u32 col_size = SCREEN_HEIGHT_TOP * 2;
+	SplashCacheHeader hdr;
 	
-	if (!splash_path || !splash_buffer) goto fail;
+	s32 fHandle = fOpen(cache_path, FS_OPEN_EXISTING | FS_OPEN_READ);
+	if (fHandle < 0) return false;
 	
-	// try top splash
-	ee_snprintf(splash_path, FF_MAX_LFN + 1, "%s/%s.spla", folder, CSPLASH_NAME_TOP);
-	fHandle = fOpen(splash_path, FS_OPEN_EXISTING | FS_OPEN_READ);
-	if (fHandle >= 0)
+	bool valid = (fRead(fHandle, &hdr, sizeof(SplashCacheHeader)) == FR_OK) &&
+		(memcmp(&hdr.magic, "SPLC", 4) == 0) && (hdr.version == SPLASH_CACHE_VERSION) &&
+		(hdr.screen == screen) && (hdr.srcSize == src_info->fsize) &&
+		(hdr.srcDate == src_info->fdate) && (hdr.srcTime == src_info->ftime) &&
+		hdr.numCols && (hdr.firstCol + hdr.numCols <= screen_width) &&
+		(fSize(fHandle) == sizeof(SplashCacheHeader) + (hdr.numCols * col_size));
+	
+	if (!valid)
 	{
-		u32 splash_size = fSize(fHandle);
-		u16 *const splash_data = (u16*)(splash_buffer + splash_max_size + (30 * 1024) - splash_size);
-		if ((splash_size < sizeof(SplashHeader)) || (splash_size > splash_max_size) ||
-			(fRead(fHandle, splash_data, splash_size) != FR_OK))
-		{
-			fClose(fHandle);
-			goto fail;
-		}
 		fClose(fHandle);
+		return false;
+	}
+	
+	// read straight into the render buffer
+	consoleFlush();
+	u8* fb = (u8*) ((screen == SCREEN_TOP) ? RENDERBUF_TOP : RENDERBUF_SUB) + (hdr.firstCol * col_size);
+	const u32 size = hdr.numCols * col_size;
+	valid = (fRead(fHandle, fb, size) == FR_OK);
+	fClose(fHandle);
+	
+	u32 img_hash[8];
+	if (valid)
+	{
+		hashSplashData(fb, size, img_hash);
+		valid = (memcmp(img_hash, hdr.imgHash, sizeof(img_hash)) == 0);
+	}
+	
+	// this assumes the screen was cleared before
+	if (!valid) memset(fb, 0, size);
+	GFX_markRenderbufDirty(screen, hdr.firstCol, hdr.numCols);
+	consoleInvalidate(screen, hdr.firstCol, hdr.numCols);
+	
+	return valid;
+}
+
+// writes the drawn splash columns to the cache, rewrites only the key
+// if the .spla file was touched without changing its content
+static void updateSplashCache(const char* cache_path, const FsFileInfo* src_info, const u32* src_hash, u8 screen, u32 first_col, u32 num_cols)
+{
+	const u32 col_size = SCREEN_HEIGHT_TOP * 2;
+	const u8* fb = (const u8*) ((screen == SCREEN_TOP) ? RENDERBUF_TOP : RENDERBUF_SUB) + (first_col * col_size);
+	const u32 size = num_cols * col_size;
+	SplashCacheHeader hdr;
+	
+	s32 fHandle = fOpen(cache_path, FS_OPEN_EXISTING | FS_OPEN_READ | FS_OPEN_WRITE);
+	bool content_valid = (fHandle >= 0) &&
+		(fRead(fHandle, &hdr, sizeof(SplashCacheHeader)) == FR_OK) &&
+		(memcmp(&hdr.magic, "SPLC", 4) == 0) && (hdr.version == SPLASH_CACHE_VERSION) &&
+		(hdr.screen == screen) && (hdr.firstCol == first_col) && (hdr.numCols == num_cols) &&
+		(memcmp(hdr.srcHash, src_hash, sizeof(hdr.srcHash)) == 0) &&
+		(fSize(fHandle) == sizeof(SplashCacheHeader) + size);
+	
+	if (!content_valid)
+	{
+		if (fHandle >= 0) fClose(fHandle);
+		fHandle = fOpen(cache_path, FS_CREATE_ALWAYS | FS_OPEN_WRITE);
+		if (fHandle < 0) return;
 		
-		if (drawSplashscreen(splash_data, (u16*)splash_buffer, -1, -1, SCREEN_TOP))
-			res = true;
+		memset(&hdr, 0, sizeof(SplashCacheHeader));
+		memcpy(&hdr.magic, "SPLC", 4);
+		hdr.version = SPLASH_CACHE_VERSION;
+		hdr.screen = screen;
+		memcpy(hdr.srcHash, src_hash, sizeof(hdr.srcHash));
+		hashSplashData(fb, size, hdr.imgHash);
+		hdr.firstCol = first_col;
+		hdr.numCols = num_cols;
 	}
+	hdr.srcSize = src_info->fsize;
+	hdr.srcDate = src_info->fdate;
+	hdr.srcTime = src_info->ftime;
+	
+	bool ok = (fLseek(fHandle, 0) == FR_OK) &&
+		(fWrite(fHandle, &hdr, sizeof(SplashCacheHeader)) == FR_OK) &&
+		(content_valid || (fWrite(fHandle, fb, size) == FR_OK));
+	fClose(fHandle);
+	
+	if (!ok) fUnlink(cache_path);
+}
+
+bool drawCustomSplash(const char* folder, SplashAnim* anims)
+{
+	// this assumes top and bottom screens cleared
+	// animated splashes may use some more space for their frames
+	const u32 splash_max_size = sizeof(SplashHeader) + (SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP * 2) + (32 * 1024);
+	const char* splash_name[] = { CSPLASH_NAME_SUB, CSPLASH_NAME_TOP };
+	char* splash_path =  (char*) malloc((FF_MAX_LFN + 1) * 2);
+	char* cache_path = splash_path + FF_MAX_LFN + 1;
+	bool res = false;
 	
-	// try bottom splash
-	ee_snprintf(splash_path, FF_MAX_LFN + 1, "%s/%s.spla", folder, CSPLASH_NAME_SUB);
-	fHandle = fOpen(splash_path, FS_OPEN_EXISTING | FS_OPEN_READ);
-	if (fHandle >= 0)
+	if (!splash_path) return false;
+	
+	// try top splash first, then bottom splash
+	for (s32 screen = SCREEN_TOP; screen >= SCREEN_SUB; screen--)
 	{
+		ee_snprintf(splash_path, FF_MAX_LFN + 1, "%s/%s.spla", folder, splash_name[screen]);
+		ee_snprintf(cache_path, FF_MAX_LFN + 1, "%s/%s.cache", folder, splash_name[screen]);
+		
+		FsFileInfo splash_info;
+		if (fStat(splash_path, &splash_info) != FR_OK) continue;
+		
+		// a valid cache saves reading, decompressing and rotating the splash
+		if (loadSplashCache(cache_path, &splash_info, screen))
+		{
+			res = true;
+			continue;
+		}
+		
+		s32 fHandle = fOpen(splash_path, FS_OPEN_EXISTING | FS_OPEN_READ);
+		if (fHandle < 0) continue;
+		
 		u32 splash_size = fSize(fHandle);
-		u16 *const splash_data = (u16*)(splash_buffer + splash_max_size + (30 * 1024) - splash_size);
+		u32 splash_padded = (splash_size + 3) & ~3u; // for the hash engine
+		u8* splash_buffer = NULL;
 		if ((splash_size < sizeof(SplashHeader)) || (splash_size > splash_max_size) ||
-			(fRead(fHandle, splash_data, splash_size) != FR_OK))
+			!(splash_buffer = (u8*) malloc(splash_padded)) ||
+			(fRead(fHandle, splash_buffer, splash_size) != FR_OK))
 		{
 			fClose(fHandle);
-			goto fail;
+			if (splash_buffer) free(splash_buffer);
+			break;
 		}
 		fClose(fHandle);
+		memset(splash_buffer + splash_size, 0, splash_padded - splash_size);
 		
-		if (drawSplashscreen(splash_data, (u16*)splash_buffer, -1, -1, SCREEN_SUB))
+		// the animation keeps its data until splashAnimStop()
+		SplashAnim single;
+		SplashAnim* anim = anims ? &anims[screen] : &single;
+		if (splashAnimStart(anim, splash_buffer, splash_size, -1, -1, screen))
+		{
 			res = true;
+			if ((anim->numFrames > 1) && anims)
+			{
+				anim->buffer = splash_buffer;
+				continue;
+			}
+			else if (anim->numFrames == 1) // only static splashes are cached
+			{
+				u32 src_hash[8];
+				hashSplashData(splash_buffer, splash_padded, src_hash);
+				updateSplashCache(cache_path, &splash_info, src_hash, screen, anim->xx, anim->width);
+			}
+		}
+		
+		free(splash_buffer);
 	}
 	
-	
-	fail:
-	
-	if (splash_path) free(splash_path);
-	if (splash_buffer) free(splash_buffer);
+	free(splash_path);
 	
 	return res;
 }
@@ -305,10 +428,10 @@ void sleepmode(void)
 
 void updateScreens(void)
 {
-	GX_textureCopy((u64*)RENDERBUF_TOP, 0, (u64*)GFX_getFramebuffer(SCREEN_TOP),
-				   0, SCREEN_SIZE_TOP + SCREEN_SIZE_SUB);
-	GFX_swapFramebufs();
-	GFX_waitForEvent(GFX_EVENT_PDC0, true); // VBlank
+	// Only copies what changed. The VBlank wait for the swap is
+	// deferred until the back buffers are written again.
+	consoleFlush();
+	GFX_presentRenderbufs();
 }
 
 bool askConfirmation(const char *const fmt, ...)
@@ -366,10 +489,8 @@ void outputEndWait(void)
 	while (!(kDown & KEY_B || extraKeys & KEY_HOME));
 }
 
-bool userCancelHandler(bool cancelAllowed)
+static bool userCancelCheck(u32 kDown, bool cancelAllowed)
 {
-	hidScanInput();
-	u32 kDown = hidKeysDown();
 	u32 extraKeys = hidGetExtraKeys(0);
 	
 	// detect force poweroff
@@ -412,3 +533,108 @@ bool userCancelHandler(bool cancelAllowed)
 	
 	return false;
 }
+
+bool userCancelHandler(bool cancelAllowed)
+{
+	hidScanInput();
+	return userCancelCheck(hidKeysDown(), cancelAllowed);
+}
+
+// Progress line drawn on core 1 while core 0 is blocked in long I/O.
+// Core 1 can't use I2C, so HOME/POWER/shell are still read by core 0.
+// The console and render buffer state is locked in console.c and gfx.c
+// so core 0 may still print while the task runs.
+static Mailbox progressBox;
+static WorkItem progressWork;
+static const char *progressFmt;
+static u32 progressWidth;
+static volatile bool progressRunning = false;
+static volatile bool progressStopReq;
+static u32 progressKeysLock = 0;
+static u32 progressKeys;
+
+static void progressTask(UNUSED void *arg)
+{
+	u32 seq = 0, msg[4];
+	u32 padOld = REG_HID_PAD;
+	
+	while (!progressStopReq)
+	{
+		if (mailboxFetch(&progressBox, &seq, msg))
+		{
+			ee_printf_progress(progressFmt, progressWidth, (u64)msg[1]<<32 | msg[0], (u64)msg[3]<<32 | msg[2]);
+			updateScreens();
+		}
+		
+		// latch button presses between two checks on core 0
+		const u32 pad = REG_HID_PAD;
+		if (~padOld & pad)
+		{
+			spinlockLock(&progressKeysLock);
+			progressKeys |= ~padOld & pad;
+			spinlockUnlock(&progressKeysLock);
+		}
+		padOld = pad;
+		
+		GFX_waitForEvent(GFX_EVENT_PDC0, true);
+	}
+}
+
+bool progressTaskStart(const char *const fmt, u32 w)
+{
+	if (progressRunning) return true;
+	
+	progressFmt = fmt;
+	progressWidth = w;
+	progressBox.seq = 0;
+	progressKeys = 0;
+	progressStopReq = false;
+	progressWork.func = progressTask;
+	progressWork.arg = NULL;
+	progressRunning = workSubmit(&progressWork);
+	
+	return progressRunning;
+}
+
+void progressTaskUpdate(u64 curr, u64 max)
+{
+	if (!progressRunning)
+	{
+		ee_printf_progress(progressFmt, progressWidth, curr, max);
+		updateScreens();
+		return;
+	}
+	
+	const u32 msg[4] = {(u32)curr, (u32)(curr>>32), (u32)max, (u32)(max>>32)};
+	mailboxPost(&progressBox, msg);
+}
+
+void progressTaskStop(void)
+{
+	if (!progressRunning) return;
+	
+	progressStopReq = true;
+	workWait(&progressWork);
+	progressRunning = false;
+}
+
+bool progressTaskCancelHandler(bool cancelAllowed)
+{
+	if (!progressRunning) return userCancelHandler(cancelAllowed);
+	
+	hidScanInput();
+	spinlockLock(&progressKeysLock);
+	const u32 kDown = hidKeysDown() | progressKeys;
+	progressKeys = 0;
+	spinlockUnlock(&progressKeysLock);
+	
+	if (!(kDown & KEY_B) && !(hidGetExtraKeys(0) & (KEY_HOME | KEY_POWER | KEY_POWER_HELD | KEY_SHELL)))
+		return false;
+	
+	// the dialog prints and may enter sleep mode
+	progressTaskStop();
+	const bool cancel = userCancelCheck(kDown, cancelAllowed);
+	if (!cancel) progressTaskStart(progressFmt, progressWidth);
+	
+	return cancel;
+}
@@ -20,9 +20,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include "types.h"
+#include "util.h"
 #include "arm11/menu/splash.h"
 #include "arm11/lz11.h"
+#include "arm11/jobs.h"
 #include "hardware/gfx.h"
+#include "arm11/console.h"
+
+
+#define CONV_JOB_PIXELS  (4096)
+
+
+typedef struct
+{
+	const u8 *in;
+	u16 *out;
+	u32 pixels;
+} ConvJob;
 
 
 
@@ -50,24 +64,101 @@ static bool validateSplashHeader(const SplashHeader *const header, u8 screen)
 	return true;
 }
 
-bool drawSplashscreen(const void *const data, u16 *const tmpBuf, s32 startX, s32 startY, u8 screen)
+// Copies a rotated image (one column of height pixels after another) to the
+// render buffer. fb points at the top left pixel of the destination.
+// Splash data lives in AXI WRAM which the transfer engines can't read
+// so this is always a CPU copy.
+static void blitSplash(const u8 *const img, u16 *const fb, u32 width, u32 height, u32 screenHeight)
+{
+	const u32 colSize = height * 2;
+
+	if(height == screenHeight) memcpy(fb, img, width * colSize); // Full height. Columns are contiguous.
+	else
+	{
+		for(u32 x = 0; x < width; x++)
+			memcpy(&fb[x * screenHeight], &img[x * colSize], colSize);
+	}
+}
+
+static void convertRgb888Job(void *arg, u32 index)
+{
+	const ConvJob *const job = (const ConvJob*)arg;
+	const u32 first = index * CONV_JOB_PIXELS;
+	const u32 last = min(first + CONV_JOB_PIXELS, job->pixels);
+
+	const u8 *in = job->in + first * 3;
+	for(u32 i = first; i < last; i++, in += 3)
+		job->out[i] = (in[2] >> 3) << 11 | (in[1] >> 2) << 5 | in[0] >> 3;
+}
+
+void splashConvertRgb888(const u8 *const in, u16 *const out, u32 pixels)
+{
+	ConvJob job = {in, out, pixels};
+	jobsRun(convertRgb888Job, &job, (pixels + CONV_JOB_PIXELS - 1) / CONV_JOB_PIXELS);
+}
+
+static u32 msecToVblanks(u32 msec)
+{
+	// The LCDs refresh at about 59.83 Hz.
+	return (msec * 5983 + 99999) / 100000;
+}
+
+// Draws columns firstCol to firstCol + numCols - 1 of the image.
+static bool drawSplashColumns(const SplashAnim *const anim, u32 firstCol, u32 numCols, const u8 *const data, u32 dataSize)
+{
+	if(firstCol + numCols > anim->width) return false;
+	if(!numCols) return true;
+
+	const u32 height = anim->height, screenHeight = anim->screenHeight;
+	u16 *const fb = anim->fb + firstCol * screenHeight;
+	bool res = true;
+	if(anim->compressed)
+	{
+		// Decompress straight into the framebuffer, one image column per run.
+		res = lz11DecompressStrided(data, dataSize, fb, numCols * height * 2, height * 2, screenHeight * 2);
+	}
+	else if(dataSize >= numCols * height * 2) blitSplash(data, fb, numCols, height, screenHeight);
+	else return false;
+
+	GFX_markRenderbufDirty(anim->screen, anim->xx + firstCol, numCols);
+	consoleInvalidate(anim->screen, anim->xx + firstCol, numCols);
+
+	return res;
+}
+
+static bool drawSplashFrame(SplashAnim *const anim)
+{
+	if(anim->framesSize - anim->pos < sizeof(SplashFrame)) return false;
+
+	SplashFrame frame;
+	memcpy(&frame, anim->frames + anim->pos, sizeof(SplashFrame));
+	const u32 dataPos = anim->pos + sizeof(SplashFrame);
+	if(frame.dataSize > anim->framesSize - dataPos) return false;
+	if(anim->frame == 0 && (frame.firstCol != 0 || frame.numCols != anim->width)) return false;
+
+	consoleFlush();
+	if(!drawSplashColumns(anim, frame.firstCol, frame.numCols, anim->frames + dataPos, frame.dataSize))
+		return false;
+
+	anim->pos = dataPos + frame.dataSize;
+	anim->frame++;
+	anim->nextVblank += msecToVblanks(frame.duration);
+
+	return true;
+}
+
+bool splashAnimStart(SplashAnim *const anim, const void *const data, u32 size, s32 startX, s32 startY, u8 screen)
 {
-	if(!data || !tmpBuf) return false;
+	memset(anim, 0, sizeof(SplashAnim));
+	if(!data || size < sizeof(SplashHeader)) return false;
 
 	const SplashHeader *const header = (const SplashHeader *const)data;
 	if(!validateSplashHeader(header, screen)) return false;
 
 	const u16 width = header->width, height = header->height;
 	const u32 flags = header->flags;
-	const bool isCompressed = flags & FLAG_COMPRESSED;
-
-	u16 *imgData;
-	if(isCompressed)
-	{
-		imgData = tmpBuf;
-		lz11Decompress(data + sizeof(SplashHeader), imgData, width * height * 2);
-	}
-	else imgData = (u16*)(data + sizeof(SplashHeader));
+	const u8 *imgData = (const u8*)data + sizeof(SplashHeader);
+	u32 imgSize = size - sizeof(SplashHeader);
 
 	u32 screenWidth, screenHeight, xx, yy;
 	if(screen)	/* SCREEN_TOP */
@@ -85,14 +176,76 @@ bool drawSplashscreen(const void *const data, u16 *const tmpBuf, s32 startX, s32
 	if(startY < 0 || (u32)startY > screenHeight - height) yy = (screenHeight - height) / 2;
 	else yy = (u32)startY;
 
-	u16 *fb = (screen ? (u16*)RENDERBUF_TOP : (u16*)RENDERBUF_SUB);
-	for(u32 x = 0; x < width; x++)
+	anim->width = width;
+	anim->height = height;
+	anim->xx = xx;
+	anim->fb = (screen ? (u16*)RENDERBUF_TOP : (u16*)RENDERBUF_SUB) + xx * screenHeight + yy;
+	anim->screenHeight = screenHeight;
+	anim->screen = screen;
+	anim->compressed = flags & FLAG_COMPRESSED;
+
+	if(!(flags & FLAG_ANIMATED))
+	{
+		consoleFlush();
+		anim->numFrames = 1;
+		anim->frame = 1;
+		return drawSplashColumns(anim, 0, width, imgData, imgSize);
+	}
+
+	SplashAnimHeader animHeader;
+	if(imgSize < sizeof(SplashAnimHeader)) return false;
+	memcpy(&animHeader, imgData, sizeof(SplashAnimHeader));
+	if(animHeader.numFrames == 0) return false;
+
+	anim->frames = imgData + sizeof(SplashAnimHeader);
+	anim->framesSize = imgSize - sizeof(SplashAnimHeader);
+	anim->numFrames = animHeader.numFrames;
+	anim->animFlags = animHeader.flags;
+	anim->nextVblank = GFX_getVblankCount();
+
+	if(!drawSplashFrame(anim))
+	{
+		anim->numFrames = 0; // Stop playback
+		return false;
+	}
+
+	return true;
+}
+
+bool splashAnimUpdate(SplashAnim *const anim, u32 vblank)
+{
+	if(anim->frame >= anim->numFrames)
 	{
-		for(u32 y = 0; y < height; y++)
-		{
-			fb[(x + xx) * screenHeight + y + yy] = imgData[x * height + y];
-		}
+		if(!(anim->animFlags & ANIM_FLAG_LOOP) || anim->numFrames < 2) return false;
+
+		// Frame 0 is a full image so looping just starts over.
+		anim->frame = 0;
+		anim->pos = 0;
+	}
+	if((s32)(vblank - anim->nextVblank) < 0) return false;
+
+	// Late frames are shown right away but never skipped since the
+	// following deltas build on them.
+	if((s32)(vblank - anim->nextVblank) > 0) anim->nextVblank = vblank;
+
+	if(!drawSplashFrame(anim))
+	{
+		anim->numFrames = 0; // Corrupt frame. Stop playback.
+		return false;
 	}
 
 	return true;
 }
+
+void splashAnimStop(SplashAnim *const anim)
+{
+	if(anim->buffer) free(anim->buffer);
+	memset(anim, 0, sizeof(SplashAnim));
+}
+
+bool drawSplashscreen(const void *const data, u32 size, s32 startX, s32 startY, u8 screen)
+{
+	SplashAnim anim;
+
+	return splashAnimStart(&anim, data, size, startX, startY, screen);
+}
@@ -25,6 +25,9 @@
 #include "arm11/hardware/mcu.h"
 #include "arm11/hardware/hid.h"
 #include "arm11/hardware/cpu.h"
+#include "arm11/work.h"
+#include "perf.h"
+#include "trace.h"
 #include "arm.h"
 
 
@@ -37,6 +40,10 @@ void WEAK __systemInit(void)
 
 	if(!__getCpuId()) // Core 0
 	{
+		perfInit();
+#ifdef BOOT_TRACE
+		traceInit();
+#endif
 		I2C_init();
 		hidInit();
 		MCU_init();
@@ -44,10 +51,8 @@ void WEAK __systemInit(void)
 	}
 	else // Any other core
 	{
-		// We don't need core 1 yet so back it goes into boot11.
-		// Core 2 and 3 also go there waiting until poweroff.
-		deinitCpu();
-		((void (*)(void))0x0001004C)();
+		// Runs work from core 0 until it is sent back into boot11.
+		workCoreMain();
 	}
 }
 
@@ -0,0 +1,173 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "types.h"
+#include "arm11/work.h"
+#include "arm11/spinlock.h"
+#include "arm11/start.h"
+#include "arm11/hardware/interrupt.h"
+#include "arm.h"
+
+
+#define WORK_QUEUE_SIZE    (8u)
+#define WORK_DOORBELL_SGI  (IRQ_MPCORE_SW8)
+
+
+static u32 queueLock = 0;
+static WorkItem *queue[WORK_QUEUE_SIZE];
+static volatile u32 queueHead = 0, queueTail = 0;
+static volatile u32 coreMask = 0;
+static volatile bool stopReq = false;
+
+
+
+static WorkItem* queuePop(void)
+{
+	WorkItem *item = NULL;
+
+	spinlockLock(&queueLock);
+	const u32 head = queueHead;
+	if(head != queueTail)
+	{
+		item = queue[head % WORK_QUEUE_SIZE];
+		queueHead = head + 1;
+	}
+	spinlockUnlock(&queueLock);
+
+	return item;
+}
+
+noreturn void workCoreMain(void)
+{
+	const u32 cpuBit = 1u<<__getCpuId();
+
+	// SGIs are always enabled. A NULL handler only acknowledges the doorbell.
+	IRQ_registerHandler(WORK_DOORBELL_SGI, 14, 0, true, NULL);
+
+	spinlockLock(&queueLock);
+	coreMask |= cpuBit;
+	spinlockUnlock(&queueLock);
+
+	while(1)
+	{
+		WorkItem *const item = queuePop();
+		if(!item)
+		{
+			if(stopReq) break;
+
+			// IRQs stay masked between the check and the wfi so a
+			// doorbell in between is still pending and wakes us.
+			__cpsid(i);
+			if(queueHead == queueTail && !stopReq) __wfi();
+			__cpsie(i);
+			continue;
+		}
+
+		item->func(item->arg);
+		__dmb();
+		item->done = true;
+		__dsb();
+		__sev();
+	}
+
+	IRQ_unregisterHandler(WORK_DOORBELL_SGI);
+	spinlockLock(&queueLock);
+	coreMask &= ~cpuBit;
+	spinlockUnlock(&queueLock);
+
+	// Back into boot11 like it did before it had any work.
+	deinitCpu();
+	((void (*)(void))0x0001004C)();
+	while(1);
+}
+
+u32 workGetCoreMask(void)
+{
+	return coreMask;
+}
+
+bool workSubmit(WorkItem *item)
+{
+	if(!coreMask || stopReq) return false;
+
+	item->done = false;
+
+	spinlockLock(&queueLock);
+	const u32 tail = queueTail;
+	const bool full = (tail - queueHead == WORK_QUEUE_SIZE);
+	if(!full)
+	{
+		queue[tail % WORK_QUEUE_SIZE] = item;
+		queueTail = tail + 1;
+	}
+	spinlockUnlock(&queueLock);
+
+	if(full) return false;
+
+	// Idle cores race for the item. The losers go back to sleep.
+	IRQ_softwareInterrupt(WORK_DOORBELL_SGI, coreMask);
+
+	return true;
+}
+
+bool workIsDone(WorkItem *item)
+{
+	const bool done = item->done;
+	__dmb();
+
+	return done;
+}
+
+void workWait(WorkItem *item)
+{
+	while(!item->done) __wfe();
+	__dmb();
+}
+
+void workStopCores(void)
+{
+	if(!coreMask) return;
+
+	stopReq = true;
+	__dsb();
+	IRQ_softwareInterrupt(WORK_DOORBELL_SGI, coreMask);
+
+	while(coreMask) __wfe();
+}
+
+void mailboxPost(Mailbox *mb, const u32 msg[4])
+{
+	spinlockLock(&mb->lock);
+	for(u32 i = 0; i < 4; i++) mb->msg[i] = msg[i];
+	mb->seq++;
+	spinlockUnlock(&mb->lock);
+}
+
+bool mailboxFetch(Mailbox *mb, u32 *seq, u32 msg[4])
+{
+	spinlockLock(&mb->lock);
+	const bool isNew = (mb->seq != *seq);
+	if(isNew)
+	{
+		for(u32 i = 0; i < 4; i++) msg[i] = mb->msg[i];
+		*seq = mb->seq;
+	}
+	spinlockUnlock(&mb->lock);
+
+	return isNew;
+}
@@ -0,0 +1,172 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * pthread implementation of the work.h API for host builds. Link this
+ * instead of work.c. Worker threads started on the first submit stand in
+ * for cores 1-3 and a condition variable replaces the doorbell SGI.
+ */
+
+#ifndef _3DS
+
+#include <pthread.h>
+#include "types.h"
+#include "arm11/work.h"
+#include "arm11/spinlock.h"
+
+
+#define WORK_QUEUE_SIZE  (8u)
+#define WORK_HOST_CORES  (3u) // Like a New 3DS with cores 2 and 3 running
+
+
+static pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+static pthread_t coreThreads[WORK_HOST_CORES];
+static WorkItem *queue[WORK_QUEUE_SIZE];
+static u32 queueHead = 0, queueTail = 0;
+static u32 coreMask = 0;
+static bool started = false;
+static bool stopReq = false;
+
+
+
+static void* coreThreadEntry(UNUSED void *arg)
+{
+	workCoreMain();
+}
+
+noreturn void workCoreMain(void)
+{
+	pthread_mutex_lock(&queueMutex);
+	while(1)
+	{
+		if(queueHead == queueTail)
+		{
+			if(stopReq) break;
+			pthread_cond_wait(&queueCond, &queueMutex);
+			continue;
+		}
+
+		WorkItem *const item = queue[queueHead++ % WORK_QUEUE_SIZE];
+		pthread_mutex_unlock(&queueMutex);
+
+		item->func(item->arg);
+
+		pthread_mutex_lock(&queueMutex);
+		__atomic_store_n(&item->done, true, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&doneCond);
+	}
+	pthread_mutex_unlock(&queueMutex);
+
+	pthread_exit(NULL);
+}
+
+static void startCores(void)
+{
+	if(started || stopReq) return;
+	started = true;
+
+	for(u32 i = 0; i < WORK_HOST_CORES; i++)
+	{
+		if(pthread_create(&coreThreads[i], NULL, coreThreadEntry, NULL) == 0)
+			coreMask |= 2u<<i;
+	}
+}
+
+u32 workGetCoreMask(void)
+{
+	pthread_mutex_lock(&queueMutex);
+	startCores();
+	const u32 mask = coreMask;
+	pthread_mutex_unlock(&queueMutex);
+
+	return mask;
+}
+
+bool workSubmit(WorkItem *item)
+{
+	pthread_mutex_lock(&queueMutex);
+	startCores();
+
+	const bool ok = coreMask && !stopReq && queueTail - queueHead < WORK_QUEUE_SIZE;
+	if(ok)
+	{
+		item->done = false;
+		queue[queueTail++ % WORK_QUEUE_SIZE] = item;
+		pthread_cond_signal(&queueCond);
+	}
+	pthread_mutex_unlock(&queueMutex);
+
+	return ok;
+}
+
+bool workIsDone(WorkItem *item)
+{
+	return __atomic_load_n(&item->done, __ATOMIC_ACQUIRE);
+}
+
+void workWait(WorkItem *item)
+{
+	pthread_mutex_lock(&queueMutex);
+	while(!__atomic_load_n(&item->done, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(&doneCond, &queueMutex);
+	pthread_mutex_unlock(&queueMutex);
+}
+
+void workStopCores(void)
+{
+	pthread_mutex_lock(&queueMutex);
+	const u32 mask = coreMask;
+	stopReq = true;
+	pthread_cond_broadcast(&queueCond);
+	pthread_mutex_unlock(&queueMutex);
+
+	for(u32 i = 0; i < WORK_HOST_CORES; i++)
+	{
+		if(mask & 2u<<i) pthread_join(coreThreads[i], NULL);
+	}
+
+	pthread_mutex_lock(&queueMutex);
+	coreMask = 0;
+	pthread_mutex_unlock(&queueMutex);
+}
+
+void mailboxPost(Mailbox *mb, const u32 msg[4])
+{
+	spinlockLock(&mb->lock);
+	for(u32 i = 0; i < 4; i++) mb->msg[i] = msg[i];
+	mb->seq++;
+	spinlockUnlock(&mb->lock);
+}
+
+bool mailboxFetch(Mailbox *mb, u32 *seq, u32 msg[4])
+{
+	spinlockLock(&mb->lock);
+	const bool isNew = (mb->seq != *seq);
+	if(isNew)
+	{
+		for(u32 i = 0; i < 4; i++) msg[i] = mb->msg[i];
+		*seq = mb->seq;
+	}
+	spinlockUnlock(&mb->lock);
+
+	return isNew;
+}
+
+#endif // ifndef _3DS
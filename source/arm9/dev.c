@@ -80,10 +80,8 @@ const dev_struct *dev_rawnand = &dev_rnand;
 // Decrypted NAND device
 typedef struct {
 	dev_struct dev;
-	u32 twlCounter[4];
-	u32 ctrCounter[4];
-	AES_ctx twlAesCtx;
-	AES_ctx ctrAesCtx;
+	AES_ctrStream twlStream;
+	AES_ctrStream ctrStream;
 } dev_dnand_struct;
 
 bool sdmmc_dnand_init(void);
@@ -106,8 +104,6 @@ static dev_dnand_struct dev_dnand = {
 		NULL
 	},
 	{0},
-	{0},
-	{0},
 	{0}
 };
 const dev_struct *dev_decnand = &dev_dnand.dev;
@@ -335,14 +331,22 @@ bool sdmmc_dnand_init(void)
 		// Hash NAND CID to create the CTRs for crypto
 		u32 cid[4];
 		if(sdmmc_get_cid(true, cid)) return false;
-		sha(cid, 16, dev_dnand.twlCounter, SHA_INPUT_BIG | SHA_MODE_1, SHA_OUTPUT_BIG);
-		sha(cid, 16, dev_dnand.ctrCounter, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_LITTLE);
-
-		// Crypt settings
-		AES_setCryptParams(&dev_dnand.twlAesCtx, AES_INPUT_LITTLE | AES_INPUT_REVERSED,
+		u32 twlCounter[5];
+		u32 ctrCounter[8];
+		sha(cid, 16, twlCounter, SHA_INPUT_BIG | SHA_MODE_1, SHA_OUTPUT_BIG);
+		sha(cid, 16, ctrCounter, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_LITTLE);
+
+		// Crypt settings. The streams keep the base counters so
+		// reads/writes only need to seek to the sector offset.
+		AES_ctx ctx;
+		AES_setCtrIv(&ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, twlCounter);
+		AES_setCryptParams(&ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED,
 		                   AES_OUTPUT_LITTLE | AES_OUTPUT_REVERSED);
-		AES_setCryptParams(&dev_dnand.ctrAesCtx, AES_INPUT_BIG | AES_INPUT_NORMAL,
+		AES_ctrStreamInit(&dev_dnand.twlStream, &ctx);
+		AES_setCtrIv(&ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, ctrCounter);
+		AES_setCryptParams(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL,
 		                   AES_OUTPUT_BIG | AES_OUTPUT_NORMAL);
+		AES_ctrStreamInit(&dev_dnand.ctrStream, &ctx);
 
 		dev_dnand.dev.initialized = true;
 	}
@@ -350,7 +354,7 @@ bool sdmmc_dnand_init(void)
 	return true;
 }
 
-bool sdmmc_dnand_read_sector(u32 sector, u32 count, void *buf)
+static bool dnandReadSector(u32 sector, u32 count, void *buf, bool hash)
 {
 	if(!dev_dnand.dev.initialized) return false;
 
@@ -365,28 +369,28 @@ bool sdmmc_dnand_read_sector(u32 sector, u32 count, void *buf)
 	partitionGetKeyslot(index, &keyslot);
 	if(keyslot == 0xFF) return false; // unknown partition type
 
-	AES_ctx *ctx;
 	AES_selectKeyslot(keyslot);
-	if(keyslot == 0x03)
-	{
-		ctx = &dev_dnand.twlAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, dev_dnand.twlCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
-	}
-	else
-	{
-		ctx = &dev_dnand.ctrAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, dev_dnand.ctrCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
-	}
+	AES_ctrStream *const stream = (keyslot == 0x03 ? &dev_dnand.twlStream : &dev_dnand.ctrStream);
+	AES_ctrStreamSeek(stream, (u64)sector<<9);
 	
 	if(sdmmc_nand_readsectors(sector, count, buf)) return false;
 	flushInvalidateDCacheRange(buf, count<<9);
-	AES_ctr(ctx, buf, buf, count<<5, true);
+	if(hash) AES_ctrStreamCryptSha(stream, buf, buf, count<<5);
+	else AES_ctrStreamCrypt(stream, buf, buf, count<<5, true);
 
 	return true;
 }
 
+bool sdmmc_dnand_read_sector(u32 sector, u32 count, void *buf)
+{
+	return dnandReadSector(sector, count, buf, false);
+}
+
+bool dev_decnand_read_sector_sha(u32 sector, u32 count, void *buf)
+{
+	return dnandReadSector(sector, count, buf, true);
+}
+
 bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf)
 {
 	if(!dev_dnand.dev.initialized) return false;
@@ -410,25 +414,14 @@ bool sdmmc_dnand_write_sector(u32 sector, u32 count, const void *buf)
 	flushDCacheRange(buf, count<<9);
 
 	AES_selectKeyslot(keyslot);
-	AES_ctx *ctx;
-	if(keyslot == 0x03)
-	{
-		ctx = &dev_dnand.twlAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_REVERSED, dev_dnand.twlCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
-	}
-	else
-	{
-		ctx = &dev_dnand.ctrAesCtx;
-		AES_setCtrIv(ctx, AES_INPUT_LITTLE | AES_INPUT_NORMAL, dev_dnand.ctrCounter);
-		AES_addCounter(ctx->ctrIvNonce, sector<<9);
-	}
+	AES_ctrStream *const stream = (keyslot == 0x03 ? &dev_dnand.twlStream : &dev_dnand.ctrStream);
+	AES_ctrStreamSeek(stream, (u64)sector<<9);
 	
 	do {
 		size_t crypt_size = min(count, crypto_sec_size);
 
 		invalidateDCacheRange(crypto_buf, crypt_size<<9);
-		AES_ctr(ctx, buf, crypto_buf, crypt_size<<5, true);
+		AES_ctrStreamCrypt(stream, buf, crypto_buf, crypt_size<<5, true);
 		if(sdmmc_nand_writesectors(sector, crypt_size, crypto_buf))
 		{
 			free(crypto_buf);
@@ -33,6 +33,7 @@
 #include "fs.h"
 #include "hardware/gfx.h"
 #include "system.h"
+#include "trace.h"
 
 
 typedef struct
@@ -80,8 +81,62 @@ static const FirmWhitelist installWhitelist[] =
 	}
 };
 
+// State between starting and finishing a signature check
+typedef struct
+{
+	u32 hdrHash[8];
+	u32 tag[4];
+	bool cached;
+} FirmSigState;
+
+// Header + key combinations that passed the RSA check before. Each entry
+// is a MAC made with a console unique AES key so the file on the SD card
+// can't be forged. Replaying an entry is harmless since it only matches the
+// header and key it was made for. The signed header covers the section
+// hashes and those are still checked on every load.
+typedef struct
+{
+	u32 magic;
+	u32 next; // Entry replaced next
+	u32 tags[FIRM_SIG_CACHE_ENTRIES][4];
+} FirmSigCache;
+
+static const char *const sigCachePath = "sdmc:/boot/sigcache.bin";
+static FirmSigCache sigCache;
+static bool sigCacheLoaded;
+
 static int firmLaunchArgc;
 
+typedef enum
+{
+	PRELOAD_IDLE = 0,
+	PRELOAD_PENDING, // Requested but not started yet
+	PRELOAD_READING, // File is open. Reading chunks.
+	PRELOAD_HASHING, // Hashing 1 section per step while the RSA engine runs
+	PRELOAD_SIGNING, // Waiting for the RSA engine
+	PRELOAD_DONE     // Loaded and verified. result is valid.
+} PreloadState;
+
+// A speculative load of the FIRM ARM11 is expected to boot.
+typedef struct
+{
+	PreloadState state;
+	bool skipHashCheck;
+	bool hasPubkey;
+	bool fromNand;
+	s32 handle;      // File handle if !fromNand
+	u32 sector;      // Partition sector if fromNand
+	u32 firmSize;
+	u32 pos;
+	u32 section;     // Next section to hash
+	s32 result;
+	FirmSigState sigState;
+	char path[256];
+	u32 pubkey[0x100 / 4];
+} FirmPreload;
+
+static FirmPreload preload;
+
 
 
 /* Calculates the actual firm partition size by using its header */
@@ -182,121 +237,264 @@ void NAKED firmLaunchStub(int argc, const char **argv)
 	entry9(argc, argv, 0x3BEEFu);
 }
 
-s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
+// CBC-MAC over SHA-256(header hash + key). The input is fixed size.
+static void firmSigCacheTag(const u32 hdrHash[8], const u32 *const pubkey, u32 tag[4])
 {
-	u32 firmSize;
-	firm_header *const firmHdr = (firm_header*)FIRM_LOAD_ADDR;
+	u32 msg[(32 + 0x100) / 4];
+	memcpy(msg, hdrHash, 32);
+	memcpy(&msg[8], pubkey, 0x100);
+
+	u32 digest[8];
+	sha(msg, sizeof(msg), digest, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	AES_ctx ctx;
+	AES_setCryptParams(&ctx, AES_INPUT_BIG | AES_INPUT_NORMAL, AES_OUTPUT_BIG | AES_OUTPUT_NORMAL);
+	AES_selectKeyslot(FIRM_SIG_CACHE_KEYSLOT);
+	AES_ecb(&ctx, digest, tag, 1, true, false);
+	for(u32 i = 0; i < 4; i++) tag[i] ^= digest[4 + i];
+	AES_ecb(&ctx, tag, tag, 1, true, false);
+}
 
+static bool firmSigCacheFind(const u32 tag[4])
+{
+	if(!sigCacheLoaded)
+	{
+		// Retried on the next check if the SD card isn't mounted yet
+		const s32 f = fOpen(sigCachePath, FS_OPEN_EXISTING | FS_OPEN_READ);
+		if(f >= 0)
+		{
+			if(fSize(f) != sizeof(FirmSigCache) || fRead(f, &sigCache, sizeof(FirmSigCache)) < 0)
+				sigCache.magic = 0;
+			fClose(f);
+			sigCacheLoaded = true;
+		}
+		if(sigCache.magic != FIRM_SIG_CACHE_MAGIC || sigCache.next >= FIRM_SIG_CACHE_ENTRIES)
+			memset(&sigCache, 0, sizeof(FirmSigCache));
+	}
 
-	if(memcmp(path, "firm", 4) == 0)
+	if(sigCache.magic != FIRM_SIG_CACHE_MAGIC) return false;
+	for(u32 i = 0; i < FIRM_SIG_CACHE_ENTRIES; i++)
 	{
-		if(!dev_decnand->is_active()) return -1;
+		if(memcmp(sigCache.tags[i], tag, 16) == 0) return true;
+	}
 
-		size_t partInd, sector;
-		if(!partitionGetIndex(path, &partInd)) return -2;
-		if(!partitionGetSectorOffset(partInd, &sector)) return -3;
+	return false;
+}
 
-		if(!dev_decnand->read_sector(sector, 1, (void*)FIRM_LOAD_ADDR)) return -4;
-		if(!firm_size((size_t*)&firmSize, firmHdr)) return -5;
-		sector++;
-		if(!dev_decnand->read_sector(sector, (firmSize>>9) - 1, (void*)(FIRM_LOAD_ADDR + sizeof(firm_header))))
-			return -4;
-	}
-	else if(memcmp(path, "ram", 3) == 0)
+static void firmSigCacheAdd(const u32 tag[4])
+{
+	// Overwrite the oldest entry if the cache is full
+	memcpy(sigCache.tags[sigCache.next], tag, 16);
+	sigCache.magic = FIRM_SIG_CACHE_MAGIC;
+	sigCache.next = (sigCache.next + 1) % FIRM_SIG_CACHE_ENTRIES;
+
+	// Not being able to save it only costs a RSA operation next boot
+	const s32 f = fOpen(sigCachePath, FS_CREATE_ALWAYS | FS_OPEN_WRITE);
+	if(f < 0) return;
+	fWrite(f, &sigCache, sizeof(FirmSigCache));
+	fClose(f);
+}
+
+static bool firmSignatureStart(const firm_header *const hdr, const u32 *const pubkey, FirmSigState *const state)
+{
+	sha((const u32*)hdr, offsetof(firm_header, signature), state->hdrHash,
+	    SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	firmSigCacheTag(state->hdrHash, pubkey, state->tag);
+	state->cached = firmSigCacheFind(state->tag);
+	if(state->cached) return true;
+
+	TRACE_BEGIN(TRACE_FIRM_RSA, 0);
+
+	// Exponent 65537 (big endian). The section hashes are calculated
+	// while the modexp is running.
+	if(RSA_setKey2048(FIRM_SIG_RSA_KEYSLOT, pubkey, 0x01000100) &&
+	   RSA_decrypt2048Async((const u32*)hdr->signature)) return true;
+
+	TRACE_END(TRACE_FIRM_RSA, FIRM_ERR_INVALID_SIG);
+
+	return false;
+}
+
+static bool firmSignatureFinish(const FirmSigState *const state)
+{
+	if(state->cached) return true;
+
+	alignas(4) u32 decSig[0x100 / 4];
+	RSA_waitDecrypt2048(decSig);
+	const bool valid = RSA_checkSigHash2048(decSig, state->hdrHash);
+	TRACE_END(TRACE_FIRM_RSA, (valid ? 0 : FIRM_ERR_INVALID_SIG));
+	if(!valid) return false;
+
+	firmSigCacheAdd(state->tag);
+
+	return true;
+}
+
+bool verifyFirmSignature(const firm_header *const hdr, const u32 *const pubkey)
+{
+	FirmSigState state;
+	if(!firmSignatureStart(hdr, pubkey, &state)) return false;
+
+	return firmSignatureFinish(&state);
+}
+
+// secHash is an optional precomputed hash of the section
+static s32 verifyFirmSection(const firm_header *const firmHdr, u32 i, u32 firmSize, bool skipHashCheck,
+                             bool installMode, const u32 *secHash)
+{
+	const firm_sectionheader *const section = &firmHdr->section[i];
+	const u32 secSize = section->size;
+
+	if(!secSize) return 0;
+
+	const u32 secOffset = section->offset;
+	// Check section offset
+	if(secOffset >= firmSize || secOffset < sizeof(firm_header)) return -12;
+
+	// Check section size
+	if(secSize >= firmSize || (secSize + secOffset > firmSize)) return -13;
+
+	const FirmWhitelist *list;
+	u32 listSize;
+	if(installMode)
 	{
-		firm_header *const ramBootHdr = (firm_header*)RAM_FIRM_BOOT_ADDR;
-		if(memcmp(&ramBootHdr->magic, "FIRM", 4) == 0)
-		{
-			if(!firm_size((size_t*)&firmSize, ramBootHdr)) return -5;
-			NDMA_copy((u32*)FIRM_LOAD_ADDR, (u32*)RAM_FIRM_BOOT_ADDR, firmSize);
-			ramBootHdr->magic = 0;
-		}
-		else return -6;
+		list = installWhitelist;
+		listSize = arrayEntries(installWhitelist);
 	}
 	else
 	{
-		const s32 f = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
-		if(f < 0) return -6;
+		list = bootWhitelist;
+		listSize = arrayEntries(bootWhitelist);
+	}
+	const u32 secAddr = section->address;
+	bool allowed = false;
+	for(u32 n = 0; n < listSize; n++)
+	{
+		const u32 addr = list[n].addr;
+		const u32 size = list[n].size;
+
+		// Overflow check
+		if(secAddr > ~secSize) return -14;
 
-		firmSize = fSize(f);
-		if(firmSize > FIRM_MAX_SIZE)
+		// Range check
+		if(secAddr >= addr && secAddr + secSize <= addr + size)
 		{
-			fClose(f);
-			return -7;
+			allowed = true;
+			break;
 		}
-		if(fRead(f, (void*)FIRM_LOAD_ADDR, firmSize) < 0)
+	}
+	if(!allowed) return -15;
+
+	if(!skipHashCheck)
+	{
+		u32 hash[8];
+		if(!secHash)
 		{
-			fClose(f);
-			return -8;
+			sha((u32*)(FIRM_LOAD_ADDR + secOffset), secSize, hash,
+			    SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+			secHash = hash;
 		}
-
-		fClose(f);
+		if(memcmp(section->hash, secHash, 32) != 0) return -16;
 	}
 
+	return 0;
+}
 
-	// Check if <= FIRM header size
-	if(firmSize <= sizeof(firm_header)) return -9;
-
-	// Check magic
-	if(memcmp(&firmHdr->magic, "FIRM", 4) != 0) return -10;
+// secHashes are optional precomputed section hashes
+static s32 verifyFirmSections(const firm_header *const firmHdr, u32 firmSize, bool skipHashCheck,
+                              bool installMode, const u32 (*const secHashes)[8])
+{
+	for(u32 i = 0; i < 4; i++)
+	{
+		const s32 res = verifyFirmSection(firmHdr, i, firmSize, skipHashCheck, installMode,
+		                                  (secHashes ? secHashes[i] : NULL));
+		if(res < 0) return res;
+	}
 
-	// ARM9 entrypoint must not be 0
-	if(firmHdr->entrypointarm9 == 0) return -11;
+	return 0;
+}
 
+// Sorts the sections by offset and checks if they can be hashed while
+// reading from NAND. This needs sector aligned, non-overlapping sections.
+static bool firmNandHashOrder(const firm_header *const hdr, u32 firmSize, u32 order[4], u32 *const num)
+{
+	u32 n = 0;
 	for(u32 i = 0; i < 4; i++)
 	{
-		const firm_sectionheader *const section = &firmHdr->section[i];
+		const firm_sectionheader *const section = &hdr->section[i];
+		if(!section->size) continue;
+
+		const u32 secOffset = section->offset;
 		const u32 secSize = section->size;
+		if((secOffset | secSize) & 0x1FFu) return false;
+		if(secOffset < sizeof(firm_header) || secOffset >= firmSize || secSize > firmSize - secOffset)
+			return false;
 
-		if(!secSize) continue;
+		u32 k = n++;
+		for(; k > 0 && hdr->section[order[k - 1]].offset > secOffset; k--) order[k] = order[k - 1];
+		order[k] = i;
+	}
 
-		const u32 secOffset = section->offset;
-		// Check section offset
-		if(secOffset >= firmSize || secOffset < sizeof(firm_header)) return -12;
+	for(u32 k = 1; k < n; k++)
+	{
+		const firm_sectionheader *const prev = &hdr->section[order[k - 1]];
+		if(prev->offset + prev->size > hdr->section[order[k]].offset) return false;
+	}
 
-		// Check section size
-		if(secSize >= firmSize || (secSize + secOffset > firmSize)) return -13;
+	*num = n;
 
-		const FirmWhitelist *list;
-		u32 listSize;
-		if(installMode)
-		{
-			list = installWhitelist;
-			listSize = arrayEntries(installWhitelist);
-		}
-		else
-		{
-			list = bootWhitelist;
-			listSize = arrayEntries(bootWhitelist);
-		}
-		const u32 secAddr = section->address;
-		bool allowed = false;
-		for(u32 n = 0; n < listSize; n++)
-		{
-			const u32 addr = list[n].addr;
-			const u32 size = list[n].size;
+	return true;
+}
 
-			// Overflow check
-			if(secAddr > ~secSize) return -14;
+// Reads the rest of a NAND FIRM after the header sector. Sections are
+// decrypted and hashed in a single pass.
+static bool firmReadNandHashed(u32 sector, const firm_header *const hdr, u32 firmSize,
+                               const u32 order[4], u32 num, u32 secHashes[4][8])
+{
+	u32 cur = sizeof(firm_header);
+	for(u32 k = 0; k < num; k++)
+	{
+		const firm_sectionheader *const section = &hdr->section[order[k]];
+		const u32 secOffset = section->offset;
 
-			// Range check
-			if(secAddr >= addr && secAddr + secSize <= addr + size)
-			{
-				allowed = true;
-				break;
-			}
-		}
-		if(!allowed) return -15;
+		if(secOffset > cur &&
+		   !dev_decnand->read_sector(sector + (cur>>9), (secOffset - cur)>>9, (void*)(FIRM_LOAD_ADDR + cur)))
+			return false;
 
-		if(!skipHashCheck)
-		{
-			u32 hash[8];
-			sha((u32*)(FIRM_LOAD_ADDR + secOffset), secSize, hash,
-			    SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
-			if(memcmp(section->hash, hash, 32) != 0) return -16;
-		}
+		SHA_start(SHA_INPUT_BIG | SHA_MODE_256);
+		if(!dev_decnand_read_sector_sha(sector + (secOffset>>9), section->size>>9,
+		                                (void*)(FIRM_LOAD_ADDR + secOffset)))
+			return false;
+		SHA_finish(secHashes[order[k]], SHA_OUTPUT_BIG);
+
+		cur = secOffset + section->size;
 	}
 
+	if(firmSize > cur &&
+	   !dev_decnand->read_sector(sector + (cur>>9), (firmSize - cur)>>9, (void*)(FIRM_LOAD_ADDR + cur)))
+		return false;
+
+	return true;
+}
+
+static s32 firmCheckHeader(const firm_header *const firmHdr, u32 firmSize)
+{
+	// Check if <= FIRM header size
+	if(firmSize <= sizeof(firm_header)) return -9;
+
+	// Check magic
+	if(memcmp(&firmHdr->magic, "FIRM", 4) != 0) return -10;
+
+	// ARM9 entrypoint must not be 0
+	if(firmHdr->entrypointarm9 == 0) return -11;
+
+	return 0;
+}
+
+// Returns 1 if the FIRM gets the framebuffers as second argument.
+static s32 firmSetLaunchArgs(const char *const path, const firm_header *const firmHdr, bool installMode)
+{
 	strncpy_s((void*)(ITCM_KERNEL_MIRROR + 0x7490), path, 256, 256);
 	((const char**)(ITCM_KERNEL_MIRROR + 0x7470))[0] = ((const char*)(ITCM_KERNEL_MIRROR + 0x7490));
 
@@ -333,6 +531,296 @@ s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode)
 	}
 }
 
+// Checks the FIRM at FIRM_LOAD_ADDR and prepares the launch arguments.
+static s32 verifyLoadedFirm(const char *const path, u32 firmSize, bool skipHashCheck, bool installMode,
+                            const u32 *const pubkey, const u32 (*const secHashes)[8])
+{
+	const firm_header *const firmHdr = (const firm_header*)FIRM_LOAD_ADDR;
+
+	s32 res = firmCheckHeader(firmHdr, firmSize);
+	if(res < 0) return res;
+
+	FirmSigState sigState;
+	if(pubkey && !firmSignatureStart(firmHdr, pubkey, &sigState)) return FIRM_ERR_INVALID_SIG;
+
+	TRACE_BEGIN(TRACE_FIRM_HASH, firmSize);
+	res = verifyFirmSections(firmHdr, firmSize, skipHashCheck, installMode, secHashes);
+	TRACE_END(TRACE_FIRM_HASH, res);
+
+	// Always collect the RSA result so the engine is idle when we return
+	if(pubkey && !firmSignatureFinish(&sigState) && res == 0) return FIRM_ERR_INVALID_SIG;
+	if(res < 0) return res;
+
+	return firmSetLaunchArgs(path, firmHdr, installMode);
+}
+
+// Reads a FIRM to FIRM_LOAD_ADDR. Sections of NAND FIRMs are hashed while
+// reading if the layout allows it. secHashesValid tells if they were.
+static s32 readFirm(const char *const path, bool skipHashCheck, u32 *const firmSize,
+                    u32 secHashes[4][8], bool *const secHashesValid)
+{
+	firm_header *const firmHdr = (firm_header*)FIRM_LOAD_ADDR;
+
+	if(memcmp(path, "firm", 4) == 0)
+	{
+		if(!dev_decnand->is_active()) return -1;
+
+		size_t partInd, sector;
+		if(!partitionGetIndex(path, &partInd)) return -2;
+		if(!partitionGetSectorOffset(partInd, &sector)) return -3;
+
+		if(!dev_decnand->read_sector(sector, 1, (void*)FIRM_LOAD_ADDR)) return -4;
+		if(!firm_size((size_t*)firmSize, firmHdr)) return -5;
+
+		u32 order[4], num;
+		if(!skipHashCheck && firmNandHashOrder(firmHdr, *firmSize, order, &num))
+		{
+			if(!firmReadNandHashed(sector, firmHdr, *firmSize, order, num, secHashes)) return -4;
+			*secHashesValid = true;
+		}
+		else
+		{
+			sector++;
+			if(!dev_decnand->read_sector(sector, (*firmSize>>9) - 1, (void*)(FIRM_LOAD_ADDR + sizeof(firm_header))))
+				return -4;
+		}
+	}
+	else if(memcmp(path, "ram", 3) == 0)
+	{
+		firm_header *const ramBootHdr = (firm_header*)RAM_FIRM_BOOT_ADDR;
+		if(memcmp(&ramBootHdr->magic, "FIRM", 4) == 0)
+		{
+			if(!firm_size((size_t*)firmSize, ramBootHdr)) return -5;
+			NDMA_copy((u32*)FIRM_LOAD_ADDR, (u32*)RAM_FIRM_BOOT_ADDR, *firmSize);
+			ramBootHdr->magic = 0;
+		}
+		else return -6;
+	}
+	else
+	{
+		const s32 f = fOpen(path, FS_OPEN_EXISTING | FS_OPEN_READ);
+		if(f < 0) return -6;
+
+		*firmSize = fSize(f);
+		if(*firmSize > FIRM_MAX_SIZE)
+		{
+			fClose(f);
+			return -7;
+		}
+		if(fRead(f, (void*)FIRM_LOAD_ADDR, *firmSize) < 0)
+		{
+			fClose(f);
+			return -8;
+		}
+
+		fClose(f);
+	}
+
+	return 0;
+}
+
+s32 loadVerifyFirm(const char *const path, bool skipHashCheck, bool installMode, const u32 *const pubkey)
+{
+	u32 firmSize = 0;
+	u32 secHashes[4][8];
+	bool secHashesValid = false;
+
+	TRACE_BEGIN(TRACE_FIRM_READ, 0);
+	const s32 res = readFirm(path, skipHashCheck, &firmSize, secHashes, &secHashesValid);
+	TRACE_END(TRACE_FIRM_READ, (res < 0 ? (u32)res : firmSize));
+	if(res < 0) return res;
+
+	return verifyLoadedFirm(path, firmSize, skipHashCheck, installMode, pubkey,
+	                        (secHashesValid ? (const u32 (*)[8])secHashes : NULL));
+}
+
+void firmPreloadStart(const char *const path, bool skipHashCheck, const u32 *const pubkey)
+{
+	firmPreloadDiscard();
+
+	// Loading from FCRAM consumes the FIRM there. Never speculate on it.
+	if(memcmp(path, "ram", 3) == 0) return;
+
+	strncpy_s(preload.path, path, sizeof(preload.path), sizeof(preload.path));
+	preload.skipHashCheck = skipHashCheck;
+	preload.hasPubkey = (pubkey != NULL);
+	if(pubkey) memcpy(preload.pubkey, pubkey, sizeof(preload.pubkey));
+	preload.state = PRELOAD_PENDING;
+}
+
+// Ends the preload with a read error
+static void firmPreloadReadFailed(s32 res)
+{
+	if(preload.state == PRELOAD_READING && !preload.fromNand) fClose(preload.handle);
+	TRACE_END(TRACE_FIRM_READ, res);
+	preload.result = res;
+	preload.state = PRELOAD_DONE;
+}
+
+bool firmPreloadStep(void)
+{
+	const u32 *const pubkey = (preload.hasPubkey ? preload.pubkey : NULL);
+
+	switch(preload.state)
+	{
+		case PRELOAD_PENDING:
+			TRACE_BEGIN(TRACE_FIRM_READ, 0);
+			preload.fromNand = (memcmp(preload.path, "firm", 4) == 0);
+			if(preload.fromNand)
+			{
+				// Same checks as loadVerifyFirm(). Sections are hashed
+				// after reading since the SHA engine can't be held
+				// across steps.
+				size_t partInd, sector;
+				s32 res = 0;
+				if(!dev_decnand->is_active()) res = -1;
+				else if(!partitionGetIndex(preload.path, &partInd)) res = -2;
+				else if(!partitionGetSectorOffset(partInd, &sector)) res = -3;
+				else if(!dev_decnand->read_sector(sector, 1, (void*)FIRM_LOAD_ADDR)) res = -4;
+				else if(!firm_size((size_t*)&preload.firmSize, (firm_header*)FIRM_LOAD_ADDR)) res = -5;
+				if(res < 0)
+				{
+					firmPreloadReadFailed(res);
+					break;
+				}
+
+				preload.sector = sector;
+				preload.pos = sizeof(firm_header);
+				preload.state = PRELOAD_READING;
+				break;
+			}
+
+			preload.handle = fOpen(preload.path, FS_OPEN_EXISTING | FS_OPEN_READ);
+			if(preload.handle < 0)
+			{
+				firmPreloadReadFailed(-6);
+				break;
+			}
+
+			preload.state = PRELOAD_READING;
+			preload.firmSize = fSize(preload.handle);
+			if(preload.firmSize > FIRM_MAX_SIZE)
+			{
+				firmPreloadReadFailed(-7);
+				break;
+			}
+
+			preload.pos = 0;
+			break;
+		case PRELOAD_READING:
+			{
+				const u32 left = preload.firmSize - preload.pos;
+				const u32 chunk = (left > FIRM_PRELOAD_CHUNK ? FIRM_PRELOAD_CHUNK : left);
+				void *const dst = (void*)(FIRM_LOAD_ADDR + preload.pos);
+				bool ok;
+				if(preload.fromNand)
+				{
+					// Like loadVerifyFirm() a partial last sector isn't read
+					ok = (chunk < 0x200 ||
+					      dev_decnand->read_sector(preload.sector + (preload.pos>>9), chunk>>9, dst));
+				}
+				else ok = (fRead(preload.handle, dst, chunk) >= 0);
+
+				if(!ok)
+				{
+					firmPreloadReadFailed(preload.fromNand ? -4 : -8);
+					break;
+				}
+
+				preload.pos += chunk;
+				if(preload.pos < preload.firmSize) break;
+
+				if(!preload.fromNand) fClose(preload.handle);
+				TRACE_END(TRACE_FIRM_READ, preload.firmSize);
+
+				// Verified like verifyLoadedFirm() but in steps. The RSA
+				// engine runs while the sections are hashed.
+				const firm_header *const firmHdr = (const firm_header*)FIRM_LOAD_ADDR;
+				preload.result = firmCheckHeader(firmHdr, preload.firmSize);
+				if(preload.result == 0 && pubkey && !firmSignatureStart(firmHdr, pubkey, &preload.sigState))
+					preload.result = FIRM_ERR_INVALID_SIG;
+				if(preload.result < 0)
+				{
+					preload.state = PRELOAD_DONE;
+					break;
+				}
+
+				TRACE_BEGIN(TRACE_FIRM_HASH, preload.firmSize);
+				preload.section = 0;
+				preload.state = PRELOAD_HASHING;
+			}
+			break;
+		case PRELOAD_HASHING:
+			{
+				// The SHA engine isn't held across steps. IPC commands
+				// may use it in between. A section is hashed in 1 go.
+				const firm_header *const firmHdr = (const firm_header*)FIRM_LOAD_ADDR;
+				preload.result = verifyFirmSection(firmHdr, preload.section, preload.firmSize,
+				                                   preload.skipHashCheck, false, NULL);
+				if(preload.result < 0 || ++preload.section == 4)
+				{
+					TRACE_END(TRACE_FIRM_HASH, preload.result);
+					preload.state = PRELOAD_SIGNING;
+				}
+			}
+			break;
+		case PRELOAD_SIGNING:
+			// Polled. Waiting here would block IPC commands.
+			if(pubkey && !preload.sigState.cached && RSA_isBusy()) break;
+
+			if(pubkey && !firmSignatureFinish(&preload.sigState) && preload.result == 0)
+				preload.result = FIRM_ERR_INVALID_SIG;
+			if(preload.result == 0)
+				preload.result = firmSetLaunchArgs(preload.path, (const firm_header*)FIRM_LOAD_ADDR, false);
+			preload.state = PRELOAD_DONE;
+			break;
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+bool firmPreloadCommit(const char *const path, bool skipHashCheck, const u32 *const pubkey, s32 *const result)
+{
+	if(preload.state == PRELOAD_IDLE) return false;
+
+	const bool match = strncmp(preload.path, path, sizeof(preload.path)) == 0 &&
+	                   preload.skipHashCheck == skipHashCheck &&
+	                   preload.hasPubkey == (pubkey != NULL) &&
+	                   (!pubkey || memcmp(preload.pubkey, pubkey, sizeof(preload.pubkey)) == 0);
+	if(match) while(firmPreloadStep());
+
+	// Failed loads are retried for real. The storage may have changed since.
+	const bool committed = match && preload.result >= 0;
+	if(committed) *result = preload.result;
+
+	firmPreloadDiscard();
+
+	return committed;
+}
+
+void firmPreloadDiscard(void)
+{
+	if(preload.state == PRELOAD_READING)
+	{
+		if(!preload.fromNand) fClose(preload.handle);
+		TRACE_END(TRACE_FIRM_READ, TRACE_ARG_ABORTED);
+	}
+	if(preload.state == PRELOAD_HASHING) TRACE_END(TRACE_FIRM_HASH, TRACE_ARG_ABORTED);
+
+	// The next RSA user must find the engine idle
+	if((preload.state == PRELOAD_HASHING || preload.state == PRELOAD_SIGNING) &&
+	   preload.hasPubkey && !preload.sigState.cached)
+	{
+		alignas(4) u32 decSig[0x100 / 4];
+		RSA_waitDecrypt2048(decSig);
+		TRACE_END(TRACE_FIRM_RSA, TRACE_ARG_ABORTED);
+	}
+
+	preload.state = PRELOAD_IDLE;
+}
+
 noreturn void firmLaunch(void)
 {
 	memcpy((void*)A9_STUB_ENTRY, (const void*)firmLaunchStub, A9_STUB_SIZE);
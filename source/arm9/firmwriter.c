@@ -144,15 +144,18 @@ s32 writeFirmPartition(const char *const part, bool replaceSig)
 s32 loadVerifyUpdate(const char *const path, u32 *const version)
 {
 	if(!dev_decnand->is_active()) return -1;
-	if(loadVerifyFirm(path, false, true) < 0) return UPDATE_ERR_INVALID_FIRM;
 
-	u32 *updateBuffer = (u32*)FIRM_LOAD_ADDR;
 #ifdef NDEBUG
-	// Verify signature
-	if(!RSA_setKey2048(3, (u32*)fastboot3DS_pubkey, 0x01000100) ||
-	   !RSA_verify2048(updateBuffer + 0x40, updateBuffer, 0x100))
-		return UPDATE_ERR_INVALID_SIG;
+	// The signature is verified while the sections are hashed
+	const u32 *const pubkey = (const u32*)fastboot3DS_pubkey;
+#else
+	const u32 *const pubkey = NULL;
 #endif
+	const s32 res = loadVerifyFirm(path, false, true, pubkey);
+	if(res == FIRM_ERR_INVALID_SIG) return UPDATE_ERR_INVALID_SIG;
+	if(res < 0) return UPDATE_ERR_INVALID_FIRM;
+
+	u32 *updateBuffer = (u32*)FIRM_LOAD_ADDR;
 
 	// verify fastboot magic
 	if(memcmp((void*)updateBuffer + 0x200, "fastboot3DS    ", 16) != 0)
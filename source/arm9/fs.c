@@ -26,6 +26,8 @@
 #include "arm9/ncsd.h"
 #include "arm9/partitions.h"
 #include "fatfs/ff.h"
+#include "trace.h"
+#include "wildcard.h"
 
 
 typedef struct
@@ -41,6 +43,15 @@ typedef struct
 	size_t count;
 } ProtNandRegion;
 
+typedef struct
+{
+	WildcardPattern filter;
+	char pattern[WILDCARD_MAX_LEN + 1]; // Filter source to detect changes
+	u32 flags;
+	u32 pos;                            // Matching entries consumed so far
+	bool valid;
+} DirPageState;
+
 
 static const DevHandle devHandleMagic = 0x42424296;
 
@@ -54,6 +65,8 @@ static u32 fHandles = 0;
 
 static DIR dTable[FS_MAX_DIRS] = {0};
 static bool dStatTable[FS_MAX_DIRS] = {0};
+static DirPageState dPageTable[FS_MAX_DIRS];
+static FILINFO dPageInfo; // Too big for the IRQ stack
 static u32 dHandles = 0;
 
 static bool devStatTable[FS_MAX_DEVICES] = {0};
@@ -103,7 +116,9 @@ s32 fMount(FsDrive drive)
 	if((u32)drive >= FS_MAX_DRIVES) return -30;
 	if(fsStatTable[drive]) return -31;
 
+	TRACE_BEGIN(TRACE_FS_MOUNT, drive);
 	FRESULT res = f_mount(&fsTable[drive], fsPathTable[drive], 1);
+	TRACE_END(TRACE_FS_MOUNT, res);
 	if(res == FR_OK)
 	{
 		fsStatTable[drive] = true;
@@ -675,6 +690,7 @@ s32 fOpenDir(const char *const path)
 	if(res == FR_OK)
 	{
 		dStatTable[i] = true;
+		dPageTable[i].valid = false;
 		dHandles++;
 		return i; // Handle
 	}
@@ -697,6 +713,78 @@ s32 fReadDir(s32 handle, FsFileInfo *fi, u32 num)
 	return i;
 }
 
+// Returns the number of records written to buf, 0 at the end of the dir.
+// The offset counts matching entries only.
+s32 fReadDirPacked(s32 handle, u32 offset, u32 flags, const char *const pattern, void *const buf, u32 bufSize)
+{
+	if(!isDirHandleValid(handle)) return -30;
+	if(bufSize < FS_DIR_RECORD_SIZE(FF_LFN_BUF)) return -31;
+	if(pattern && strlen(pattern) > WILDCARD_MAX_LEN) return -31;
+
+	DIR *const dir = &dTable[handle];
+	DirPageState *const state = &dPageTable[handle];
+	const char *const pat = (pattern ? pattern : "*");
+
+	// Sequential pages continue where the last one ended.
+	// Anything else starts over from the first entry.
+	if(!state->valid || state->flags != flags || strcmp(state->pattern, pat) != 0 || offset < state->pos)
+	{
+		if(!wildcardCompile(&state->filter, pat)) return -31;
+		strcpy(state->pattern, pat);
+		state->flags = flags;
+		state->pos = 0;
+		state->valid = true;
+
+		FRESULT res = f_readdir(dir, NULL); // Rewind
+		if(res != FR_OK) return -res;
+	}
+
+	u8 *out = (u8*)buf;
+	u32 used = 0;
+	s32 count = 0;
+	while(1)
+	{
+		const DIR prev = *dir;
+		FRESULT res = f_readdir(dir, &dPageInfo);
+		if(res != FR_OK)
+		{
+			state->valid = false;
+			return -res;
+		}
+		if(!dPageInfo.fname[0]) break;
+
+		const bool isDir = (dPageInfo.fattrib & AM_DIR) != 0;
+		if(isDir && (flags & FS_DIR_FILES_ONLY)) continue;
+		if(!isDir && ((flags & FS_DIR_DIRS_ONLY) || !wildcardMatch(&state->filter, dPageInfo.fname))) continue;
+
+		if(state->pos < offset)
+		{
+			state->pos++;
+			continue;
+		}
+
+		// Doesn't fit. Step back so the next page starts with this entry.
+		const u32 nameLen = strlen(dPageInfo.fname);
+		const u32 recSize = FS_DIR_RECORD_SIZE(nameLen);
+		if(used + recSize > bufSize)
+		{
+			*dir = prev;
+			break;
+		}
+
+		FsDirRecord *const rec = (FsDirRecord*)&out[used];
+		rec->fsize = dPageInfo.fsize;
+		rec->fattrib = dPageInfo.fattrib;
+		rec->nameLen = nameLen;
+		memcpy(rec->name, dPageInfo.fname, nameLen + 1);
+		used += recSize;
+		state->pos++;
+		count++;
+	}
+
+	return count;
+}
+
 s32 fCloseDir(s32 handle)
 {
 	if(dHandles == 0 || !isDirHandleValid(handle)) return -30;
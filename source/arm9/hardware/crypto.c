@@ -23,8 +23,10 @@
 #include "arm9/hardware/cfg9.h"
 #include "arm9/hardware/interrupt.h"
 #include "arm9/hardware/ndma.h"
+#include "hardware/cache.h"
 #include "arm.h"
 #include "mmio.h"
+#include "perf.h"
 
 
 
@@ -63,6 +65,9 @@
 #define REG_AESKEYYFIFO       ((vu32*)(AES_REGS_BASE + 0x108))
 
 
+static u8 aesSelectedKeyslot = 0xFF; // 0xFF = unknown
+
+
 
 static void setupKeys(void)
 {
@@ -179,6 +184,7 @@ void AES_init(void)
 
 	IRQ_registerHandler(IRQ_AES, NULL);
 
+	aesSelectedKeyslot = 0xFF;
 	setupKeys();
 }
 
@@ -188,6 +194,9 @@ void AES_setKey(u8 keyslot, AesKeyType type, u8 orderEndianess, bool twlScramble
 	fb_assert(key != NULL);
 
 
+	// New key data is only used after the keyslot is selected again
+	if(keyslot == aesSelectedKeyslot) aesSelectedKeyslot = 0xFF;
+
 	REG_AESCNT = (u32)orderEndianess<<23;
 	if(keyslot > 3)
 	{
@@ -212,8 +221,12 @@ void AES_selectKeyslot(u8 keyslot)
 {
 	fb_assert(keyslot < 0x40);
 
+	// Reloading the key is skipped if the engine already uses this keyslot
+	if(keyslot == aesSelectedKeyslot) return;
+
 	REG_AESKEYSEL = keyslot;
 	REG_AESCNT |= AES_UPDATE_KEYSLOT;
+	aesSelectedKeyslot = keyslot;
 }
 
 void AES_setNonce(AES_ctx *const ctx, u8 orderEndianess, const u32 nonce[3])
@@ -277,6 +290,7 @@ void AES_setCryptParams(AES_ctx *const ctx, u8 inEndianessOrder, u8 outEndianess
 
 static void aesProcessBlocksCpu(const u32 *in, u32 *out, u32 blocks)
 {
+	PERF_COUNT(aesBlocks, blocks);
 	REG_AES_BLKCNT_HIGH = blocks;
 	REG_AESCNT |= AES_ENABLE | 3u<<12 | AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
 
@@ -304,6 +318,7 @@ static void aesProcessBlocksDma(const u32 *in, u32 *out, u32 blocks)
 	// DMA can't reach TCMs
 	fb_assert(((u32)in >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)in < DTCM_BASE) || ((u32)in >= DTCM_BASE + DTCM_SIZE)));
 	fb_assert(((u32)out >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)out < DTCM_BASE) || ((u32)out >= DTCM_BASE + DTCM_SIZE)));
+	PERF_COUNT(aesBlocks, blocks);
 
 
 	// Check block alignment
@@ -330,6 +345,57 @@ static void aesProcessBlocksDma(const u32 *in, u32 *out, u32 blocks)
 	} while(REG_AESCNT & AES_ENABLE);
 }
 
+// AES_init() must be called before this works.
+// Programs both NDMA channels once for the whole transfer and only
+// restarts the AES engine with the next counter every AES_MAX_BLOCKS.
+static void aesCtrChainedDma(u32 ctrParams, u32 ctr[4], u32 aesParams, const u32 *in, u32 *out, u32 blocks)
+{
+	// DMA can't reach TCMs
+	fb_assert(((u32)in >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)in < DTCM_BASE) || ((u32)in >= DTCM_BASE + DTCM_SIZE)));
+	fb_assert(((u32)out >= ITCM_BOOT9_MIRROR + ITCM_SIZE) && (((u32)out < DTCM_BASE) || ((u32)out >= DTCM_BASE + DTCM_SIZE)));
+	fb_assert(blocks < 1u<<26); // NDMA total count is in words
+	PERF_COUNT(aesBlocks, blocks);
+
+	// AES_MAX_BLOCKS is even so all chunks share the parity of the total
+	const u8 aesFifoSize = (blocks & 1u ? 0u : 1u); // 1 = 32 bytes, 0 = 16 bytes
+
+	REG_NDMA0_SRC_ADDR = (u32)in;
+	REG_NDMA0_TOTAL_CNT = blocks<<2;
+	REG_NDMA0_LOG_BLK_CNT = aesFifoSize * 4 + 4;
+	REG_NDMA0_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_IN |
+	                NDMA_BURST_WORDS(4) | NDMA_SRC_UPDATE_INC | NDMA_DST_UPDATE_FIXED;
+
+	REG_NDMA1_DST_ADDR = (u32)out;
+	REG_NDMA1_TOTAL_CNT = blocks<<2;
+	REG_NDMA1_LOG_BLK_CNT = aesFifoSize * 4 + 4;
+	REG_NDMA1_CNT = NDMA_ENABLE | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_AES_OUT |
+	                NDMA_BURST_WORDS(4) | NDMA_SRC_UPDATE_FIXED | NDMA_DST_UPDATE_INC;
+
+	// Only flush the FIFOs before the first chunk. Later on NDMA may
+	// already have queued input for the next chunk.
+	u32 flush = AES_FLUSH_READ_FIFO | AES_FLUSH_WRITE_FIFO;
+	while(blocks)
+	{
+		REG_AESCNT = ctrParams;
+		for(u32 i = 0; i < 4; i++) REG_AESCTR[i] = ctr[i];
+
+		const u32 blockNum = ((blocks > AES_MAX_BLOCKS) ? AES_MAX_BLOCKS : blocks);
+		REG_AESCNT = aesParams;
+		REG_AES_BLKCNT_HIGH = blockNum;
+		REG_AESCNT |= AES_ENABLE | AES_IRQ_ENABLE | aesFifoSize<<14 | (3 - aesFifoSize)<<12 | flush;
+		flush = 0;
+
+		// Next counter is calculated while the engine is busy
+		AES_addCounter(ctr, blockNum<<4);
+		blocks -= blockNum;
+
+		do
+		{
+			__wfi();
+		} while(REG_AESCNT & AES_ENABLE);
+	}
+}
+
 void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma)
 {
 	fb_assert(ctx != NULL);
@@ -341,6 +407,12 @@ void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma)
 	const u32 aesParams = AES_MODE_CTR | ctx->aesParams;
 
 
+	if(dma)
+	{
+		if(blocks) aesCtrChainedDma(ctrParams, ctr, aesParams, in, out, blocks);
+		return;
+	}
+
 	while(blocks)
 	{
 		REG_AESCNT = ctrParams;
@@ -348,8 +420,7 @@ void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma)
 
 		REG_AESCNT = aesParams;
 		u32 blockNum = ((blocks > AES_MAX_BLOCKS) ? AES_MAX_BLOCKS : blocks);
-		if(dma) aesProcessBlocksDma(in, out, blockNum);
-		else aesProcessBlocksCpu(in, out, blockNum);
+		aesProcessBlocksCpu(in, out, blockNum);
 
 		AES_addCounter(ctr, blockNum<<4);
 		in += blockNum<<2;
@@ -358,6 +429,45 @@ void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool dma)
 	}
 }
 
+static void aesAddCounterBlocks(u32 ctr[4], u64 blocks)
+{
+	u64 sum = (u64)ctr[0] + (u32)blocks;
+	ctr[0] = (u32)sum;
+	sum = (u64)ctr[1] + (u32)(blocks>>32) + (sum>>32);
+	ctr[1] = (u32)sum;
+	for(u32 i = 2; i < 4; i++)
+	{
+		sum = (u64)ctr[i] + (sum>>32);
+		ctr[i] = (u32)sum;
+	}
+}
+
+void AES_ctrStreamInit(AES_ctrStream *const stream, const AES_ctx *const ctx)
+{
+	fb_assert(stream != NULL);
+	fb_assert(ctx != NULL);
+
+	stream->ctx = *ctx;
+	for(u32 i = 0; i < 4; i++) stream->baseCtr[i] = ctx->ctrIvNonce[i];
+}
+
+void AES_ctrStreamSeek(AES_ctrStream *const stream, u64 offset)
+{
+	fb_assert(stream != NULL);
+	fb_assert((offset & 15u) == 0);
+
+	u32 *const ctr = stream->ctx.ctrIvNonce;
+	for(u32 i = 0; i < 4; i++) ctr[i] = stream->baseCtr[i];
+	aesAddCounterBlocks(ctr, offset>>4);
+}
+
+void AES_ctrStreamCrypt(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks, bool dma)
+{
+	fb_assert(stream != NULL);
+
+	AES_ctr(&stream->ctx, in, out, blocks, dma);
+}
+
 /*void AES_cbc(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, bool dma)
 {
 	fb_assert(ctx != NULL);
@@ -505,6 +615,7 @@ void SHA_start(u8 params)
 
 void SHA_update(const u32 *data, u32 size)
 {
+	PERF_COUNT(shaBytes, size);
 	while(size >= 64)
 	{
 		*((volatile _u512*)REGs_SHA_INFIFO) = *((const _u512*)data);
@@ -550,6 +661,54 @@ void sha(const u32 *data, u32 size, u32 *const hash, u8 params, u8 hashEndianess
 	SHA_finish(hash, hashEndianess);
 }
 
+// Size must be a multiple of 64
+static void shaFeedDmaStart(const u32 *data, u32 size)
+{
+	PERF_COUNT(shaBytes, size);
+	REG_NDMA2_SRC_ADDR = (u32)data;
+	REG_NDMA2_DST_ADDR = (u32)REGs_SHA_INFIFO;
+	REG_NDMA2_TOTAL_CNT = size / 4;
+	REG_NDMA2_LOG_BLK_CNT = 64 / 4;
+	REG_NDMA2_INT_CNT = NDMA_INT_SYS_FREQ;
+	REG_NDMA2_CNT = NDMA_DST_UPDATE_INC | NDMA_DST_ADDR_RELOAD | NDMA_SRC_UPDATE_INC |
+	                NDMA_BURST_WORDS(64 / 4) | NDMA_TOTAL_CNT_MODE | NDMA_STARTUP_SHA_IN | NDMA_ENABLE;
+}
+
+void AES_ctrStreamCryptSha(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks)
+{
+	fb_assert(stream != NULL);
+	fb_assert(in != NULL);
+	fb_assert(out != NULL);
+
+
+	// While the AES engine decrypts a chunk NDMA channel 2 feeds
+	// the previous chunk from the output buffer to the SHA engine.
+	u32 shaTail = 0;
+	while(blocks)
+	{
+		const u32 blockNum = ((blocks > AES_SHA_CHUNK_BLOCKS) ? AES_SHA_CHUNK_BLOCKS : blocks);
+		AES_ctr(&stream->ctx, in, out, blockNum, true);
+		while(REG_NDMA2_CNT & NDMA_ENABLE);
+
+		const u32 size = blockNum<<4;
+		if(size >= 64) shaFeedDmaStart(out, size & ~63u);
+		shaTail = size & 63u; // Only possible for the last chunk
+
+		in += blockNum<<2;
+		out += blockNum<<2;
+		blocks -= blockNum;
+	}
+	while(REG_NDMA2_CNT & NDMA_ENABLE);
+	while(REG_SHA_CNT & SHA_ENABLE);
+
+	if(shaTail)
+	{
+		const u32 *const tail = out - shaTail / 4;
+		invalidateDCacheRange(tail, shaTail);
+		SHA_update(tail, shaTail);
+	}
+}
+
 /*void sha_dma(const u32 *data, u32 size, u32 *const hash, u8 params, u8 hashEndianess)
 {
 	REG_NDMA2_SRC_ADDR = (u32)data;
@@ -596,10 +755,9 @@ typedef struct
 
 static inline void rsaWaitBusyIrq(void)
 {
-	do
-	{
-		__wfi();
-	} while(REG_RSA_CNT & RSA_CNT_ENABLE);
+	// The operation may have finished long ago (e.g. while hashing). Check
+	// first or we sleep until some unrelated IRQ fires.
+	while(REG_RSA_CNT & RSA_CNT_ENABLE) __wfi();
 }
 
 void RSA_init(void)
@@ -635,9 +793,8 @@ bool RSA_setKey2048(u8 keyslot, const u32 *const mod, u32 exp)
 	return true;
 }
 
-bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig)
+bool RSA_decrypt2048Async(const u32 *const encSig)
 {
-	fb_assert(decSig != NULL);
 	fb_assert(encSig != NULL);
 
 	const u8 keyslot = (REG_RSA_CNT & RSA_CNT_KEYSLOT_MASK)>>RSA_CNT_KEYSLOT_SHIFT;
@@ -648,34 +805,68 @@ bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig)
 	iomemcpy(REGs_RSA_TXT, encSig, 0x100);
 
 	REG_RSA_CNT |= RSA_CNT_IRQ_ENABLE | RSA_CNT_ENABLE;
-	rsaWaitBusyIrq();
-	iomemcpy(decSig, REGs_RSA_TXT, 0x100);
 
 	return true;
 }
 
-bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
+bool RSA_isBusy(void)
 {
+	return REG_RSA_CNT & RSA_CNT_ENABLE;
+}
+
+void RSA_waitDecrypt2048(u32 *const decSig)
+{
+	fb_assert(decSig != NULL);
+
+	rsaWaitBusyIrq();
+	iomemcpy(decSig, REGs_RSA_TXT, 0x100);
+}
+
+bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig)
+{
+	fb_assert(decSig != NULL);
 	fb_assert(encSig != NULL);
-	fb_assert(data != NULL);
 
-	alignas(4) u8 decSig[0x100];
-	if(!RSA_decrypt2048((u32*)decSig, encSig)) return false;
+	if(!RSA_decrypt2048Async(encSig)) return false;
+	RSA_waitDecrypt2048(decSig);
+
+	return true;
+}
+
+bool RSA_checkSigHash2048(const u32 *const decSig, const u32 hash[8])
+{
+	fb_assert(decSig != NULL);
+	fb_assert(hash != NULL);
 
-	if(*((u16*)decSig) != 0x0100u) return false;
+	const u8 *const sig = (const u8*)decSig;
+	if(*((const u16*)sig) != 0x0100u) return false;
 	u32 read = 2;
-	while(decSig[read] == 0xFF && ++read < 0x100);
-	if(read != 0xCC || decSig[read] != 0x00) return false;
+	while(sig[read] == 0xFF && ++read < 0x100);
+	if(read != 0xCC || sig[read] != 0x00) return false;
 
 	// ASN.1 is a clusterfuck so we skip parsing the remaining headers
 	// and hardcode the hash location.
 
-	u32 calcHash[8];
-	sha(data, size, calcHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
-
 	// Compare hash
 	u32 res = 0;
-	for(u32 i = 0; i < 8; i++) res |= ((u32*)(decSig + 0xE0))[i] ^ calcHash[i];
+	for(u32 i = 0; i < 8; i++) res |= ((const u32*)(sig + 0xE0))[i] ^ hash[i];
 
 	return res == 0;
 }
+
+bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
+{
+	fb_assert(encSig != NULL);
+	fb_assert(data != NULL);
+
+	// Kick off the modexp first and hash the data while the RSA engine is busy.
+	if(!RSA_decrypt2048Async(encSig)) return false;
+
+	u32 calcHash[8];
+	sha(data, size, calcHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	alignas(4) u32 decSig[0x100 / 4];
+	RSA_waitDecrypt2048(decSig);
+
+	return RSA_checkSigHash2048(decSig, calcHash);
+}
@@ -0,0 +1,1130 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Software implementation of the AES/SHA/RSA engine API in crypto.h for
+ * host builds. Link this instead of crypto.c to run the FIRM verification,
+ * NAND crypto and update code off-device. The keyslot, keyscrambler and
+ * word order/endianess semantics of the hardware are emulated.
+ * Uses AES-NI and the SHA extensions if the compiler targets them
+ * (-maes -msha -msse4.1). AES_ccm() is not emulated.
+ * Known answer tests live in tests/crypto_kat.c.
+ */
+
+#ifndef _3DS
+
+#include <string.h>
+#include "types.h"
+#include "util.h"
+#include "fb_assert.h"
+#include "arm9/hardware/crypto.h"
+
+#ifdef __AES__
+#include <wmmintrin.h>
+#endif
+#ifdef __SHA__
+#include <immintrin.h>
+#endif
+
+
+
+static inline u32 rd32be(const u8 *p)
+{
+	return (u32)p[0]<<24 | (u32)p[1]<<16 | (u32)p[2]<<8 | p[3];
+}
+
+static inline void wr32be(u8 *p, u32 v)
+{
+	p[0] = v>>24;
+	p[1] = v>>16;
+	p[2] = v>>8;
+	p[3] = v;
+}
+
+static inline u32 rd32le(const u8 *p)
+{
+	return (u32)p[3]<<24 | (u32)p[2]<<16 | (u32)p[1]<<8 | p[0];
+}
+
+static inline void wr32le(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v>>8;
+	p[2] = v>>16;
+	p[3] = v>>24;
+}
+
+
+
+//////////////////////////////////
+//             AES              //
+//////////////////////////////////
+
+typedef struct
+{
+	u8 rk[11][16];  // Encryption round keys
+	u8 drk[11][16]; // Decryption round keys (AES-NI only)
+} AesRoundKeys;
+
+typedef struct
+{
+	u8 keyX[16];
+	u8 keyY[16];
+	u8 normal[16];
+	bool set;
+	AesRoundKeys roundKeys;
+} AesKeyslot;
+
+
+static AesKeyslot aesKeyslots[0x40];
+static u8 aesSelectedSlot;
+
+static const u8 aesSbox[256] =
+{
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static u8 aesInvSbox[256];
+
+
+
+static inline u8 aesXtime(u8 x)
+{
+	return (u8)(x<<1 ^ (x & 0x80u ? 0x1Bu : 0u));
+}
+
+#ifndef __AES__
+static u8 aesMul(u8 a, u8 b)
+{
+	u8 res = 0;
+	while(b)
+	{
+		if(b & 1u) res ^= a;
+		a = aesXtime(a);
+		b >>= 1;
+	}
+
+	return res;
+}
+#endif
+
+static void aesExpandKey(AesRoundKeys *const keys, const u8 key[16])
+{
+	u8 (*const rk)[16] = keys->rk;
+	memcpy(rk[0], key, 16);
+
+	u8 rcon = 1;
+	for(u32 r = 1; r < 11; r++)
+	{
+		const u8 *const prev = rk[r - 1];
+		u8 *const cur = rk[r];
+
+		cur[0] = prev[0] ^ aesSbox[prev[13]] ^ rcon;
+		cur[1] = prev[1] ^ aesSbox[prev[14]];
+		cur[2] = prev[2] ^ aesSbox[prev[15]];
+		cur[3] = prev[3] ^ aesSbox[prev[12]];
+		for(u32 i = 4; i < 16; i++) cur[i] = prev[i] ^ cur[i - 4];
+
+		rcon = aesXtime(rcon);
+	}
+
+#ifdef __AES__
+	// The equivalent inverse cipher needs InvMixColumns applied to the middle round keys
+	_mm_storeu_si128((__m128i*)keys->drk[0], _mm_loadu_si128((const __m128i*)rk[10]));
+	for(u32 r = 1; r < 10; r++)
+		_mm_storeu_si128((__m128i*)keys->drk[r], _mm_aesimc_si128(_mm_loadu_si128((const __m128i*)rk[10 - r])));
+	_mm_storeu_si128((__m128i*)keys->drk[10], _mm_loadu_si128((const __m128i*)rk[0]));
+#endif
+}
+
+#ifdef __AES__
+static inline __m128i aesEncryptBlockNi(const AesRoundKeys *const keys, __m128i b)
+{
+	b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i*)keys->rk[0]));
+	for(u32 r = 1; r < 10; r++) b = _mm_aesenc_si128(b, _mm_loadu_si128((const __m128i*)keys->rk[r]));
+
+	return _mm_aesenclast_si128(b, _mm_loadu_si128((const __m128i*)keys->rk[10]));
+}
+#endif
+
+static void aesEncryptBlock(const AesRoundKeys *const keys, const u8 in[16], u8 out[16])
+{
+#ifdef __AES__
+	_mm_storeu_si128((__m128i*)out, aesEncryptBlockNi(keys, _mm_loadu_si128((const __m128i*)in)));
+#else
+	u8 s[16];
+	for(u32 i = 0; i < 16; i++) s[i] = in[i] ^ keys->rk[0][i];
+
+	for(u32 r = 1; r < 11; r++)
+	{
+		u8 t[16];
+
+		// SubBytes + ShiftRows
+		for(u32 c = 0; c < 4; c++)
+			for(u32 row = 0; row < 4; row++)
+				t[c * 4 + row] = aesSbox[s[((c + row) & 3u) * 4 + row]];
+
+		// MixColumns (not in the last round)
+		if(r != 10)
+		{
+			for(u32 c = 0; c < 4; c++)
+			{
+				u8 *const col = &t[c * 4];
+				const u8 a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+				const u8 all = a0 ^ a1 ^ a2 ^ a3;
+				col[0] ^= all ^ aesXtime(a0 ^ a1);
+				col[1] ^= all ^ aesXtime(a1 ^ a2);
+				col[2] ^= all ^ aesXtime(a2 ^ a3);
+				col[3] ^= all ^ aesXtime(a3 ^ a0);
+			}
+		}
+
+		for(u32 i = 0; i < 16; i++) s[i] = t[i] ^ keys->rk[r][i];
+	}
+
+	memcpy(out, s, 16);
+#endif
+}
+
+static void aesDecryptBlock(const AesRoundKeys *const keys, const u8 in[16], u8 out[16])
+{
+#ifdef __AES__
+	__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128((const __m128i*)keys->drk[0]));
+	for(u32 r = 1; r < 10; r++) b = _mm_aesdec_si128(b, _mm_loadu_si128((const __m128i*)keys->drk[r]));
+	_mm_storeu_si128((__m128i*)out, _mm_aesdeclast_si128(b, _mm_loadu_si128((const __m128i*)keys->drk[10])));
+#else
+	u8 s[16];
+	for(u32 i = 0; i < 16; i++) s[i] = in[i] ^ keys->rk[10][i];
+
+	for(u32 r = 9; r < 10; r--)
+	{
+		u8 t[16];
+
+		// InvShiftRows + InvSubBytes
+		for(u32 c = 0; c < 4; c++)
+			for(u32 row = 0; row < 4; row++)
+				t[((c + row) & 3u) * 4 + row] = aesInvSbox[s[c * 4 + row]];
+
+		for(u32 i = 0; i < 16; i++) t[i] ^= keys->rk[r][i];
+
+		// InvMixColumns (not after the last round)
+		if(r != 0)
+		{
+			for(u32 c = 0; c < 4; c++)
+			{
+				u8 *const col = &t[c * 4];
+				const u8 a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+				col[0] = aesMul(a0, 14) ^ aesMul(a1, 11) ^ aesMul(a2, 13) ^ aesMul(a3, 9);
+				col[1] = aesMul(a0, 9) ^ aesMul(a1, 14) ^ aesMul(a2, 11) ^ aesMul(a3, 13);
+				col[2] = aesMul(a0, 13) ^ aesMul(a1, 9) ^ aesMul(a2, 14) ^ aesMul(a3, 11);
+				col[3] = aesMul(a0, 11) ^ aesMul(a1, 13) ^ aesMul(a2, 9) ^ aesMul(a3, 14);
+			}
+		}
+
+		memcpy(s, t, 16);
+	}
+
+	memcpy(out, s, 16);
+#endif
+}
+
+// Converts between the memory layout selected by the word order/endianess
+// bits and the byte order the AES engine works with. The conversion is its
+// own inverse so it is used for input and output.
+static void aesConvertBlock(u8 dst[16], const u8 src[16], u8 orderEndianess)
+{
+	u8 tmp[16];
+	for(u32 w = 0; w < 4; w++)
+	{
+		const u8 *const srcWord = &src[(orderEndianess & AES_INPUT_NORMAL ? w : 3u - w) * 4];
+		u8 *const dstWord = &tmp[w * 4];
+		if(orderEndianess & AES_INPUT_BIG)
+		{
+			for(u32 i = 0; i < 4; i++) dstWord[i] = srcWord[i];
+		}
+		else
+		{
+			for(u32 i = 0; i < 4; i++) dstWord[i] = srcWord[3u - i];
+		}
+	}
+
+	memcpy(dst, tmp, 16);
+}
+
+static void aesRol128(u8 v[16], u32 bits)
+{
+	u8 tmp[16];
+	const u32 bytes = bits / 8;
+	const u32 rem = bits % 8;
+	for(u32 i = 0; i < 16; i++)
+	{
+		const u8 hi = v[(i + bytes) & 15u];
+		const u8 lo = v[(i + bytes + 1) & 15u];
+		tmp[i] = (rem ? (u8)(hi<<rem | lo>>(8 - rem)) : hi);
+	}
+
+	memcpy(v, tmp, 16);
+}
+
+static void aesAdd128(u8 v[16], const u8 c[16])
+{
+	u32 carry = 0;
+	for(u32 i = 16; i-- > 0; )
+	{
+		const u32 sum = (u32)v[i] + c[i] + carry;
+		v[i] = (u8)sum;
+		carry = sum>>8;
+	}
+}
+
+static void aesScrambleKey(AesKeyslot *const slot, bool twlScrambler)
+{
+	u8 key[16];
+
+	if(twlScrambler)
+	{
+		// NormalKey = ((KeyX ^ KeyY) + C) <<< 42
+		static const u8 twlC[16] = {0xFF, 0xFE, 0xFB, 0x4E, 0x29, 0x59, 0x02, 0x58,
+		                            0x2A, 0x68, 0x0F, 0x5F, 0x1A, 0x4F, 0x3E, 0x79};
+		for(u32 i = 0; i < 16; i++) key[i] = slot->keyX[i] ^ slot->keyY[i];
+		aesAdd128(key, twlC);
+		aesRol128(key, 42);
+	}
+	else
+	{
+		// NormalKey = (((KeyX <<< 2) ^ KeyY) + C) <<< 87
+		static const u8 ctrC[16] = {0x1F, 0xF9, 0xE9, 0xAA, 0xC5, 0xFE, 0x04, 0x08,
+		                            0x02, 0x45, 0x91, 0xDC, 0x5D, 0x52, 0x76, 0x8A};
+		memcpy(key, slot->keyX, 16);
+		aesRol128(key, 2);
+		for(u32 i = 0; i < 16; i++) key[i] ^= slot->keyY[i];
+		aesAdd128(key, ctrC);
+		aesRol128(key, 87);
+	}
+
+	memcpy(slot->normal, key, 16);
+}
+
+static void aesUpdateSlot(AesKeyslot *const slot)
+{
+	aesExpandKey(&slot->roundKeys, slot->normal);
+	slot->set = true;
+}
+
+void AES_init(void)
+{
+	for(u32 i = 0; i < 256; i++) aesInvSbox[aesSbox[i]] = (u8)i;
+
+	memset(aesKeyslots, 0, sizeof(aesKeyslots));
+	aesSelectedSlot = 0;
+}
+
+void AES_setKey(u8 keyslot, AesKeyType type, u8 orderEndianess, bool twlScrambler, const u32 key[4])
+{
+	fb_assert(keyslot < 0x40);
+	fb_assert(key != NULL);
+
+
+	// The TWL keyslots are always little endian registers. The word order
+	// is fixed up by software on hardware so we apply it here too.
+	if(keyslot < 4) orderEndianess &= AES_INPUT_NORMAL;
+
+	AesKeyslot *const slot = &aesKeyslots[keyslot];
+	u8 conv[16];
+	aesConvertBlock(conv, (const u8*)key, orderEndianess);
+
+	switch(type)
+	{
+		case AES_KEY_NORMAL:
+			memcpy(slot->normal, conv, 16);
+			break;
+		case AES_KEY_X:
+			memcpy(slot->keyX, conv, 16);
+			return; // Only setting key Y triggers the keyscrambler
+		case AES_KEY_Y:
+			memcpy(slot->keyY, conv, 16);
+			aesScrambleKey(slot, keyslot < 4 || twlScrambler);
+			break;
+	}
+
+	aesUpdateSlot(slot);
+}
+
+void AES_selectKeyslot(u8 keyslot)
+{
+	fb_assert(keyslot < 0x40);
+
+	aesSelectedSlot = keyslot;
+}
+
+void AES_setNonce(AES_ctx *const ctx, u8 orderEndianess, const u32 nonce[3])
+{
+	fb_assert(ctx != NULL);
+	fb_assert(nonce != NULL);
+
+
+	ctx->ctrIvNonceParams = (u32)orderEndianess<<23;
+	u32 *const ctxNonce = ctx->ctrIvNonce;
+	if(orderEndianess & AES_INPUT_NORMAL)
+	{
+		for(u32 i = 0; i < 3; i++) ctxNonce[i] = nonce[2u - i];
+	}
+	else
+	{
+		for(u32 i = 0; i < 3; i++) ctxNonce[i] = nonce[i];
+	}
+}
+
+void AES_setCtrIv(AES_ctx *const ctx, u8 orderEndianess, const u32 ctrIv[4])
+{
+	fb_assert(ctx != NULL);
+	fb_assert(ctrIv != NULL);
+
+
+	ctx->ctrIvNonceParams = (u32)orderEndianess<<23;
+	u32 *const ctxCtrIv = ctx->ctrIvNonce;
+	if(orderEndianess & AES_INPUT_NORMAL)
+	{
+		for(u32 i = 0; i < 4; i++) ctxCtrIv[i] = ctrIv[3u - i];
+	}
+	else
+	{
+		for(u32 i = 0; i < 4; i++) ctxCtrIv[i] = ctrIv[i];
+	}
+}
+
+void AES_addCounter(u32 ctr[4], u32 val)
+{
+	u64 sum = (u64)ctr[0] + (val>>4);
+	ctr[0] = (u32)sum;
+	for(u32 i = 1; i < 4 && (sum>>32); i++)
+	{
+		sum = (u64)ctr[i] + 1;
+		ctr[i] = (u32)sum;
+	}
+}
+
+void AES_setCryptParams(AES_ctx *const ctx, u8 inEndianessOrder, u8 outEndianessOrder)
+{
+	fb_assert(ctx != NULL);
+
+	ctx->aesParams = (u32)inEndianessOrder<<23 | (u32)outEndianessOrder<<22;
+}
+
+// Converts the counter registers (least significant word first) into
+// the big endian counter block the engine uses.
+static void aesCtrToBlock(u8 block[16], const u32 ctr[4], u32 ctrParams)
+{
+	const bool big = (ctrParams>>23 & AES_INPUT_BIG) != 0;
+	for(u32 i = 0; i < 4; i++)
+	{
+		const u32 w = ctr[3u - i];
+		wr32be(&block[i * 4], big ? __builtin_bswap32(w) : w);
+	}
+}
+
+static inline void aesIncBlock(u8 block[16])
+{
+	for(u32 i = 16; i-- > 0; )
+	{
+		if(++block[i] != 0) break;
+	}
+}
+
+void AES_ctr(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, UNUSED bool dma)
+{
+	fb_assert(ctx != NULL);
+	fb_assert(in != NULL);
+	fb_assert(out != NULL);
+
+	const AesRoundKeys *const keys = &aesKeyslots[aesSelectedSlot].roundKeys;
+	const u8 inParams = ctx->aesParams>>23 & 5u;
+	const u8 outParams = ctx->aesParams>>22 & 5u;
+	const u8 *src = (const u8*)in;
+	u8 *dst = (u8*)out;
+
+	u8 ctrBlock[16];
+	aesCtrToBlock(ctrBlock, ctx->ctrIvNonce, ctx->ctrIvNonceParams);
+
+#ifdef __AES__
+	// Keep 4 blocks in flight to hide the aesenc latency
+	const bool plainLayout = inParams == (AES_INPUT_BIG | AES_INPUT_NORMAL) &&
+	                         outParams == (AES_OUTPUT_BIG | AES_OUTPUT_NORMAL);
+	while(plainLayout && blocks >= 4)
+	{
+		__m128i ks[4];
+		for(u32 i = 0; i < 4; i++)
+		{
+			ks[i] = _mm_loadu_si128((const __m128i*)ctrBlock);
+			aesIncBlock(ctrBlock);
+		}
+
+		__m128i rk = _mm_loadu_si128((const __m128i*)keys->rk[0]);
+		for(u32 i = 0; i < 4; i++) ks[i] = _mm_xor_si128(ks[i], rk);
+		for(u32 r = 1; r < 10; r++)
+		{
+			rk = _mm_loadu_si128((const __m128i*)keys->rk[r]);
+			for(u32 i = 0; i < 4; i++) ks[i] = _mm_aesenc_si128(ks[i], rk);
+		}
+		rk = _mm_loadu_si128((const __m128i*)keys->rk[10]);
+		for(u32 i = 0; i < 4; i++)
+		{
+			ks[i] = _mm_aesenclast_si128(ks[i], rk);
+			const __m128i data = _mm_loadu_si128((const __m128i*)&src[i * 16]);
+			_mm_storeu_si128((__m128i*)&dst[i * 16], _mm_xor_si128(data, ks[i]));
+		}
+
+		src += 64;
+		dst += 64;
+		blocks -= 4;
+		AES_addCounter(ctx->ctrIvNonce, 4u<<4);
+	}
+#endif
+
+	while(blocks)
+	{
+		u8 data[16], ks[16];
+		aesConvertBlock(data, src, inParams);
+		aesEncryptBlock(keys, ctrBlock, ks);
+		for(u32 i = 0; i < 16; i++) data[i] ^= ks[i];
+		aesConvertBlock(dst, data, outParams);
+
+		aesIncBlock(ctrBlock);
+		src += 16;
+		dst += 16;
+		blocks--;
+		AES_addCounter(ctx->ctrIvNonce, 1u<<4);
+	}
+}
+
+void AES_ctrStreamInit(AES_ctrStream *const stream, const AES_ctx *const ctx)
+{
+	fb_assert(stream != NULL);
+	fb_assert(ctx != NULL);
+
+	stream->ctx = *ctx;
+	memcpy(stream->baseCtr, ctx->ctrIvNonce, 16);
+}
+
+void AES_ctrStreamSeek(AES_ctrStream *const stream, u64 offset)
+{
+	fb_assert(stream != NULL);
+	fb_assert((offset & 15u) == 0);
+
+	u32 *const ctr = stream->ctx.ctrIvNonce;
+	memcpy(ctr, stream->baseCtr, 16);
+
+	const u64 blocks = offset>>4;
+	u64 sum = (u64)ctr[0] + (u32)blocks;
+	ctr[0] = (u32)sum;
+	sum = (u64)ctr[1] + (u32)(blocks>>32) + (sum>>32);
+	ctr[1] = (u32)sum;
+	for(u32 i = 2; i < 4; i++)
+	{
+		sum = (u64)ctr[i] + (sum>>32);
+		ctr[i] = (u32)sum;
+	}
+}
+
+void AES_ctrStreamCrypt(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks, bool dma)
+{
+	fb_assert(stream != NULL);
+
+	AES_ctr(&stream->ctx, in, out, blocks, dma);
+}
+
+void AES_ecb(AES_ctx *const ctx, const u32 *in, u32 *out, u32 blocks, bool enc, UNUSED bool dma)
+{
+	fb_assert(ctx != NULL);
+	fb_assert(in != NULL);
+	fb_assert(out != NULL);
+
+	const AesRoundKeys *const keys = &aesKeyslots[aesSelectedSlot].roundKeys;
+	const u8 inParams = ctx->aesParams>>23 & 5u;
+	const u8 outParams = ctx->aesParams>>22 & 5u;
+	const u8 *src = (const u8*)in;
+	u8 *dst = (u8*)out;
+
+	while(blocks--)
+	{
+		u8 data[16];
+		aesConvertBlock(data, src, inParams);
+		if(enc) aesEncryptBlock(keys, data, data);
+		else    aesDecryptBlock(keys, data, data);
+		aesConvertBlock(dst, data, outParams);
+
+		src += 16;
+		dst += 16;
+	}
+}
+
+// AES_ccm() is not emulated. The hardware implementation is non-standard
+// (MAC padding, nonce limits) and nothing outside crypto.c uses it.
+
+
+
+//////////////////////////////////
+//             SHA              //
+//////////////////////////////////
+
+static struct
+{
+	u32 state[8];
+	u8 buf[64];
+	u32 bufUsed;
+	u64 totalSize;
+	u8 params;
+} shaCtx;
+
+
+static const u32 sha256K[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+
+static inline u32 ror32(u32 v, u32 n)
+{
+	return v>>n | v<<(32 - n);
+}
+
+static inline u32 rol32(u32 v, u32 n)
+{
+	return v<<n | v>>(32 - n);
+}
+
+#ifdef __SHA__
+static void sha256BlockNi(u32 state[8], const u8 block[64])
+{
+	const __m128i bswap = _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+
+	// Rearrange ABCD EFGH into the ABEF CDGH layout sha256rnds2 wants
+	__m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+	__m128i s1 = _mm_loadu_si128((const __m128i*)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);
+	s1 = _mm_shuffle_epi32(s1, 0x1B);
+	__m128i s0 = _mm_alignr_epi8(tmp, s1, 8);
+	s1 = _mm_blend_epi16(s1, tmp, 0xF0);
+
+	const __m128i abefSave = s0;
+	const __m128i cdghSave = s1;
+
+	__m128i msg[4];
+	for(u32 i = 0; i < 4; i++)
+		msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&block[i * 16]), bswap);
+
+	for(u32 i = 0; i < 16; i++)
+	{
+		__m128i m = _mm_add_epi32(msg[i & 3u], _mm_loadu_si128((const __m128i*)&sha256K[i * 4]));
+		s1 = _mm_sha256rnds2_epu32(s1, s0, m);
+		m = _mm_shuffle_epi32(m, 0x0E);
+		s0 = _mm_sha256rnds2_epu32(s0, s1, m);
+
+		// Message schedule for the next 4 rounds groups
+		if(i < 12)
+		{
+			__m128i next = _mm_sha256msg1_epu32(msg[i & 3u], msg[(i + 1) & 3u]);
+			next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(i + 3) & 3u], msg[(i + 2) & 3u], 4));
+			msg[i & 3u] = _mm_sha256msg2_epu32(next, msg[(i + 3) & 3u]);
+		}
+	}
+
+	s0 = _mm_add_epi32(s0, abefSave);
+	s1 = _mm_add_epi32(s1, cdghSave);
+
+	// Back to ABCD EFGH
+	tmp = _mm_shuffle_epi32(s0, 0x1B);
+	s1 = _mm_shuffle_epi32(s1, 0xB1);
+	s0 = _mm_blend_epi16(tmp, s1, 0xF0);
+	s1 = _mm_alignr_epi8(s1, tmp, 8);
+	_mm_storeu_si128((__m128i*)&state[0], s0);
+	_mm_storeu_si128((__m128i*)&state[4], s1);
+}
+#endif
+
+static void sha256Block(u32 state[8], const u8 block[64])
+{
+#ifdef __SHA__
+	sha256BlockNi(state, block);
+#else
+	u32 w[64];
+	for(u32 i = 0; i < 16; i++) w[i] = rd32be(&block[i * 4]);
+	for(u32 i = 16; i < 64; i++)
+	{
+		const u32 s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15]>>3);
+		const u32 s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2]>>10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	u32 a = state[0], b = state[1], c = state[2], d = state[3];
+	u32 e = state[4], f = state[5], g = state[6], h = state[7];
+	for(u32 i = 0; i < 64; i++)
+	{
+		const u32 t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+		const u32 t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+#endif
+}
+
+static void sha1Block(u32 state[8], const u8 block[64])
+{
+	u32 w[80];
+	for(u32 i = 0; i < 16; i++) w[i] = rd32be(&block[i * 4]);
+	for(u32 i = 16; i < 80; i++) w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+	for(u32 i = 0; i < 80; i++)
+	{
+		u32 f, k;
+		if(i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+		else if(i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+		else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+		else            { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+		const u32 t = rol32(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = rol32(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+}
+
+static inline bool shaIsSha1(void)
+{
+	return (shaCtx.params & SHA_MODE_MASK) >= SHA_MODE_1;
+}
+
+static void shaProcessBlock(const u8 block[64])
+{
+	u8 tmp[64];
+	const u8 *data = block;
+
+	// Little endian input means the engine byte swaps every word first
+	if(!(shaCtx.params & SHA_INPUT_BIG))
+	{
+		for(u32 i = 0; i < 64; i += 4) wr32be(&tmp[i], rd32le(&block[i]));
+		data = tmp;
+	}
+
+	if(shaIsSha1()) sha1Block(shaCtx.state, data);
+	else            sha256Block(shaCtx.state, data);
+}
+
+void SHA_start(u8 params)
+{
+	static const u32 sha256Init[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	                                  0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+	static const u32 sha224Init[8] = {0xC1059ED8, 0x367CD507, 0x3070DD17, 0xF70E5939,
+	                                  0xFFC00B31, 0x68581511, 0x64F98FA7, 0xBEFA4FA4};
+	static const u32 sha1Init[8]   = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+	                                  0xC3D2E1F0, 0, 0, 0};
+
+	shaCtx.params = params;
+	shaCtx.bufUsed = 0;
+	shaCtx.totalSize = 0;
+
+	const u32 *init;
+	switch(params & SHA_MODE_MASK)
+	{
+		case SHA_MODE_256:
+			init = sha256Init;
+			break;
+		case SHA_MODE_224:
+			init = sha224Init;
+			break;
+		case SHA_MODE_1:
+		default:           // 2 and 3 are both SHA1
+			init = sha1Init;
+	}
+	memcpy(shaCtx.state, init, sizeof(shaCtx.state));
+}
+
+void SHA_update(const u32 *data, u32 size)
+{
+	const u8 *src = (const u8*)data;
+	shaCtx.totalSize += size;
+
+	if(shaCtx.bufUsed)
+	{
+		const u32 fill = min(64 - shaCtx.bufUsed, size);
+		memcpy(&shaCtx.buf[shaCtx.bufUsed], src, fill);
+		shaCtx.bufUsed += fill;
+		src += fill;
+		size -= fill;
+
+		if(shaCtx.bufUsed < 64) return;
+		shaProcessBlock(shaCtx.buf);
+		shaCtx.bufUsed = 0;
+	}
+
+	while(size >= 64)
+	{
+		shaProcessBlock(src);
+		src += 64;
+		size -= 64;
+	}
+
+	if(size)
+	{
+		memcpy(shaCtx.buf, src, size);
+		shaCtx.bufUsed = size;
+	}
+}
+
+void SHA_finish(u32 *const hash, u8 endianess)
+{
+	// Padding is applied to the input as the engine sees it so
+	// the buffered tail must be byte swapped before padding.
+	u8 tail[64];
+	const u32 used = shaCtx.bufUsed;
+	memcpy(tail, shaCtx.buf, used);
+	if(!(shaCtx.params & SHA_INPUT_BIG))
+	{
+		for(u32 i = 0; i < (used & ~3u); i += 4) wr32be(&tail[i], rd32le(&shaCtx.buf[i]));
+		// A partial last word is passed through the FIFO as is
+	}
+	shaCtx.params |= SHA_INPUT_BIG;
+
+	const u64 bits = shaCtx.totalSize * 8;
+	tail[used] = 0x80;
+	if(used >= 56)
+	{
+		memset(&tail[used + 1], 0, 63 - used);
+		shaProcessBlock(tail);
+		memset(tail, 0, 56);
+	}
+	else memset(&tail[used + 1], 0, 55 - used);
+	wr32be(&tail[56], (u32)(bits>>32));
+	wr32be(&tail[60], (u32)bits);
+	shaProcessBlock(tail);
+	shaCtx.bufUsed = 0;
+
+	shaCtx.params = (shaCtx.params & SHA_MODE_MASK) | endianess;
+	SHA_getState(hash);
+}
+
+void SHA_getState(u32 *const out)
+{
+	u32 words;
+	switch(shaCtx.params & SHA_MODE_MASK)
+	{
+		case SHA_MODE_256:
+			words = 8;
+			break;
+		case SHA_MODE_224:
+			words = 7;
+			break;
+		case SHA_MODE_1:
+		default:           // 2 and 3 are both SHA1
+			words = 5;
+	}
+
+	u8 *const dst = (u8*)out;
+	for(u32 i = 0; i < words; i++)
+	{
+		if(shaCtx.params & SHA_OUTPUT_BIG) wr32be(&dst[i * 4], shaCtx.state[i]);
+		else                               wr32le(&dst[i * 4], shaCtx.state[i]);
+	}
+}
+
+void sha(const u32 *data, u32 size, u32 *const hash, u8 params, u8 hashEndianess)
+{
+	SHA_start(params);
+	SHA_update(data, size);
+	SHA_finish(hash, hashEndianess);
+}
+
+void AES_ctrStreamCryptSha(AES_ctrStream *const stream, const u32 *in, u32 *out, u32 blocks)
+{
+	fb_assert(stream != NULL);
+	fb_assert(in != NULL);
+	fb_assert(out != NULL);
+
+	while(blocks)
+	{
+		const u32 blockNum = min(blocks, AES_SHA_CHUNK_BLOCKS);
+		AES_ctr(&stream->ctx, in, out, blockNum, true);
+		SHA_update(out, blockNum<<4);
+
+		in += blockNum<<2;
+		out += blockNum<<2;
+		blocks -= blockNum;
+	}
+}
+
+
+
+//////////////////////////////////
+//             RSA              //
+//////////////////////////////////
+
+#define RSA_LIMBS  (2048 / 32)
+
+typedef struct
+{
+	u32 mod[RSA_LIMBS]; // Little endian limbs
+	u32 exp;
+	bool set;
+} RsaKeyslot;
+
+
+static RsaKeyslot rsaKeyslots[4];
+static u8 rsaSelectedSlot;
+static u8 rsaResult[0x100];
+
+
+
+static void bnFromBytes(u32 dst[RSA_LIMBS], const u8 src[0x100])
+{
+	for(u32 i = 0; i < RSA_LIMBS; i++) dst[i] = rd32be(&src[0x100 - 4 - i * 4]);
+}
+
+static void bnToBytes(u8 dst[0x100], const u32 src[RSA_LIMBS])
+{
+	for(u32 i = 0; i < RSA_LIMBS; i++) wr32be(&dst[0x100 - 4 - i * 4], src[i]);
+}
+
+static bool bnGreaterEqual(const u32 *a, const u32 *b)
+{
+	for(u32 i = RSA_LIMBS; i-- > 0; )
+	{
+		if(a[i] != b[i]) return a[i] > b[i];
+	}
+
+	return true;
+}
+
+static u32 bnSub(u32 *a, const u32 *b)
+{
+	u64 borrow = 0;
+	for(u32 i = 0; i < RSA_LIMBS; i++)
+	{
+		const u64 diff = (u64)a[i] - b[i] - borrow;
+		a[i] = (u32)diff;
+		borrow = (diff>>32) & 1u;
+	}
+
+	return (u32)borrow;
+}
+
+// Montgomery multiplication (CIOS). res = a * b * R^-1 mod n
+static void bnMontMul(u32 res[RSA_LIMBS], const u32 a[RSA_LIMBS], const u32 b[RSA_LIMBS],
+                      const u32 n[RSA_LIMBS], u32 nInv)
+{
+	u32 t[RSA_LIMBS + 2] = {0};
+
+	for(u32 i = 0; i < RSA_LIMBS; i++)
+	{
+		u64 carry = 0;
+		for(u32 j = 0; j < RSA_LIMBS; j++)
+		{
+			const u64 v = (u64)a[j] * b[i] + t[j] + carry;
+			t[j] = (u32)v;
+			carry = v>>32;
+		}
+		u64 v = (u64)t[RSA_LIMBS] + carry;
+		t[RSA_LIMBS] = (u32)v;
+		t[RSA_LIMBS + 1] = (u32)(v>>32);
+
+		const u32 m = t[0] * nInv;
+		carry = ((u64)m * n[0] + t[0])>>32;
+		for(u32 j = 1; j < RSA_LIMBS; j++)
+		{
+			v = (u64)m * n[j] + t[j] + carry;
+			t[j - 1] = (u32)v;
+			carry = v>>32;
+		}
+		v = (u64)t[RSA_LIMBS] + carry;
+		t[RSA_LIMBS - 1] = (u32)v;
+		t[RSA_LIMBS] = t[RSA_LIMBS + 1] + (u32)(v>>32);
+	}
+
+	if(t[RSA_LIMBS] || bnGreaterEqual(t, n)) bnSub(t, n);
+	memcpy(res, t, RSA_LIMBS * 4);
+}
+
+static void rsaModExp(u8 out[0x100], const u8 in[0x100], const RsaKeyslot *const slot)
+{
+	const u32 *const n = slot->mod;
+
+	// -n^-1 mod 2^32 (Newton iteration, n is odd)
+	u32 inv = 1;
+	for(u32 i = 0; i < 5; i++) inv *= 2 - n[0] * inv;
+	const u32 nInv = -inv;
+
+	// R^2 mod n by doubling 1 (2 * 2048) times
+	u32 r2[RSA_LIMBS] = {1};
+	for(u32 i = 0; i < 2 * 2048; i++)
+	{
+		u32 carry = 0;
+		for(u32 j = 0; j < RSA_LIMBS; j++)
+		{
+			const u32 next = r2[j]>>31;
+			r2[j] = r2[j]<<1 | carry;
+			carry = next;
+		}
+		if(carry || bnGreaterEqual(r2, n)) bnSub(r2, n);
+	}
+
+	u32 base[RSA_LIMBS], acc[RSA_LIMBS], one[RSA_LIMBS] = {1};
+	bnFromBytes(base, in);
+	bnMontMul(base, base, r2, n, nInv); // To Montgomery form
+	bnMontMul(acc, one, r2, n, nInv);   // R mod n
+
+	for(u32 bit = 32; bit-- > 0; )
+	{
+		bnMontMul(acc, acc, acc, n, nInv);
+		if(slot->exp>>bit & 1u) bnMontMul(acc, acc, base, n, nInv);
+	}
+
+	bnMontMul(acc, acc, one, n, nInv); // Back to normal form
+	bnToBytes(out, acc);
+}
+
+void RSA_init(void)
+{
+	memset(rsaKeyslots, 0, sizeof(rsaKeyslots));
+	rsaSelectedSlot = 0;
+}
+
+void RSA_selectKeyslot(u8 keyslot)
+{
+	fb_assert(keyslot < 4);
+
+	rsaSelectedSlot = keyslot;
+}
+
+bool RSA_setKey2048(u8 keyslot, const u32 *const mod, u32 exp)
+{
+	fb_assert(keyslot < 4);
+	fb_assert(mod != NULL);
+
+	RsaKeyslot *const slot = &rsaKeyslots[keyslot];
+	// The exponent register is written in big endian
+	slot->exp = __builtin_bswap32(exp);
+	bnFromBytes(slot->mod, (const u8*)mod);
+	slot->set = (slot->mod[0] & 1u) != 0; // Montgomery needs an odd modulus
+	rsaSelectedSlot = keyslot;
+
+	return slot->set;
+}
+
+bool RSA_decrypt2048Async(const u32 *const encSig)
+{
+	fb_assert(encSig != NULL);
+
+	const RsaKeyslot *const slot = &rsaKeyslots[rsaSelectedSlot];
+	if(!slot->set) return false;
+
+	// No engine to run in the background. Do the work right away.
+	rsaModExp(rsaResult, (const u8*)encSig, slot);
+
+	return true;
+}
+
+bool RSA_isBusy(void)
+{
+	return false;
+}
+
+void RSA_waitDecrypt2048(u32 *const decSig)
+{
+	fb_assert(decSig != NULL);
+
+	memcpy(decSig, rsaResult, 0x100);
+}
+
+bool RSA_decrypt2048(u32 *const decSig, const u32 *const encSig)
+{
+	fb_assert(decSig != NULL);
+	fb_assert(encSig != NULL);
+
+	if(!RSA_decrypt2048Async(encSig)) return false;
+	RSA_waitDecrypt2048(decSig);
+
+	return true;
+}
+
+bool RSA_checkSigHash2048(const u32 *const decSig, const u32 hash[8])
+{
+	fb_assert(decSig != NULL);
+	fb_assert(hash != NULL);
+
+	const u8 *const sig = (const u8*)decSig;
+	if(sig[0] != 0x00 || sig[1] != 0x01) return false;
+	u32 read = 2;
+	while(sig[read] == 0xFF && ++read < 0x100);
+	if(read != 0xCC || sig[read] != 0x00) return false;
+
+	// Same shortcut as the hardware backend. The ASN.1 header is skipped.
+	return memcmp(sig + 0xE0, hash, 32) == 0;
+}
+
+bool RSA_verify2048(const u32 *const encSig, const u32 *const data, u32 size)
+{
+	fb_assert(encSig != NULL);
+	fb_assert(data != NULL);
+
+	if(!RSA_decrypt2048Async(encSig)) return false;
+
+	u32 calcHash[8];
+	sha(data, size, calcHash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+
+	alignas(4) u32 decSig[0x100 / 4];
+	RSA_waitDecrypt2048(decSig);
+
+	return RSA_checkSigHash2048(decSig, calcHash);
+}
+
+#endif // ifndef _3DS
@@ -27,6 +27,7 @@
 #include "util.h"
 #include "arm9/dev.h"
 #include "arm9/hardware/sdmmc.h"
+#include "perf.h"
 
 #define DATA32_SUPPORT
 
@@ -72,6 +73,9 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 		flags |= TMIO_STAT0_DATAEND;
 	}
 
+	const u32 perfDev = (ctx == &handleSD ? PERF_DEV_SD : PERF_DEV_NAND);
+	const u32 perfStart = perfGetTicks();
+
 	ctx->error = 0;
 	while((sdmmc_read16(REG_SDSTATUS1) & TMIO_STAT1_CMD_BUSY)); //mmc working?
 	sdmmc_write16(REG_SDIRMASK0,0);
@@ -234,6 +238,10 @@ static void sdmmc_send_command(struct mmcdevice *ctx, u32 cmd, u32 args)
 				break;
 		}
 	}
+	PERF_COUNT(sdmmcCmds[perfDev], 1);
+	if(readdata || writedata) PERF_COUNT(sdmmcBytes[perfDev], ctx->size - size);
+	PERF_COUNT(sdmmcTicks[perfDev], perfGetTicks() - perfStart);
+
 	ctx->stat0 = sdmmc_read16(REG_SDSTATUS0);
 	ctx->stat1 = sdmmc_read16(REG_SDSTATUS1);
 	sdmmc_write16(REG_SDSTATUS0,0);
@@ -76,6 +76,27 @@ u16 TIMER_stop(Timer timer)
 	return REG_TIMER_VAL(timer);
 }
 
+void TIMER_startCounter(Timer timer, TimerPrescaler prescaler)
+{
+	// The next timer counts the overflows of this one
+	REG_TIMER_VAL(timer + 1) = 0;
+	REG_TIMER_CNT(timer + 1) = TIMER_ENABLE | TIMER_COUNT_UP;
+	REG_TIMER_VAL(timer) = 0;
+	REG_TIMER_CNT(timer) = TIMER_ENABLE | prescaler;
+}
+
+u32 TIMER_getCounter(Timer timer)
+{
+	u16 hi, lo;
+	do
+	{
+		hi = REG_TIMER_VAL(timer + 1);
+		lo = REG_TIMER_VAL(timer);
+	} while(hi != REG_TIMER_VAL(timer + 1));
+
+	return (u32)hi<<16 | lo;
+}
+
 void TIMER_sleep(u32 ms)
 {
 	REG_TIMER3_VAL = TIMER_FREQ_64(1000);
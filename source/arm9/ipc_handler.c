@@ -26,6 +26,8 @@
 #include "arm9/firm.h"
 #include "firmwriter.h"
 #include "arm9/hardware/cfg9.h"
+#include "perf.h"
+#include "trace.h"
 
 
 
@@ -44,6 +46,7 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 			result = fMount(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FUNMOUNT):
+			firmPreloadDiscard();
 			result = fUnmount(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FIS_DRIVE_MOUNTED):
@@ -59,6 +62,7 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 			result = fIsDevActive(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FPREP_RAW_ACCESS):
+			firmPreloadDiscard();
 			result = fPrepareRawAccess(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FFINAL_RAW_ACCESS):
@@ -112,6 +116,9 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 		case IPC_CMD_ID_MASK(IPC_CMD9_FREAD_DIR):
 			result = fReadDir(buf[2], (FsFileInfo*)buf[0], buf[3]);
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_FREAD_DIR_PACKED):
+			result = fReadDirPacked(buf[4], buf[5], buf[6], (const char *const)buf[0], (void *const)buf[2], buf[3]);
+			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FCLOSE_DIR):
 			result = fCloseDir(buf[0]);
 			break;
@@ -125,16 +132,20 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 			result = fUnlink((const char *const)buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FVERIFY_NAND_IMG):
+			firmPreloadDiscard();
 			result = fVerifyNandImage((const char *const)buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FSET_NAND_PROT):
+			firmPreloadDiscard();
 			result = fSetNandProtection(buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_WRITE_FIRM_PART):
+			firmPreloadDiscard();
 			result = writeFirmPartition((const char *const)buf[0], (bool)buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_LOAD_VERIFY_FIRM):
-			result = loadVerifyFirm((const char *const)buf[0], buf[2], false);
+			if(!firmPreloadCommit((const char *const)buf[0], buf[4], (const u32 *const)buf[2], (s32*)&result))
+				result = loadVerifyFirm((const char *const)buf[0], buf[4], false, (const u32 *const)buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_FIRM_LAUNCH):
 			{
@@ -143,19 +154,34 @@ u32 IPC_handleCmd(u8 cmdId, u32 inBufs, u32 outBufs, const u32 *const buf)
 			}
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_LOAD_VERIFY_UPDATE):
+			firmPreloadDiscard();
 			result = loadVerifyUpdate((const char *const)buf[0], (u32 *const)buf[2]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_GET_BOOT_ENV):
 			result = REG_CFG9_BOOTENV;
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_TOGGLE_SUPERHAX):
+			firmPreloadDiscard();
 			result = toggleSuperhax((bool)buf[0]);
 			break;
 		case IPC_CMD_ID_MASK(IPC_CMD9_PREPARE_POWER):
 		case IPC_CMD_ID_MASK(IPC_CMD9_PANIC):
 		case IPC_CMD_ID_MASK(IPC_CMD9_EXCEPTION):
+			firmPreloadDiscard();
 			fsDeinit();
 			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_PRELOAD_FIRM):
+			// Runs from the main loop. See firmPreloadStep().
+			firmPreloadStart((const char *const)buf[0], buf[4], (const u32 *const)buf[2]);
+			break;
+		case IPC_CMD_ID_MASK(IPC_CMD9_GET_PERF):
+			if(buf[1] >= sizeof(PerfCounters)) perfCopy((PerfCounters*)buf[0]);
+			break;
+#ifdef BOOT_TRACE
+		case IPC_CMD_ID_MASK(IPC_CMD9_GET_TRACE):
+			if(buf[1] >= sizeof(TraceBuffer)) traceCopy((TraceBuffer*)buf[0]);
+			break;
+#endif
 		default:
 			panic();
 	}
@@ -20,6 +20,7 @@
 #include "mem_map.h"
 #include "arm9/debug.h"
 #include "arm9/hardware/cfg9.h"
+#include "arm9/hardware/interrupt.h"
 #include "arm.h"
 #include "arm9/firm.h"
 
@@ -32,7 +33,15 @@ int main(void)
 {
 	debugHashCodeRoData();
 
-	while(!g_startFirmLaunch) __wfi();
+	while(!g_startFirmLaunch)
+	{
+		// IPC commands are handled in the PXI IRQ. Masking it makes
+		// each preload step atomic to them. A pending IRQ still wakes
+		// us up from wfi.
+		const u32 oldState = enterCriticalSection();
+		if(!firmPreloadStep() && !g_startFirmLaunch) __wfi();
+		leaveCriticalSection(oldState);
+	}
 
 	// TODO: Proper argc/v passing needs to be implemented.
 	firmLaunch();
@@ -22,6 +22,8 @@
 #include "arm9/hardware/timer.h"
 #include "hardware/pxi.h"
 #include "arm9/hardware/crypto.h"
+#include "perf.h"
+#include "trace.h"
 
 
 
@@ -30,6 +32,10 @@ void WEAK __systemInit(void)
 	IRQ_init();
 	leaveCriticalSection(0); // Enables interrupts
 	TIMER_init();
+	perfInit();
+#ifdef BOOT_TRACE
+	traceInit();
+#endif
 	NDMA_init();
 	AES_init();
 	RSA_init();
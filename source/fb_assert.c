@@ -24,6 +24,7 @@
 	#include "arm9/hardware/ndma.h"
 #elif ARM11
 	#include "arm11/fmt.h"
+	#include "arm11/console.h"
 	#include "arm11/hardware/interrupt.h"
 #endif
 #include "hardware/gfx.h"
@@ -42,6 +43,7 @@ noreturn void __fb_assert(const char *const str, u32 line)
 	PXI_sendCmd(IPC_CMD11_PANIC, NULL, 0);
 #elif ARM11
 	ee_printf("Assertion failed: %s:%" PRIu32, str, line);
+	consoleFlush();
 	GX_textureCopy((u64*)RENDERBUF_TOP, 0, (u64*)GFX_getFramebuffer(SCREEN_TOP),
 	               0, SCREEN_SIZE_TOP + SCREEN_SIZE_SUB);
 	GFX_swapFramebufs();
@@ -28,6 +28,8 @@
 #include "ipc_handler.h"
 #include "fb_assert.h"
 #include "hardware/cache.h"
+#include "trace.h"
+#include "perf.h"
 
 
 static vu32 g_lastResp[2] = {0};
@@ -66,11 +68,13 @@ void PXI_init(void)
 #ifdef ARM9
 	REG_PXI_SYNC_SENT = 9;
 	while(REG_PXI_SYNC_RECVD != 11);
+	TRACE_POINT(TRACE_SYNC, 0);
 
 	IRQ_registerHandler(IRQ_PXI_SYNC, pxiIrqHandler);
 #elif ARM11
 	while(REG_PXI_SYNC_RECVD != 9);
 	REG_PXI_SYNC_SENT = 11;
+	TRACE_POINT(TRACE_SYNC, 0);
 
 	IRQ_registerHandler(IRQ_PXI_SYNC, 13, 0, true, pxiIrqHandler);
 #endif
@@ -120,6 +124,7 @@ u32 PXI_sendCmd(u32 cmd, const u32 *buf, u32 words)
 		if(outBuf->ptr && outBuf->size) invalidateDCacheRange(outBuf->ptr, outBuf->size);
 	}
 
+	const u32 startTicks = perfGetTicks();
 	pxiSendWord(cmd);
 	pxiSyncRequest();
 
@@ -129,6 +134,8 @@ u32 PXI_sendCmd(u32 cmd, const u32 *buf, u32 words)
 	while(g_lastResp[0] != (IPC_CMD_RESP_FLAG | cmd)) __wfi();
 	g_lastResp[0] = 0;
 	const u32 res = g_lastResp[1];
+	PERF_COUNT(pxiCmds, 1);
+	PERF_COUNT(pxiWaitTicks, perfGetTicks() - startTicks);
 
 #ifdef ARM11
 	// The CPU may do speculative prefetches of data after the first invalidation
@@ -0,0 +1,77 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "perf.h"
+#ifdef ARM9
+	#include "arm9/hardware/interrupt.h"
+#elif ARM11
+	#include "arm11/hardware/interrupt.h"
+	#include "arm11/hardware/cfg11.h"
+	#include "hardware/pxi.h"
+	#include "ipc_handler.h"
+#endif
+
+
+PerfCounters g_perfCounters;
+
+
+
+void perfInit(void)
+{
+	memset(&g_perfCounters, 0, sizeof(PerfCounters));
+	g_perfCounters.tickFreq = perfGetTickFreq();
+
+#ifdef ARM9
+	TIMER_startCounter(TIMER_0, TIMER_PRESCALER_64);
+#elif ARM11
+	startProfiling(0, 0, true, 3); // Reset the counters too
+#endif
+}
+
+u32 perfGetTickFreq(void)
+{
+#ifdef ARM9
+	return TIMER_BASE_FREQ / 64;
+#elif ARM11
+	// core123Init() switches the New 3DS to 2x or 3x before perfInit()
+	// runs. CLKCNT 0/1 is 1x, 2/3 is 2x and 4/5 is 3x.
+	u32 mul = 1;
+	if(REG_CFG11_SOCINFO & 2) mul = (REG_CFG11_MPCORE_CLKCNT & 7) / 2 + 1;
+
+	return (u32)TIMER_BASE_FREQ / 64 * mul;
+#endif
+}
+
+void perfCopy(PerfCounters *const out)
+{
+	const u32 oldState = enterCriticalSection();
+	memcpy(out, &g_perfCounters, sizeof(PerfCounters));
+	leaveCriticalSection(oldState);
+}
+
+#ifdef ARM11
+void perfGetArm9(PerfCounters *const out)
+{
+	u32 cmdBuf[2];
+	cmdBuf[0] = (u32)out;
+	cmdBuf[1] = sizeof(PerfCounters);
+	PXI_sendCmd(IPC_CMD9_GET_PERF, cmdBuf, 2);
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef BOOT_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "trace.h"
+#include "perf.h"
+#ifdef ARM9
+	#include "arm9/hardware/interrupt.h"
+#elif ARM11
+	#include "arm11/hardware/interrupt.h"
+	#include "hardware/pxi.h"
+	#include "ipc_handler.h"
+	#include "fs.h"
+	#include "arm.h"
+#endif
+
+
+// Timestamps come from the perf tick counter. It only runs on
+// ARM11 core 0 so events from the worker cores are dropped. That
+// also keeps traceBuf.count updated by a single core.
+static TraceBuffer traceBuf;
+
+
+
+void traceInit(void)
+{
+	memcpy(&traceBuf.magic, "FBTR", 4);
+	traceBuf.version = TRACE_VERSION;
+	traceBuf.tickFreq = perfGetTickFreq();
+	traceBuf.count = 0;
+}
+
+void traceEvent(u32 event, u32 arg)
+{
+#ifdef ARM11
+	if(__getCpuId() != 0) return;
+#endif
+
+	const u32 oldState = enterCriticalSection();
+
+	TraceEntry *const entry = &traceBuf.entries[traceBuf.count++ % TRACE_ENTRIES];
+	entry->time = perfGetTicks();
+	entry->event = event;
+#ifdef ARM9
+	entry->cpu = TRACE_CPU_ARM9;
+#elif ARM11
+	entry->cpu = 0;
+#endif
+	entry->arg = arg;
+
+	leaveCriticalSection(oldState);
+}
+
+void traceCopy(TraceBuffer *const out)
+{
+	const u32 oldState = enterCriticalSection();
+	memcpy(out, &traceBuf, sizeof(TraceBuffer));
+	leaveCriticalSection(oldState);
+}
+
+#ifdef ARM11
+bool traceDump(void)
+{
+	TraceBuffer *const bufs = (TraceBuffer*)malloc(sizeof(TraceBuffer) * 2);
+	if(!bufs) return false;
+
+	traceCopy(&bufs[0]);
+
+	u32 cmdBuf[2];
+	cmdBuf[0] = (u32)&bufs[1];
+	cmdBuf[1] = sizeof(TraceBuffer);
+	PXI_sendCmd(IPC_CMD9_GET_TRACE, cmdBuf, 2);
+
+	bool res = false;
+	const s32 fHandle = fOpen(TRACE_DUMP_PATH, FS_CREATE_ALWAYS | FS_OPEN_WRITE);
+	if(fHandle >= 0)
+	{
+		res = (fWrite(fHandle, bufs, sizeof(TraceBuffer) * 2) == 0);
+		fClose(fHandle);
+	}
+
+	free(bufs);
+
+	return res;
+}
+#endif
+
+#endif // ifdef BOOT_TRACE
@@ -0,0 +1,122 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "wildcard.h"
+
+
+static inline char foldChar(char c)
+{
+	return (c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+}
+
+bool wildcardCompile(WildcardPattern *const pat, const char *pattern)
+{
+	memset(pat, 0, sizeof(WildcardPattern));
+	if(strlen(pattern) > WILDCARD_MAX_LEN) return false;
+
+	pat->anchorStart = (*pattern != '*');
+
+	u32 len = 0;
+	u32 segLen = 0;
+	for(; *pattern; pattern++)
+	{
+		if(*pattern != '*')
+		{
+			pat->chars[len++] = foldChar(*pattern);
+			segLen++;
+			continue;
+		}
+
+		// End of a segment. Empty ones from "**" are dropped.
+		if(segLen)
+		{
+			if(pat->numSegs == WILDCARD_MAX_SEGS) return false;
+			pat->segStart[pat->numSegs] = len - segLen;
+			pat->segLen[pat->numSegs++] = segLen;
+			segLen = 0;
+		}
+	}
+
+	if(segLen)
+	{
+		if(pat->numSegs == WILDCARD_MAX_SEGS) return false;
+		pat->segStart[pat->numSegs] = len - segLen;
+		pat->segLen[pat->numSegs++] = segLen;
+		pat->anchorEnd = true;
+	}
+	else pat->anchorEnd = (len == 0 && pat->anchorStart); // Empty pattern
+
+	pat->minLen = len;
+
+	return true;
+}
+
+static bool matchSeg(const WildcardPattern *const pat, u32 seg, const char *name)
+{
+	const char *chars = &pat->chars[pat->segStart[seg]];
+	for(u32 i = 0; i < pat->segLen[seg]; i++)
+	{
+		if(chars[i] != '?' && chars[i] != foldChar(name[i])) return false;
+	}
+
+	return true;
+}
+
+bool wildcardMatch(const WildcardPattern *const pat, const char *const name)
+{
+	const u32 nameLen = strlen(name);
+	if(nameLen < pat->minLen) return false;
+	if(!pat->numSegs) return !pat->anchorStart || !nameLen;
+
+	u32 first = 0;
+	u32 last = pat->numSegs;
+	u32 pos = 0;
+	u32 end = nameLen;
+
+	// No '*' at all. The name must be exactly the one segment.
+	if(pat->anchorStart && pat->anchorEnd && last == 1)
+		return nameLen == pat->segLen[0] && matchSeg(pat, 0, name);
+
+	// Fixed prefix and suffix. minLen makes sure they don't overlap.
+	if(pat->anchorStart)
+	{
+		if(!matchSeg(pat, 0, name)) return false;
+		pos = pat->segLen[0];
+		first = 1;
+	}
+	if(pat->anchorEnd)
+	{
+		end -= pat->segLen[last - 1];
+		if(!matchSeg(pat, last - 1, &name[end])) return false;
+		last--;
+	}
+
+	// Segments in between go to the leftmost place they fit. Taking the
+	// leftmost one never rules out a match for the following segments.
+	for(u32 seg = first; seg < last; seg++)
+	{
+		const u32 segLen = pat->segLen[seg];
+		while(pos + segLen <= end && !matchSeg(pat, seg, &name[pos])) pos++;
+		if(pos + segLen > end) return false;
+		pos += segLen;
+	}
+
+	return true;
+}
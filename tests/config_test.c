@@ -0,0 +1,563 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Equivalence, fuzz and timing test for parseConfigFile(). Includes config.c
+ * to reach its statics and runs the one pass parser against the original two
+ * pass parser (copied below) on generated files made of real keys, near miss
+ * keys, odd spacing, all line endings and random bytes. Every key must end up
+ * with the same text and native data. Then loads boot.cfg through an in
+ * memory SD card to check the snapshot is the only file read on later boots,
+ * keeps the parse error and is dropped after an edit or damage. Built with
+ * AddressSanitizer as a test and without it, with CONFIG_BENCH, as a
+ * benchmark of both parsers.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "types.h"
+#include "../source/arm11/config.c"
+#include "test.h"
+
+
+#define FUZZ_FILES  (20000)
+#define BENCH_ITERS (20000)
+
+
+typedef struct {
+	s32 textOffset;	// -1 if the key isn't defined
+	u32 textLength;
+	u32 dataSize;
+	u8 data[0x100];
+} KeyResult;
+
+typedef struct {
+	const char *path;
+	bool exists;
+	u32 size;
+	u32 pos;
+	u32 reads;
+	u16 ftime;
+	u8 data[0x10000];
+} TestFile;
+
+
+
+// In memory SD card with just boot.cfg and its snapshot
+static TestFile testFiles[] = {{.path = "sdmc:/boot/boot.cfg"}, {.path = "sdmc:/boot/boot.cfg.bin"}};
+
+static TestFile* findFile(const char *path)
+{
+	for(u32 i = 0; i < arrayEntries(testFiles); i++)
+		if(strcmp(testFiles[i].path, path) == 0) return &testFiles[i];
+	return NULL;
+}
+
+bool fIsDevActive(FsDevice dev) { return dev == FS_DEVICE_SDMC; }
+
+s32 fOpen(const char *const path, FsOpenMode mode)
+{
+	TestFile *const f = findFile(path);
+	if(!f || (!f->exists && !(mode & FS_CREATE_ALWAYS))) return -1;
+	if(mode & FS_CREATE_ALWAYS) f->size = 0;
+	f->exists = true;
+	f->pos = 0;
+	return f - testFiles;
+}
+
+s32 fRead(s32 handle, void *const buf, u32 size)
+{
+	TestFile *const f = &testFiles[handle];
+	if(size > f->size - f->pos) return -1;
+	memcpy(buf, &f->data[f->pos], size);
+	f->pos += size;
+	f->reads++;
+	return 0;
+}
+
+s32 fWrite(s32 handle, const void *const buf, u32 size)
+{
+	TestFile *const f = &testFiles[handle];
+	if(size > sizeof(f->data) - f->pos) return -1;
+	memcpy(&f->data[f->pos], buf, size);
+	f->pos += size;
+	if(f->pos > f->size) f->size = f->pos;
+	f->ftime = 0; // Like FatFs without RTC
+	return 0;
+}
+
+s32 fSync(UNUSED s32 handle) { return 0; }
+u32 fSize(s32 handle) { return testFiles[handle].size; }
+s32 fClose(UNUSED s32 handle) { return 0; }
+
+s32 fStat(const char *const path, FsFileInfo *fi)
+{
+	const TestFile *const f = findFile(path);
+	if(!f || !f->exists) return -1;
+	memset(fi, 0, sizeof(FsFileInfo));
+	fi->fsize = f->size;
+	fi->ftime = f->ftime;
+	return 0;
+}
+
+s32 fUnlink(const char *const path)
+{
+	TestFile *const f = findFile(path);
+	if(!f || !f->exists) return -1;
+	f->exists = false;
+	return 0;
+}
+
+bool fsCreateFileWithPath(const char *filepath) { return fOpen(filepath, FS_CREATE_ALWAYS) >= 0; }
+noreturn void panic() { abort(); }
+noreturn void panicMsg(UNUSED const char *msg) { abort(); }
+
+int strnicmp(const char *str1, const char *str2, u32 len)
+{
+	return strncasecmp(str1, str2, len);
+}
+
+u32 ee_sprintf(char *const buf, const char *const fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	const int ret = vsprintf(buf, fmt, args);
+	va_end(args);
+	return ret;
+}
+
+char *itoa(int value, char *str, UNUSED int base)
+{
+	sprintf(str, "%d", value);
+	return str;
+}
+
+void memcpy_s(void *dstBuf, size_t dstBufSize, size_t dstBufOffset,
+				void *srcBuf, size_t srcBufSize, size_t srcBufOffset, UNUSED bool reverse)
+{
+	if(dstBufOffset >= dstBufSize || srcBufOffset >= srcBufSize) return;
+	const size_t dstRemaining = dstBufSize - dstBufOffset;
+	const size_t srcRemaining = srcBufSize - srcBufOffset;
+	memcpy((u8*)dstBuf + dstBufOffset, (u8*)srcBuf + srcBufOffset, min(dstRemaining, srcRemaining));
+}
+
+// The original parser, unchanged apart from the names
+static char *refFindNextDefinition(char **curp, int *key)
+{
+	int keyIdx = 0;
+	char *cur;
+	bool keyFound;
+	size_t keyLen;
+	char *start = NULL;
+
+	for(cur = *curp; *cur != '\0'; )
+	{
+		keyFound = false;
+		keyLen = 0;
+		for(int i=0; i<numKeys; i++)
+		{
+			size_t curLen = strlen(keyStrings[i]);
+
+			if(strncmp(cur, keyStrings[i], curLen) == 0)
+			{
+				if(curLen > keyLen)
+				{
+					keyIdx = i;
+					keyLen = curLen;
+				}
+				keyFound = true;
+			}
+		}
+
+		if(keyFound)
+		{
+			cur += keyLen;
+
+			while(*cur == ' ') cur++;
+
+			if(*cur != '=')
+				start = NULL;
+			else
+			{
+				cur++;
+				while(*cur == ' ') cur++;
+				start = cur;
+			}
+		}
+
+		while(*cur != '\0')
+		{
+			if(isEOL(*cur))
+			{
+				cur++;
+				break;
+			}
+			cur++;
+		}
+
+		*curp = cur;
+
+		if(start)
+		{
+			*key = keyIdx;
+			return start;
+		}
+	}
+
+	return NULL;
+}
+
+static u32 refParseDefinition(char *attrData)
+{
+	u32 len = 0;
+
+	for(char *cur = attrData; *cur != '\0' && !isEOL(*cur); cur++) len++;
+
+	return len;
+}
+
+static void refParseConfigFile(void)
+{
+	AttributeEntryType *curAttr;
+	const FunctionsEntryType *keyFunc;
+	char *curp = filebuf;
+	char *text;
+	int i = 0;
+
+	memset(attributes, 0, sizeof attributes);
+
+	while((text = refFindNextDefinition(&curp, &i)) != NULL)
+	{
+		curAttr = &attributes[i];
+		if(curAttr->textData)
+			continue;
+		curAttr->textData = text;
+		curAttr->textLength = refParseDefinition(text);
+	}
+
+	for(i=0; i<numKeys; i++)
+	{
+		curAttr = &attributes[i];
+		if(!curAttr->textData)
+			continue;
+
+		keyFunc = getKeyFunctions(i);
+		if(keyFunc && keyFunc->parse)
+			keyFunc->parse(curAttr);
+		else curAttr->data = NULL;
+	}
+}
+
+// Copies the parse result out of attributes[] and frees the native data
+static void takeResults(KeyResult *res)
+{
+	memset(res, 0, sizeof(KeyResult) * numKeys);
+
+	for(int key = 0; key < numKeys; key++)
+	{
+		AttributeEntryType *const attr = &attributes[key];
+
+		res[key].textOffset = (attr->textData ? attr->textData - filebuf : -1);
+		res[key].textLength = attr->textLength;
+		res[key].dataSize = getKeyDataSize(key);
+		if(res[key].dataSize && res[key].dataSize <= sizeof(res[key].data))
+			memcpy(res[key].data, attr->data, res[key].dataSize);
+
+		free(attr->data);
+		attr->data = NULL;
+	}
+}
+
+static const char *const values[] =
+{
+	"sdmc:/luma.firm", "nand:/firm/boot.firm", "sdmc:/../x.firm", "sdmc:/ x",
+	"nopath", "A + B", "select+START + l", "UP DOWN x y", "",
+	"Normal", "quick", "Quiet", "Loud", "Enabled", "DISABLED", "maybe",
+	"123", "-7", "0x20", "  9 ", "= =", "BOOT_MODE = Quick"
+};
+
+static const char *const eols[] = {"\n", "\r", "\r\n", "\x15", "\n\r", "\r\r\n"};
+
+static u32 append(char *buf, u32 pos, const char *s)
+{
+	const u32 len = strlen(s);
+	if(pos + len > MAX_FILE_SIZE) return pos;
+	memcpy(buf + pos, s, len);
+	return pos + len;
+}
+
+static u32 appendSpaces(char *buf, u32 pos, u32 *seed)
+{
+	const u32 n = testRand(seed) % 4;
+	for(u32 i = 0; i < n; i++) pos = append(buf, pos, (testRand(seed) & 7) ? " " : "\t");
+	return pos;
+}
+
+// Random config file. Lines are mostly definitions of real keys
+static u32 makeConfig(char *buf, u32 maxLines, u32 *seed)
+{
+	const u32 lines = testRand(seed) % maxLines;
+	u32 pos = 0;
+
+	for(u32 l = 0; l < lines; l++)
+	{
+		const u32 kind = testRand(seed) % 16;
+
+		if(kind == 0)	// random bytes, never '\0'
+		{
+			const u32 n = testRand(seed) % 24;
+			for(u32 i = 0; i < n && pos < MAX_FILE_SIZE; i++)
+				buf[pos++] = 1 + testRand(seed) % 255;
+		}
+		else
+		{
+			char key[32];
+			strcpy(key, keyStrings[testRand(seed) % numKeys]);
+
+			switch(kind)
+			{
+				case 1:	// near miss: extra char
+					strcat(key, (testRand(seed) & 1) ? "X" : "_");
+					break;
+				case 2:	// near miss: cut short
+					key[1 + testRand(seed) % (strlen(key) - 1)] = '\0';
+					break;
+				case 3:	// near miss: lower case
+					key[testRand(seed) % strlen(key)] |= 0x20;
+					break;
+				case 4:	// indented
+					pos = appendSpaces(buf, pos, seed);
+					break;
+			}
+
+			pos = append(buf, pos, key);
+			pos = appendSpaces(buf, pos, seed);
+			if(testRand(seed) % 8) pos = append(buf, pos, "=");
+			pos = appendSpaces(buf, pos, seed);
+			pos = append(buf, pos, values[testRand(seed) % arrayEntries(values)]);
+		}
+
+		if(l + 1 < lines || (testRand(seed) & 1))
+			pos = append(buf, pos, eols[testRand(seed) % arrayEntries(eols)]);
+	}
+
+	buf[pos] = '\0';
+	return pos;
+}
+
+static bool compareParsers(u32 seed)
+{
+	static KeyResult newRes[numKeys], refRes[numKeys];
+
+	parseConfigFile();
+	takeResults(newRes);
+	refParseConfigFile();
+	takeResults(refRes);
+
+	for(int key = 0; key < numKeys; key++)
+	{
+		const KeyResult *const a = &newRes[key];
+		const KeyResult *const b = &refRes[key];
+
+		if(a->textOffset != b->textOffset || a->textLength != b->textLength
+		   || a->dataSize != b->dataSize || memcmp(a->data, b->data, a->dataSize) != 0)
+		{
+			fprintf(stderr, "key %s differs, seed %" PRIu32 ": offset %" PRId32 "/%" PRId32
+			        ", length %" PRIu32 "/%" PRIu32 ", data size %" PRIu32 "/%" PRIu32 "\n",
+			        keyStrings[key], seed, a->textOffset, b->textOffset, a->textLength,
+			        b->textLength, a->dataSize, b->dataSize);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void checkEquivalence(void)
+{
+	static const char *const files[] =
+	{
+		"",
+		"BOOT_MODE = Normal\r\n",
+		"BOOT_OPTION1 = sdmc:/luma.firm\nBOOT_OPTION1_BUTTONS = A + B\nBOOT_OPTION1 = sdmc:/other.firm\n",
+		"BOOT_OPTION1X = sdmc:/a.firm\nBOOT_OPTION1=sdmc:/b.firm",
+		"BOOT_OPTION1_BUTTONS\n= A\nDEV_MODE =Enabled\rRAM_FIRM_BOOT= Disabled\x15SPLASH_DURATION = 1500",
+		" BOOT_MODE = Quick\nBOOT_MODE\t= Quiet\nBOOT_MODE   =   Quick   \n",
+		"BOOT_OPTION9_PUBKEY = sdmc:/key.bin\r\n\r\nSPLASH_SCREEN = sdmc:/splash.bin\r\n"
+	};
+
+	for(u32 i = 0; i < arrayEntries(files); i++)
+	{
+		strcpy(filebuf, files[i]);
+		TEST_CHECK(compareParsers(i));
+	}
+
+	u32 seed = 0x1234567u;
+	for(u32 i = 0; i < FUZZ_FILES; i++)
+	{
+		const u32 fileSeed = seed;
+		makeConfig(filebuf, 64, &seed);
+		if(!TEST_CHECK(compareParsers(fileSeed))) break;
+
+		// The error position must point into the file
+		u32 line, column;
+		if(configGetParseError(&line, &column))
+		{
+			u32 lines = 1;
+			for(const char *c = filebuf; *c; c++) lines += (*c == '\n' || *c == '\r' || *c == 0x15);
+			TEST_CHECK(line >= 1 && line <= lines && column >= 1);
+		}
+	}
+
+	// Whole file of random bytes, only run through the new parser
+	for(u32 i = 0; i < FUZZ_FILES / 10; i++)
+	{
+		const u32 size = testRand(&seed) % (MAX_FILE_SIZE + 1);
+		for(u32 j = 0; j < size; j++) filebuf[j] = 1 + testRand(&seed) % 255;
+		filebuf[size] = '\0';
+
+		parseConfigFile();
+		KeyResult res[numKeys];
+		takeResults(res);
+	}
+}
+
+// Replaces the text file like an edit on a PC would
+static void editConfig(const char *text, u16 ftime)
+{
+	TestFile *const f = &testFiles[0];
+	f->exists = true;
+	f->size = strlen(text);
+	memcpy(f->data, text, f->size);
+	f->ftime = ftime;
+	f->reads = 0;
+	testFiles[1].reads = 0;
+}
+
+static void checkSnapshot(void)
+{
+	static KeyResult parsed[numKeys], loaded[numKeys];
+	u32 line, column, snapLine, snapColumn;
+
+	// First boot parses the text and writes the snapshot
+	editConfig("BOOT_OPTION1 = sdmc:/luma.firm\r\nBOOT_OPTION1_BUTTONS = L + A\r\n"
+	           "NOT_A_KEY = 12345\r\nSPLASH_DURATION = 1500\r\n", 0x1234);
+	testFiles[1].exists = false;
+	TEST_CHECK(loadConfigFile());
+	TEST_CHECK(testFiles[0].reads == 1 && testFiles[1].exists);
+	const char *const msg = configGetParseError(&line, &column);
+	TEST_CHECK(msg && strcmp(msg, "Unknown key") == 0 && line == 3 && column == 1);
+	takeResults(parsed);
+
+	// Later boots only read the snapshot and still report the error
+	testFiles[0].reads = testFiles[1].reads = 0;
+	TEST_CHECK(loadConfigFile());
+	TEST_CHECK(testFiles[0].reads == 0 && testFiles[1].reads == 1);
+	TEST_CHECK(configGetParseError(&snapLine, &snapColumn) == msg && snapLine == line && snapColumn == column);
+	takeResults(loaded);
+	TEST_CHECK(memcmp(parsed, loaded, sizeof(parsed)) == 0);
+
+	// Same size edit with a new time is parsed and snapshotted again
+	editConfig("BOOT_OPTION1 = sdmc:/lumb.firm\r\nBOOT_OPTION1_BUTTONS = L + A\r\n"
+	           "BOOT_MODE = Quick\r\nSPLASH_DURATION = 1500\r\n", 0x1236);
+	TEST_CHECK(loadConfigFile());
+	TEST_CHECK(testFiles[0].reads == 1 && !configGetParseError(NULL, NULL));
+	TEST_CHECK(strcmp((const char*)configGetData(KBootOption1), "sdmc:/lumb.firm") == 0);
+	takeResults(parsed);
+
+	testFiles[0].reads = testFiles[1].reads = 0;
+	TEST_CHECK(loadConfigFile());
+	TEST_CHECK(testFiles[0].reads == 0 && !configGetParseError(NULL, NULL));
+	takeResults(loaded);
+	TEST_CHECK(memcmp(parsed, loaded, sizeof(parsed)) == 0);
+
+	// A damaged snapshot falls back to the text
+	testFiles[1].data[testFiles[1].size - 1] ^= 1;
+	testFiles[0].reads = testFiles[1].reads = 0;
+	TEST_CHECK(loadConfigFile());
+	TEST_CHECK(testFiles[0].reads == 1);
+	takeResults(loaded);
+	TEST_CHECK(memcmp(parsed, loaded, sizeof(parsed)) == 0);
+}
+
+#ifdef CONFIG_BENCH
+static void bench(const char *name)
+{
+	static KeyResult res[numKeys];
+
+	u64 start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		parseConfigFile();
+		takeResults(res);
+	}
+	const u64 newNs = testNowNs() - start;
+
+	start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		refParseConfigFile();
+		takeResults(res);
+	}
+	const u64 refNs = testNowNs() - start;
+
+	printf("%-24s %5zu bytes  two pass %8.2f us  one pass %8.2f us\n", name, strlen(filebuf),
+	       (double)refNs / BENCH_ITERS / 1000, (double)newNs / BENCH_ITERS / 1000);
+}
+#endif
+
+int main(void)
+{
+	filebuf = malloc(MAX_FILE_SIZE + 1);
+	if(!filebuf) return 1;
+
+	checkEquivalence();
+	checkSnapshot();
+
+#ifdef CONFIG_BENCH
+	// Typical file: all boot options set
+	char *pos = filebuf;
+	*pos = '\0';
+	for(u32 i = 1; i <= 9; i++)
+	{
+		pos += sprintf(pos, "BOOT_OPTION%" PRIu32 " = sdmc:/firm%" PRIu32 ".firm\r\n", i, i);
+		pos += sprintf(pos, "BOOT_OPTION%" PRIu32 "_BUTTONS = L + R + A\r\n", i);
+	}
+	strcpy(pos, "BOOT_MODE = Quick\r\nDEV_MODE = Disabled\r\nSPLASH_DURATION = 2000\r\n");
+	bench("typical");
+
+	// Largest allowed file, every key defined many times over
+	u32 seed = 0xC0FFEEu;
+	u32 size = 0;
+	while(size < MAX_FILE_SIZE - 64)
+	{
+		const int key = testRand(&seed) % numKeys;
+		size = append(filebuf, size, keyStrings[key]);
+		size = append(filebuf, size, " = Enabled\r\n");
+	}
+	filebuf[size] = '\0';
+	bench("maximum size");
+#endif
+
+	free(filebuf);
+	filebuf = NULL;
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,209 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Console glyph path benchmark. Fills the top screen with text through
+ * consolePrintChar()/consoleFlush() and checks the render buffer against
+ * the original per-pixel renderer for every glyph and attribute combination.
+ * Full screen clears go through the PSC fill path, emulated with a CPU fill.
+ * Then times a full screen of changed text, an unchanged reprint (skipped
+ * by the retained cell grid) and the original renderer for comparison.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "util.h"
+#include "hardware/gfx.h"
+#include "arm11/console.h"
+#include "test.h"
+
+
+#define COLS   (SCREEN_WIDTH_TOP / 6)
+#define ROWS   (SCREEN_HEIGHT_TOP / 10)
+#define ITERS  (2000)
+
+
+u16 testRenderbufTop[SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP];
+u16 testRenderbufSub[SCREEN_WIDTH_SUB * SCREEN_HEIGHT_SUB];
+void consolePrintChar(int c);
+
+static u16 refBuf[SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP];
+
+static const int attrFlags[] =
+{
+	0,
+	CONSOLE_COLOR_BOLD,
+	CONSOLE_COLOR_FAINT,
+	CONSOLE_COLOR_REVERSE,
+	CONSOLE_UNDERLINE,
+	CONSOLE_CROSSED_OUT,
+	CONSOLE_COLOR_BOLD | CONSOLE_UNDERLINE | CONSOLE_CROSSED_OUT,
+	CONSOLE_COLOR_FAINT | CONSOLE_COLOR_REVERSE | CONSOLE_UNDERLINE
+};
+
+
+
+static u32 fillCount;
+
+
+
+void GFX_markRenderbufDirty(UNUSED u8 screen, UNUSED s32 x, UNUSED s32 width)
+{
+}
+
+bool GFX_fillRenderbuf(u8 screen, u32 offset, u32 size, u16 color)
+{
+	if((offset | size) & 7u) return false;
+
+	u16 *const buf = (screen ? testRenderbufTop : testRenderbufSub);
+	for(u32 i = 0; i < size / 2; i++) buf[offset / 2 + i] = color;
+	fillCount++;
+
+	return true;
+}
+
+// Characters consolePrintChar() doesn't draw are replaced
+static int glyphAt(u32 i, u32 seed)
+{
+	const int c = (int)((i * 7 + seed) & 0xFFu);
+	if(c == 0 || c == 8 || c == 9 || c == 10 || c == 13) return '?';
+
+	return c;
+}
+
+// The per-pixel renderer the console used before the column mask rewrite
+static void refDrawChar(const PrintConsole *con, int c, int cx, int cy)
+{
+	const u8 *fontdata = con->font.gfx + (10 * c);
+
+	int writingColor = con->fg;
+	int screenColor = con->bg;
+	if(con->flags & CONSOLE_COLOR_BOLD) writingColor += 8;
+	else if(con->flags & CONSOLE_COLOR_FAINT) writingColor += 16;
+	if(con->flags & CONSOLE_COLOR_REVERSE)
+	{
+		const int tmp = writingColor;
+		writingColor = screenColor;
+		screenColor = tmp;
+	}
+	const u16 bg = consoleGetRGB565Color(screenColor);
+	const u16 fg = consoleGetRGB565Color(writingColor);
+
+	u8 b[10];
+	memcpy(b, fontdata, 10);
+	if(con->flags & CONSOLE_UNDERLINE) b[9] = 0xFF;
+	if(con->flags & CONSOLE_CROSSED_OUT) b[4] = 0xFF;
+
+	const int x = (cx + con->windowX) * 6;
+	const int y = (cy + con->windowY) * 10;
+	u16 *screen = &refBuf[(x * 240) + (239 - (y + 9))];
+
+	u8 mask = 0x80;
+	for(int i = 0; i < 6; i++)
+	{
+		for(int row = 9; row >= 0; row--) *screen++ = (b[row] & mask ? fg : bg);
+		mask >>= 1;
+		screen += 240 - 10;
+	}
+}
+
+static void refDrawScreen(const PrintConsole *con, u32 seed)
+{
+	for(u32 i = 0; i < COLS * ROWS; i++) refDrawChar(con, glyphAt(i, seed), i % COLS, i / COLS);
+}
+
+static void printScreen(PrintConsole *con, u32 seed)
+{
+	consoleSetCursor(con, 0, 0);
+	for(u32 i = 0; i < COLS * ROWS; i++) consolePrintChar(glyphAt(i, seed));
+	consoleFlush();
+}
+
+static void clearScreen(void)
+{
+	con_write(NULL, NULL, "\x1b[2J", 4);
+	consoleFlush();
+}
+
+static void checkEquivalence(PrintConsole *con)
+{
+	for(u32 a = 0; a < (u32)arrayEntries(attrFlags); a++)
+	{
+		for(u32 seed = 0; seed < 8; seed++)
+		{
+			con->flags = attrFlags[a];
+			con->fg = (seed + a) % 8;
+			con->bg = (seed + 3) % 8;
+
+			printScreen(con, seed);
+			refDrawScreen(con, seed);
+			if(!TEST_CHECK(memcmp(testRenderbufTop, refBuf, sizeof(refBuf)) == 0))
+			{
+				fprintf(stderr, "mismatch with flags 0x%X, seed %" PRIu32 "\n", attrFlags[a], seed);
+				return;
+			}
+
+			clearScreen();
+			for(u32 i = 0; i < COLS * ROWS; i++) refDrawChar(con, ' ', i % COLS, i / COLS);
+			if(!TEST_CHECK(memcmp(testRenderbufTop, refBuf, sizeof(refBuf)) == 0))
+			{
+				fprintf(stderr, "clear mismatch with flags 0x%X, seed %" PRIu32 "\n", attrFlags[a], seed);
+				return;
+			}
+		}
+	}
+
+	// Clears without underline or crossed out must take the fill path
+	TEST_CHECK(fillCount > 0);
+}
+
+static void report(const char *name, u64 ns)
+{
+	const double perScreen = (double)ns / ITERS;
+	printf("%-28s %9.1f us/screen %7.2f ns/glyph\n", name, perScreen / 1000, perScreen / (COLS * ROWS));
+}
+
+int main(void)
+{
+	PrintConsole con;
+	consoleInit(SCREEN_TOP, &con, false);
+
+	checkEquivalence(&con);
+
+	con.flags = 0;
+	con.fg = 7;
+	con.bg = 0;
+
+	u64 start = testNowNs();
+	for(u32 i = 0; i < ITERS; i++) refDrawScreen(&con, i);
+	report("original renderer", testNowNs() - start);
+
+	start = testNowNs();
+	for(u32 i = 0; i < ITERS; i++) printScreen(&con, i);
+	report("cells, all changed", testNowNs() - start);
+
+	start = testNowNs();
+	for(u32 i = 0; i < ITERS; i++) printScreen(&con, 0);
+	report("cells, unchanged reprint", testNowNs() - start);
+
+	// Keeps the compiler from dropping the reference stores
+	volatile u16 sink = refBuf[123];
+	(void)sink;
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,206 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Known answer tests for the software crypto backend (crypto_soft.c).
+ * AES vectors are from FIPS-197 and SP 800-38A, SHA vectors from FIPS 180-2.
+ * The RSA vector is a PKCS#1 v1.5 SHA-256 signature made with OpenSSL.
+ * AES_ccm() is not emulated by the backend so there is no test for it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "arm9/hardware/crypto.h"
+#include "test.h"
+
+
+#define AES_PARAMS_MEM  (AES_INPUT_BIG | AES_INPUT_NORMAL) // Plain memory byte order
+
+
+
+static bool checkBytes(const void *got, const char *expectHex)
+{
+	u8 expect[0x100];
+	const size_t len = strlen(expectHex) / 2;
+	testHex(expect, expectHex);
+
+	return memcmp(got, expect, len) == 0;
+}
+
+static void testAesEcb(void)
+{
+	alignas(4) u8 key[16], pt[16], buf[16];
+	testHex(key, "000102030405060708090a0b0c0d0e0f");
+	testHex(pt, "00112233445566778899aabbccddeeff");
+
+	AES_ctx ctx;
+	AES_setKey(0x11, AES_KEY_NORMAL, AES_PARAMS_MEM, false, (u32*)key);
+	AES_selectKeyslot(0x11);
+	AES_setCryptParams(&ctx, AES_PARAMS_MEM, AES_PARAMS_MEM);
+
+	AES_ecb(&ctx, (u32*)pt, (u32*)buf, 1, true, false);
+	TEST_CHECK(checkBytes(buf, "69c4e0d86a7b0430d8cdb78070b4c55a"));
+
+	AES_ecb(&ctx, (u32*)buf, (u32*)buf, 1, false, false);
+	TEST_CHECK(memcmp(buf, pt, 16) == 0);
+}
+
+static void testAesCtr(void)
+{
+	alignas(4) u8 key[16], iv[16], pt[32], buf[32];
+	testHex(key, "2b7e151628aed2a6abf7158809cf4f3c");
+	testHex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+	testHex(pt, "6bc1bee22e409f96e93d7e117393172a"
+	            "ae2d8a571e03ac9c9eb76fac45af8e51");
+
+	AES_ctx ctx;
+	AES_setKey(0x11, AES_KEY_NORMAL, AES_PARAMS_MEM, false, (u32*)key);
+	AES_selectKeyslot(0x11);
+	AES_setCryptParams(&ctx, AES_PARAMS_MEM, AES_PARAMS_MEM);
+	AES_setCtrIv(&ctx, AES_PARAMS_MEM, (u32*)iv);
+
+	AES_ctr(&ctx, (u32*)pt, (u32*)buf, 2, false);
+	TEST_CHECK(checkBytes(buf, "874d6191b620e3261bef6864990db6ce"
+	                           "9806f66b7970fdff8617187bb9fffdff"));
+
+	// Decrypting is the same operation with the counter reset
+	AES_setCtrIv(&ctx, AES_PARAMS_MEM, (u32*)iv);
+	AES_ctr(&ctx, (u32*)buf, (u32*)buf, 2, false);
+	TEST_CHECK(memcmp(buf, pt, 32) == 0);
+}
+
+static void testSha(void)
+{
+	alignas(4) static const char abc[4] = "abc";
+	u32 hash[8];
+
+	sha((const u32*)abc, 3, hash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+	TEST_CHECK(checkBytes(hash, "ba7816bf8f01cfea414140de5dae2223"
+	                            "b00361a396177a9cb410ff61f20015ad"));
+
+	sha((const u32*)abc, 3, hash, SHA_INPUT_BIG | SHA_MODE_224, SHA_OUTPUT_BIG);
+	TEST_CHECK(checkBytes(hash, "23097d223405d8228642a477bda255b3"
+	                            "2aadbce4bda0b3f7e36c9da7"));
+
+	sha((const u32*)abc, 3, hash, SHA_INPUT_BIG | SHA_MODE_1, SHA_OUTPUT_BIG);
+	TEST_CHECK(checkBytes(hash, "a9993e364706816aba3e25717850c26c9cd0d89d"));
+
+	// One million 'a' fed in uneven chunks to cover the block buffering
+	u32 *const million = malloc(1000000);
+	memset(million, 'a', 1000000);
+	SHA_start(SHA_INPUT_BIG | SHA_MODE_256);
+	SHA_update(million, 4);
+	SHA_update(million + 1, 60);
+	SHA_update(million + 16, 1000000 - 64);
+	SHA_finish(hash, SHA_OUTPUT_BIG);
+	free(million);
+	TEST_CHECK(checkBytes(hash, "cdc76e5c9914fb9281a1c7e284d73e67"
+	                            "f1809a48a497200e046d39ccc7112cd0"));
+}
+
+alignas(4) static const u8 rsaMod[0x100] =
+{
+	0xD8, 0x63, 0xDD, 0xDC, 0x0E, 0x58, 0x1D, 0x15, 0x5F, 0x83, 0xF3, 0x11, 0x75, 0x46, 0x57, 0x29,
+	0xD5, 0x1D, 0x1B, 0x5F, 0x92, 0x6F, 0x99, 0xB5, 0xE3, 0x64, 0xA4, 0x34, 0x1D, 0x95, 0x63, 0x62,
+	0x2E, 0x71, 0xE8, 0x6C, 0xDF, 0x26, 0x7B, 0x2E, 0x86, 0xB7, 0x70, 0x4F, 0x8F, 0xE2, 0xD3, 0x2E,
+	0x91, 0x2E, 0x5B, 0x04, 0x45, 0xF3, 0xB9, 0x9E, 0xE0, 0x14, 0xEE, 0x4B, 0x1D, 0x5B, 0x88, 0xF0,
+	0xC4, 0xAC, 0xB7, 0xCC, 0x8E, 0xA2, 0x0F, 0x19, 0x31, 0x0B, 0x21, 0x7D, 0xE8, 0xCE, 0x29, 0x58,
+	0xFE, 0x20, 0x36, 0x8B, 0x4B, 0x30, 0x81, 0x66, 0xC4, 0x3F, 0x53, 0x71, 0xFF, 0x51, 0x7A, 0xEF,
+	0x02, 0xF0, 0xEE, 0xD7, 0x3B, 0x31, 0x24, 0x72, 0x95, 0xEF, 0xAA, 0x70, 0x55, 0xD5, 0xF5, 0x5A,
+	0x18, 0xC3, 0x8D, 0x71, 0xBC, 0xF4, 0x93, 0xDD, 0xBA, 0x0C, 0x34, 0x89, 0xD8, 0x68, 0xC2, 0x51,
+	0x08, 0xC2, 0x4D, 0x99, 0x4F, 0x03, 0x81, 0x08, 0xE3, 0xB8, 0x61, 0xFA, 0xBA, 0x0E, 0xF7, 0x40,
+	0x5A, 0xC2, 0x3E, 0x48, 0x47, 0xE3, 0xAD, 0x17, 0xE1, 0x6F, 0x93, 0x8E, 0x68, 0x43, 0x92, 0x64,
+	0x5A, 0x01, 0x48, 0x13, 0x45, 0xAA, 0x4F, 0x86, 0x77, 0x70, 0xFF, 0x17, 0x23, 0xE3, 0x91, 0xAE,
+	0xC8, 0xA2, 0xF6, 0xA1, 0x7E, 0x31, 0x0E, 0x3F, 0x87, 0xF3, 0xD6, 0x81, 0x41, 0xCD, 0x4E, 0xF7,
+	0xEB, 0x21, 0x80, 0x5E, 0x18, 0x19, 0x57, 0x12, 0x15, 0xF1, 0xC7, 0xB0, 0xBA, 0xCF, 0xAB, 0xEA,
+	0x35, 0xCA, 0x07, 0xFD, 0x5D, 0xB3, 0x05, 0xFE, 0x97, 0x65, 0x22, 0x7A, 0x12, 0x0A, 0xC1, 0x72,
+	0xFB, 0x64, 0x36, 0x6F, 0x2B, 0x5E, 0x44, 0xC7, 0x28, 0xD4, 0x57, 0x65, 0xE0, 0x65, 0x98, 0xA6,
+	0x14, 0xE6, 0xCC, 0x85, 0x79, 0x5C, 0x2C, 0xC8, 0x5D, 0x77, 0x8F, 0xBF, 0x40, 0x82, 0xFA, 0x2D
+};
+
+alignas(4) static const u8 rsaSig[0x100] =
+{
+	0xAA, 0x80, 0xE7, 0xA7, 0xB8, 0xF0, 0x3F, 0xB4, 0x29, 0xBF, 0x6C, 0x02, 0xBA, 0xDA, 0xE8, 0x12,
+	0xF2, 0x84, 0x53, 0x1F, 0x06, 0x5C, 0xB4, 0x61, 0xC2, 0xF0, 0xF3, 0xEF, 0xE7, 0xCF, 0x8B, 0x62,
+	0x0B, 0x5E, 0xDE, 0xE0, 0xAE, 0xCD, 0x04, 0x82, 0xE9, 0x89, 0x4D, 0x26, 0x45, 0xA7, 0x94, 0x90,
+	0x2E, 0xC5, 0x0F, 0xE4, 0x3A, 0x9A, 0xD2, 0x30, 0x1B, 0x5A, 0x32, 0x8A, 0x08, 0x2D, 0x37, 0x23,
+	0x4B, 0xD6, 0x4F, 0x9B, 0x73, 0xCE, 0x6F, 0x5F, 0x62, 0x3C, 0x58, 0xEF, 0xD3, 0x4C, 0xDB, 0xF1,
+	0x00, 0x05, 0x9B, 0xEA, 0x39, 0xE2, 0x13, 0x90, 0xBB, 0x34, 0x7C, 0x8B, 0x37, 0xBD, 0x27, 0x2B,
+	0xE2, 0x0E, 0x7E, 0xB6, 0xEB, 0x58, 0x82, 0x34, 0x7F, 0xDD, 0x3F, 0xD0, 0xC2, 0xB6, 0x46, 0xAA,
+	0xA9, 0x69, 0x57, 0x44, 0xF2, 0xCB, 0xFE, 0x4E, 0x6E, 0x33, 0x38, 0x55, 0x37, 0xD7, 0xE4, 0x63,
+	0x09, 0x3C, 0xD2, 0x22, 0xCE, 0x93, 0xF2, 0xFF, 0x49, 0x79, 0xAC, 0x10, 0x06, 0x72, 0x11, 0x10,
+	0x5D, 0x09, 0xC8, 0x13, 0xEA, 0x9D, 0xF2, 0x59, 0xBE, 0x55, 0x2A, 0x66, 0x2B, 0x03, 0xC9, 0xB6,
+	0x6C, 0xF7, 0x62, 0x2B, 0xBE, 0xE3, 0x21, 0x5F, 0x35, 0xC6, 0x5D, 0xE3, 0xB8, 0x04, 0x2B, 0xA3,
+	0xE3, 0x4F, 0xFA, 0xB8, 0xD9, 0xD9, 0x25, 0x75, 0xDE, 0x56, 0xE1, 0xD6, 0x55, 0x30, 0x12, 0x7F,
+	0x5E, 0xCC, 0x37, 0x1F, 0x78, 0x28, 0x01, 0xE1, 0xD1, 0xF1, 0xF6, 0xB4, 0xFF, 0xF3, 0x0C, 0x4D,
+	0x47, 0x80, 0x2B, 0x60, 0xA4, 0xE0, 0x4C, 0x16, 0x3C, 0x9C, 0x56, 0x3E, 0x5B, 0x68, 0x25, 0xB0,
+	0x87, 0xCE, 0xBD, 0x16, 0x78, 0x97, 0x29, 0xEB, 0xC6, 0xF2, 0x43, 0x66, 0x8C, 0xFA, 0xAF, 0x6C,
+	0xF0, 0x4A, 0x80, 0xF0, 0xDE, 0x1D, 0x50, 0x9B, 0xC3, 0xF9, 0x9E, 0xCA, 0x22, 0x46, 0x48, 0x5C
+};
+
+alignas(4) static const char rsaMsg[] = "fastboot3DS RSA known answer test";
+
+static void testRsa(void)
+{
+	const u32 msgSize = sizeof(rsaMsg) - 1;
+
+	TEST_CHECK(RSA_setKey2048(0, (const u32*)rsaMod, 0x01000100));
+
+	// Raw decryption must yield the PKCS#1 v1.5 padded SHA-256 DigestInfo
+	alignas(4) u8 dec[0x100];
+	u32 hash[8];
+	TEST_CHECK(RSA_decrypt2048((u32*)dec, (const u32*)rsaSig));
+	sha((const u32*)rsaMsg, msgSize, hash, SHA_INPUT_BIG | SHA_MODE_256, SHA_OUTPUT_BIG);
+	TEST_CHECK(dec[0] == 0x00 && dec[1] == 0x01 && dec[0xCB] == 0xFF && dec[0xCC] == 0x00);
+	TEST_CHECK(memcmp(&dec[0xE0], hash, 32) == 0);
+	TEST_CHECK(RSA_checkSigHash2048((u32*)dec, hash));
+
+	TEST_CHECK(RSA_verify2048((const u32*)rsaSig, (const u32*)rsaMsg, msgSize));
+
+	// A single flipped bit in the signature or the message must fail
+	alignas(4) u8 badSig[0x100];
+	memcpy(badSig, rsaSig, 0x100);
+	badSig[0x80] ^= 0x10;
+	TEST_CHECK(!RSA_verify2048((const u32*)badSig, (const u32*)rsaMsg, msgSize));
+
+	alignas(4) char badMsg[sizeof(rsaMsg)];
+	memcpy(badMsg, rsaMsg, sizeof(rsaMsg));
+	badMsg[3] ^= 1;
+	TEST_CHECK(!RSA_verify2048((const u32*)rsaSig, (const u32*)badMsg, msgSize));
+
+	// Even moduli are rejected like unset keyslots
+	alignas(4) u8 evenMod[0x100];
+	memcpy(evenMod, rsaMod, 0x100);
+	evenMod[0xFF] &= ~1u;
+	TEST_CHECK(!RSA_setKey2048(1, (const u32*)evenMod, 0x01000100));
+	TEST_CHECK(!RSA_decrypt2048((u32*)dec, (const u32*)rsaSig));
+}
+
+int main(void)
+{
+	AES_init();
+	RSA_init();
+
+	testAesEcb();
+	testAesCtr();
+	testSha();
+	testRsa();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,278 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks sortDirBuffer() against a strcasecmp() based qsort reference on
+ * random listings of 0 to 10k entries, sorted in one go and streamed in
+ * chunks like streamDirListing() does. Names mix cases, repeat with only
+ * the case changed and share long prefixes so stability and the case
+ * folded keys are both exercised. Built with AddressSanitizer as a test
+ * and without it, with DIRSORT_BENCH, as a benchmark against the original
+ * selection sort for 1k to 10k entries.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "types.h"
+#include "../source/arm11/menu/menu_fsel.c"
+#include "test.h"
+
+
+#define READ_CHUNK  (30) // entries per DIR_READ_BUF_SIZE read
+
+
+typedef struct {
+	u32 fsize;  // original position, to check stability
+	u8 is_dir;
+	u32 fnameOffset;  // the name arena moves while entries are added
+	const char *fname;
+} RefEntry;
+
+
+
+// Only sortDirBuffer() and the listing helpers run here
+void GFX_waitForEvent(UNUSED GfxEvent event, UNUSED bool discard) {}
+bool configDevModeEnabled() { return false; }
+void consoleClear(void) {}
+PrintConsole *consoleSelect(PrintConsole* console) { return console; }
+void consoleSetCursor(UNUSED PrintConsole* console, UNUSED int x, UNUSED int y) {}
+u32 ee_printf(UNUSED const char *const fmt, ...) { return 0; }
+s32 fOpenDir(UNUSED const char *const path) { return -1; }
+s32 fReadDirPacked(UNUSED s32 handle, UNUSED u32 offset, UNUSED u32 flags, UNUSED const char *const pattern,
+                   UNUSED void *const buf, UNUSED u32 bufSize) { return -1; }
+s32 fCloseDir(UNUSED s32 handle) { return -1; }
+s32 fStat(UNUSED const char *const path, UNUSED FsFileInfo *fi) { return -1; }
+u32 fGetGeneration(void) { return 0; }
+bool fsEnsureMounted(UNUSED const char *path) { return false; }
+void formatBytes(char* str, UNUSED u64 bytes) { *str = '\0'; }
+void truncateString(char* dest, UNUSED const char* orig, UNUSED int nsize, UNUSED int tpos) { *dest = '\0'; }
+u32 hidKeysDown(void) { return 0; }
+u32 hidKeysHeld(void) { return 0; }
+u32 hidGetExtraKeys(UNUSED u32 clearMask) { return 0; }
+void hidScanInput(void) {}
+void sleepmode(void) {}
+void updateScreens(void) {}
+noreturn void panicMsg(UNUSED const char *msg) { abort(); }
+
+int strnicmp(const char *str1, const char *str2, u32 len)
+{
+	return strncasecmp(str1, str2, len);
+}
+
+static int compareRef(const void *a, const void *b)
+{
+	const RefEntry *const ea = (const RefEntry*)a;
+	const RefEntry *const eb = (const RefEntry*)b;
+
+	if(!ea->is_dir != !eb->is_dir) return (ea->is_dir ? -1 : 1);
+	const int res = strcasecmp(ea->fname, eb->fname);
+	if(res) return res;
+
+	return (ea->fsize < eb->fsize ? -1 : 1);
+}
+
+// Random name. Few letters so equal keys and long shared prefixes are common
+static void makeName(char *name, u32 *seed)
+{
+	static const char chars[] = "aAbBcC_.~[0129 ";
+	const u32 len = 1 + testRand(seed) % 24;
+
+	for(u32 i = 0; i < len; i++) name[i] = chars[testRand(seed) % (sizeof(chars) - 1)];
+	name[len] = '\0';
+}
+
+static void makeListing(DirListing *dl, RefEntry *ref, u32 n, u32 chunk, u32 *seed)
+{
+	char name[FF_MAX_LFN + 1];
+
+	memset(dl, 0, sizeof(DirListing));
+	for(u32 i = 0; i < n; i++)
+	{
+		// Sometimes repeat an earlier name with the case of one char flipped
+		if(i && (testRand(seed) & 3) == 0)
+		{
+			strcpy(name, &dl->names[ref[testRand(seed) % i].fnameOffset]);
+			char *const c = &name[testRand(seed) % strlen(name)];
+			if(isalpha((unsigned char)*c)) *c ^= 0x20;
+		}
+		else makeName(name, seed);
+
+		const u8 is_dir = ((testRand(seed) & 3) == 0 ? AM_DIR : 0);
+		if(!addDirEntry(dl, i, is_dir, name)) abort();
+		ref[i].fsize = i;
+		ref[i].is_dir = is_dir;
+		ref[i].fnameOffset = dl->entries[i].fname;
+
+		if(chunk && ((i + 1) % chunk == 0 || i + 1 == n))
+			sortDirBuffer(dl, i + 1 - ((i % chunk) + 1));
+	}
+	if(!chunk) sortDirBuffer(dl, 0);
+
+	for(u32 i = 0; i < n; i++) ref[i].fname = &dl->names[ref[i].fnameOffset];
+
+	qsort(ref, n, sizeof(RefEntry), compareRef);
+}
+
+static bool checkListing(const DirListing *dl, const RefEntry *ref, u32 n)
+{
+	if((u32)dl->n_entries != n) return false;
+
+	for(u32 i = 0; i < n; i++)
+	{
+		const DirBufferEntry *const e = &dl->entries[i];
+		if(e->fsize != ref[i].fsize || e->is_dir != ref[i].is_dir ||
+		   strcmp(entryName(dl, e), ref[i].fname) != 0)
+		{
+			fprintf(stderr, "entry %" PRIu32 " of %" PRIu32 ": \"%s\" (#%" PRIu32 "), expected \"%s\" (#%" PRIu32 ")\n",
+			        i, n, entryName(dl, e), e->fsize, ref[i].fname, ref[i].fsize);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void checkSort(void)
+{
+	static const u32 sizes[] = {0, 1, 2, 3, 29, 30, 31, 64, 65, 1000, 1024, 4096, 10000};
+	static const u32 chunks[] = {0, 1, READ_CHUNK, 100};
+	RefEntry *const ref = (RefEntry*)malloc(10000 * sizeof(RefEntry));
+	DirListing dl;
+	u32 seed = 0x600D5EEDu;
+
+	for(u32 s = 0; s < arrayEntries(sizes); s++)
+	{
+		for(u32 c = 0; c < arrayEntries(chunks); c++)
+		{
+			// Streaming one by one is quadratic, keep that small
+			if(chunks[c] == 1 && sizes[s] > 1024) continue;
+
+			makeListing(&dl, ref, sizes[s], chunks[c], &seed);
+			if(!TEST_CHECK(checkListing(&dl, ref, sizes[s])))
+				fprintf(stderr, "size %" PRIu32 ", chunk %" PRIu32 "\n", sizes[s], chunks[c]);
+			freeDirListing(&dl);
+		}
+	}
+
+	free(ref);
+}
+
+#ifdef DIRSORT_BENCH
+// The original selection sort, on the original entries with separate names
+typedef struct {
+	u32 fsize;
+	u8  is_dir;
+	char* fname;
+} OldDirBufferEntry;
+
+static void oldSortDirBuffer(OldDirBufferEntry* dir_buffer, s32 n_entries)
+{
+	for(s32 s = 0; s < n_entries; s++)
+	{
+		OldDirBufferEntry* cmp0 = &(dir_buffer[s]);
+		OldDirBufferEntry* min0 = cmp0;
+
+		for(s32 c = s + 1; c < n_entries; c++)
+		{
+			OldDirBufferEntry* cmp1 = &(dir_buffer[c]);
+			if(min0->is_dir != cmp1->is_dir)
+			{
+				if (cmp1->is_dir)
+					min0 = cmp1;
+				continue;
+			}
+			if(strnicmp(min0->fname, cmp1->fname, FF_MAX_LFN + 1) > 0)
+			{
+				min0 = cmp1;
+			}
+		}
+
+		if(min0 != cmp0)
+		{
+			OldDirBufferEntry swap;
+			memcpy(&swap, cmp0, sizeof(OldDirBufferEntry));
+			memcpy(cmp0, min0, sizeof(OldDirBufferEntry));
+			memcpy(min0, &swap, sizeof(OldDirBufferEntry));
+		}
+	}
+}
+
+static void bench(u32 n)
+{
+	RefEntry *const ref = (RefEntry*)malloc(n * sizeof(RefEntry));
+	OldDirBufferEntry *const old = (OldDirBufferEntry*)malloc(n * sizeof(OldDirBufferEntry));
+	DirListing dl;
+	u32 seed = 0xBE7C4u;
+
+	// Same names for all three, in read order
+	makeListing(&dl, ref, n, 0, &seed);
+	for(u32 i = 0; i < n; i++)
+	{
+		const DirBufferEntry *const e = &dl.entries[i];
+		old[e->fsize].fsize = e->fsize;
+		old[e->fsize].is_dir = e->is_dir;
+		old[e->fsize].fname = (char*)entryName(&dl, e);
+	}
+
+	u64 start = testNowNs();
+	oldSortDirBuffer(old, n);
+	const u64 oldNs = testNowNs() - start;
+
+	// Back to read order, then sorted in one go
+	DirBufferEntry *const entries = (DirBufferEntry*)malloc(n * sizeof(DirBufferEntry));
+	for(u32 i = 0; i < n; i++) entries[dl.entries[i].fsize] = dl.entries[i];
+	memcpy(dl.entries, entries, n * sizeof(DirBufferEntry));
+	start = testNowNs();
+	sortDirBuffer(&dl, 0);
+	const u64 newNs = testNowNs() - start;
+
+	// And streamed in like streamDirListing() does
+	memcpy(dl.entries, entries, n * sizeof(DirBufferEntry));
+	start = testNowNs();
+	for(u32 done = 0; done < n; )
+	{
+		const u32 next = min(done + READ_CHUNK, n);
+		dl.n_entries = next;
+		sortDirBuffer(&dl, done);
+		done = next;
+	}
+	const u64 streamNs = testNowNs() - start;
+	TEST_CHECK(checkListing(&dl, ref, n));
+
+	printf("%5" PRIu32 " entries  selection %9.1f us  merge %7.1f us  merge streamed %7.1f us\n",
+	       n, (double)oldNs / 1000, (double)newNs / 1000, (double)streamNs / 1000);
+
+	free(entries);
+	freeDirListing(&dl);
+	free(old);
+	free(ref);
+}
+#endif
+
+int main(void)
+{
+	checkSort();
+
+#ifdef DIRSORT_BENCH
+	static const u32 sizes[] = {1000, 2000, 5000, 10000};
+	for(u32 i = 0; i < arrayEntries(sizes); i++) bench(sizes[i]);
+#endif
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,331 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares ee_snprintf() and ee_fmtNumber() with glibc snprintf() on random
+ * conversions: d/i/u/x/X/c/s with every flag combination, literal and '*'
+ * width and precision, hh/h/ll qualifiers, edge and random values and every
+ * output buffer size from 1 up to the full length. Known differences that
+ * are excluded from the comparison:
+ * - The return value is the length written, not the untruncated length.
+ * - 'l' is 32 bit like on ARM11, a NULL "%s" is "<NULL>" and "%p" has no 0x.
+ * - A negative '*' precision counts as 0 instead of being ignored.
+ * Built with AddressSanitizer as a test and without it, with FMT_BENCH, as
+ * a throughput benchmark against glibc and the original digit loop.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "types.h"
+#include "util.h"
+#include "arm11/fmt.h"
+#include "test.h"
+
+
+#define FUZZ_CONVS   (400000)
+#define BENCH_ITERS  (2000000)
+
+
+typedef enum
+{
+	ARG_INT = 0,
+	ARG_LL,
+	ARG_STR
+} ArgType;
+
+typedef struct
+{
+	char fmt[64];
+	ArgType type;
+	bool starWidth;
+	bool starPrec;
+	s32 width;
+	s32 prec;
+	s64 value;
+	const char *str;
+} Conv;
+
+
+
+ssize_t con_write(UNUSED struct _reent *r, UNUSED void *fd, UNUSED const char *ptr, size_t len)
+{
+	return len;
+}
+
+static s64 randValue(u32 *seed)
+{
+	static const s64 edges[] =
+	{
+		0, 1, -1, 9, 10, 99, 100, 999999999, 1000000000, 4294967295, 4294967296,
+		INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN, INT64_MIN + 1, 0xFFFFFFFFFFFFFFF, 0x10000000, 0x7F, 0x80, 0xFF, 0x8000
+	};
+
+	if((testRand(seed) & 3) == 0) return edges[testRand(seed) % (arrayEntries(edges))];
+
+	// Random bit length so every digit count shows up
+	const u64 v = ((u64)testRand(seed) << 32) | testRand(seed);
+	return (s64)(v >> (testRand(seed) % 64));
+}
+
+static void makeConv(Conv *c, u32 *seed)
+{
+	static const char convs[] = "diuxXcs";
+	static const char flagChars[] = "-+ #0";
+	static const char *const quals[] = {"", "", "hh", "h", "ll"};
+	static const char *const strs[] = {"", "a", "fastboot3DS", "sdmc:/boot/boot.firm"};
+	char *p = c->fmt;
+
+	const char conv = convs[testRand(seed) % (sizeof(convs) - 1)];
+	const char *qual = quals[testRand(seed) % (arrayEntries(quals))];
+	if(conv == 'c' || conv == 's') qual = "";
+
+	p += sprintf(p, "%s%%", (testRand(seed) & 1) ? "ab" : "");
+	for(u32 i = 0; i < 5; i++)
+	{
+		const char f = flagChars[i];
+		if((testRand(seed) & 3) != 0) continue;
+		if((f == '0' || f == '#' || f == '+' || f == ' ') && (conv == 'c' || conv == 's')) continue;
+		*p++ = f;
+	}
+
+	c->starWidth = c->starPrec = false;
+	c->width = c->prec = -1;
+	switch(testRand(seed) % 3)
+	{
+		case 1: c->width = testRand(seed) % 24; p += sprintf(p, "%" PRId32, c->width); break;
+		case 2: c->starWidth = true; c->width = (s32)(testRand(seed) % 49) - 24; *p++ = '*'; break;
+	}
+	if(conv != 'c')
+	{
+		switch(testRand(seed) % 3)
+		{
+			case 1: c->prec = testRand(seed) % 24; p += sprintf(p, ".%" PRId32, c->prec); break;
+			case 2: c->starPrec = true; c->prec = testRand(seed) % 24; p += sprintf(p, ".*"); break;
+		}
+	}
+
+	p += sprintf(p, "%s%c%s", qual, conv, (testRand(seed) & 1) ? " cd" : "");
+
+	c->type = (conv == 's' ? ARG_STR : (strcmp(qual, "ll") == 0 ? ARG_LL : ARG_INT));
+	c->value = randValue(seed);
+	c->str = strs[testRand(seed) % (arrayEntries(strs))];
+}
+
+#define CALL_CONV(func, buf, size, c, arg)                                                  \
+	((c)->starWidth && (c)->starPrec ? func(buf, size, (c)->fmt, (int)(c)->width, (int)(c)->prec, arg) : \
+	 (c)->starWidth ? func(buf, size, (c)->fmt, (int)(c)->width, arg) :                      \
+	 (c)->starPrec ? func(buf, size, (c)->fmt, (int)(c)->prec, arg) :                        \
+	 func(buf, size, (c)->fmt, arg))
+
+static int formatConv(bool ee, char *buf, u32 size, const Conv *c)
+{
+	if(ee)
+	{
+		switch(c->type)
+		{
+			case ARG_STR: return CALL_CONV(ee_snprintf, buf, size, c, c->str);
+			case ARG_LL:  return CALL_CONV(ee_snprintf, buf, size, c, (long long)c->value);
+			default:      return CALL_CONV(ee_snprintf, buf, size, c, (int)c->value);
+		}
+	}
+
+	switch(c->type)
+	{
+		case ARG_STR: return CALL_CONV(snprintf, buf, size, c, c->str);
+		case ARG_LL:  return CALL_CONV(snprintf, buf, size, c, (long long)c->value);
+		default:      return CALL_CONV(snprintf, buf, size, c, (int)c->value);
+	}
+}
+
+static void checkSnprintf(void)
+{
+	char expected[128], got[128];
+	u32 seed = 0xF0F0F0Fu;
+
+	for(u32 n = 0; n < FUZZ_CONVS; n++)
+	{
+		Conv c;
+		makeConv(&c, &seed);
+
+		const int full = formatConv(false, expected, sizeof(expected), &c);
+		if(full < 0 || full >= (int)sizeof(expected)) continue;
+
+		// Full buffer, then every truncated size
+		for(u32 size = full + 1; size > 0; size--)
+		{
+			// "%c" of 0 embeds a NUL so compare by length
+			formatConv(false, expected, size, &c);
+			const u32 expLen = min((u32)full, size - 1);
+			memset(got, 0x55, sizeof(got));
+			const u32 len = formatConv(true, got, size, &c);
+
+			if(len != expLen || memcmp(got, expected, expLen + 1) != 0)
+			{
+				fprintf(stderr, "\"%s\" w %" PRId32 " p %" PRId32 " value %" PRId64 " size %" PRIu32
+				        ": got \"%s\", expected \"%s\"\n", c.fmt, c.width, c.prec, c.value, size, got, expected);
+				testFailures++;
+				return;
+			}
+		}
+	}
+
+	// A few multi conversion strings like the menus use
+	char name[] = "boot.firm";
+	ee_snprintf(got, sizeof(got), "%-12s|%5" PRIu32 "|%08" PRIX32 "|%3" PRId32 "%%|%c|%llu", name, (u32)42,
+	            (u32)0xDEADBEEF, (s32)-7, 'Z', 12345678901234ULL);
+	snprintf(expected, sizeof(expected), "%-12s|%5" PRIu32 "|%08" PRIX32 "|%3" PRId32 "%%|%c|%llu", name, (u32)42,
+	         (u32)0xDEADBEEF, (s32)-7, 'Z', 12345678901234ULL);
+	TEST_CHECK(strcmp(got, expected) == 0);
+	TEST_CHECK(ee_snprintf(got, 0, "%u", 5u) == 0);
+}
+
+static void checkFmtNumber(void)
+{
+	static const char convs[] = "duxX";
+	char expected[64], got[64], fmt[32];
+	u32 seed = 0xABCDEFu;
+
+	for(u32 n = 0; n < FUZZ_CONVS / 4; n++)
+	{
+		const char conv = convs[testRand(&seed) % 4];
+		u32 flags = 0;
+		char *p = fmt;
+		*p++ = '%';
+		if(testRand(&seed) & 1) { flags |= FMT_LEFT; *p++ = '-'; }
+		if(conv == 'd' && (testRand(&seed) & 1)) { flags |= FMT_PLUS; *p++ = '+'; }
+		if(conv == 'd' && (testRand(&seed) & 1)) { flags |= FMT_SPACE; *p++ = ' '; }
+		if((conv == 'x' || conv == 'X') && (testRand(&seed) & 1)) { flags |= FMT_HEX_PREP; *p++ = '#'; }
+		if(testRand(&seed) & 1) { flags |= FMT_ZEROPAD; *p++ = '0'; }
+		const s32 width = (testRand(&seed) & 1) ? (s32)(testRand(&seed) % 24) : -1;
+		const s32 prec = (testRand(&seed) & 1) ? (s32)(testRand(&seed) % 24) : -1;
+		if(width >= 0) p += sprintf(p, "%" PRId32, width);
+		if(prec >= 0) p += sprintf(p, ".%" PRId32, prec);
+		sprintf(p, "ll%c", conv);
+
+		const FmtSpec spec = FMT_SPEC(conv, flags, width, prec);
+		const s64 value = randValue(&seed);
+		snprintf(expected, sizeof(expected), fmt, (long long)value);
+		const u32 len = ee_fmtNumber(got, sizeof(got), (u64)value, &spec);
+
+		if(strcmp(got, expected) != 0 || len != strlen(expected))
+		{
+			fprintf(stderr, "ee_fmtNumber \"%s\" value %" PRId64 ": got \"%s\", expected \"%s\"\n", fmt, value, got, expected);
+			testFailures++;
+			return;
+		}
+	}
+}
+
+#ifdef FMT_BENCH
+// The original digit loop, one 64 bit divide and modulo per digit
+static u32 oldFormatNumber(char *buf, u64 num, bool isHex)
+{
+	static const char *dig = "0123456789abcdef";
+	char tmp[20];
+	s32 i = 0;
+
+	if(num == 0) tmp[i++] = '0';
+	while(num != 0)
+	{
+		u64 base = isHex ? 16ULL : 10ULL;
+		tmp[i++] = dig[num % base];
+		num = num / base;
+	}
+
+	u32 len = 0;
+	while(i-- > 0) buf[len++] = tmp[i];
+	buf[len] = '\0';
+
+	return len;
+}
+
+static volatile u32 sink;
+
+static void benchFormat(const char *name, const char *fmt, bool u64Arg)
+{
+	char buf[64];
+	u32 seed = 0x12345u;
+
+	u64 start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		const u64 v = ((u64)testRand(&seed) << 32) | testRand(&seed);
+		sink += (u64Arg ? ee_snprintf(buf, sizeof(buf), fmt, (unsigned long long)v) : ee_snprintf(buf, sizeof(buf), fmt, (u32)v));
+	}
+	const u64 eeNs = testNowNs() - start;
+
+	seed = 0x12345u;
+	start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		const u64 v = ((u64)testRand(&seed) << 32) | testRand(&seed);
+		sink += (u64Arg ? snprintf(buf, sizeof(buf), fmt, (unsigned long long)v) : snprintf(buf, sizeof(buf), fmt, (u32)v));
+	}
+	const u64 glibcNs = testNowNs() - start;
+
+	printf("%-22s ee_snprintf %6.1f ns  glibc %6.1f ns\n", name,
+	       (double)eeNs / BENCH_ITERS, (double)glibcNs / BENCH_ITERS);
+}
+
+static void benchDigits(const char *name, bool isHex, u32 shift)
+{
+	const FmtSpec spec = FMT_SPEC(isHex ? 'x' : 'u', 0, -1, -1);
+	char buf[64];
+	u32 seed = 0x6789u;
+
+	u64 start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		const u64 v = (((u64)testRand(&seed) << 32) | testRand(&seed)) >> shift;
+		sink += oldFormatNumber(buf, v, isHex);
+	}
+	const u64 oldNs = testNowNs() - start;
+
+	seed = 0x6789u;
+	start = testNowNs();
+	for(u32 i = 0; i < BENCH_ITERS; i++)
+	{
+		const u64 v = (((u64)testRand(&seed) << 32) | testRand(&seed)) >> shift;
+		sink += ee_fmtNumber(buf, sizeof(buf), v, &spec);
+	}
+	const u64 newNs = testNowNs() - start;
+
+	printf("%-22s per digit  %6.1f ns  ee_fmtNumber %6.1f ns\n", name,
+	       (double)oldNs / BENCH_ITERS, (double)newNs / BENCH_ITERS);
+}
+#endif
+
+int main(void)
+{
+	checkSnprintf();
+	checkFmtNumber();
+
+#ifdef FMT_BENCH
+	benchDigits("32 bit decimal", false, 32);
+	benchDigits("64 bit decimal", false, 0);
+	benchDigits("32 bit hex", true, 32);
+	benchDigits("64 bit hex", true, 0);
+	benchFormat("\"%u\"", "%u", false);
+	benchFormat("\"%08X\"", "%08X", false);
+	benchFormat("\"%llu\"", "%llu", true);
+	benchFormat("\"size: %10llu bytes\"", "size: %10llu bytes", true);
+#endif
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,204 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs jobsRun() on the pthread work backend (work_host.c, 3 worker threads
+ * like a New 3DS) and checks every index is run exactly once, for even and
+ * very uneven job costs and back to back runs. Then compares
+ * splashConvertRgb888() with the original single core conversion loop and
+ * checks the single core fallback after workStopCores(). Built with
+ * ThreadSanitizer as a test and without it, with JOBS_BENCH, as a
+ * benchmark of the splash conversion on 1 core and on all 4.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "types.h"
+#include "../source/arm11/menu/splash.c"
+#include "arm11/work.h"
+#include "test.h"
+
+
+#define RUNS         (200)
+#define BENCH_ITERS  (200)
+
+
+typedef struct
+{
+	u32 *hits;
+	u32 spin; // Extra work for every 7th index
+} HitJob;
+
+
+
+u16 testRenderbufTop[SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP];
+u16 testRenderbufSub[SCREEN_WIDTH_SUB * SCREEN_HEIGHT_SUB];
+
+// Only splashConvertRgb888() runs here
+bool lz11DecompressStrided(UNUSED const void *in, UNUSED u32 inSize, UNUSED void *out, UNUSED u32 size,
+                           UNUSED u32 runSize, UNUSED u32 stride) { return false; }
+void GFX_markRenderbufDirty(UNUSED u8 screen, UNUSED s32 x, UNUSED s32 width) {}
+u32 GFX_getVblankCount(void) { return 0; }
+void consoleInvalidate(UNUSED u8 screen, UNUSED int x, UNUSED int width) {}
+void consoleFlush(void) {}
+
+static void hitJob(void *arg, u32 index)
+{
+	const HitJob *const job = (const HitJob*)arg;
+
+	if(index % 7 == 0)
+	{
+		volatile u32 sink = 0;
+		for(u32 i = 0; i < job->spin; i++) sink += i;
+	}
+	__atomic_fetch_add(&job->hits[index], 1, __ATOMIC_RELAXED);
+}
+
+static bool checkRun(u32 count, u32 spin)
+{
+	u32 *const hits = (u32*)calloc(count + 1, sizeof(u32));
+	HitJob job = {hits, spin};
+
+	jobsRun(hitJob, &job, count);
+
+	bool ok = true;
+	for(u32 i = 0; i < count; i++)
+	{
+		if(__atomic_load_n(&hits[i], __ATOMIC_RELAXED) != 1)
+		{
+			fprintf(stderr, "count %" PRIu32 " spin %" PRIu32 ": index %" PRIu32 " ran %" PRIu32 " times\n",
+			        count, spin, i, hits[i]);
+			ok = false;
+			break;
+		}
+	}
+	free(hits);
+
+	return ok;
+}
+
+// The original in place loop from the .bin splash import
+static void refConvert(u8 *const buf, u32 size)
+{
+	u8 *ptr_out = buf;
+	for(u8 *ptr_in = buf; ptr_in - buf < (int)size; ptr_in += 3, ptr_out += 2)
+	{
+		u16 rgb565 =
+			(ptr_in[2] >> 3) << (6 + 5) |
+			(ptr_in[1] >> 2) << 5 |
+			(ptr_in[0] >> 3);
+
+		ptr_out[0] = rgb565 & 0xFF;
+		ptr_out[1] = rgb565 >> 8;
+	}
+}
+
+static bool checkConvert(u32 pixels, u32 *seed)
+{
+	u8 *const in = (u8*)malloc(pixels * 3 + 1);
+	u8 *const ref = (u8*)malloc(pixels * 3 + 1);
+	u16 *const out = (u16*)malloc(pixels * 2 + 2);
+
+	for(u32 i = 0; i < pixels * 3; i++) in[i] = testRand(seed);
+	memcpy(ref, in, pixels * 3);
+	refConvert(ref, pixels * 3);
+	splashConvertRgb888(in, out, pixels);
+
+	const bool ok = memcmp(out, ref, pixels * 2) == 0;
+	free(out);
+	free(ref);
+	free(in);
+
+	return ok;
+}
+
+static void checkJobs(void)
+{
+	static const u32 counts[] = {0, 1, 2, 3, 4, 5, 7, 64, 1000, 100000};
+	u32 seed = 0x10B5u;
+
+	TEST_CHECK(workGetCoreMask() == 0xEu);
+
+	for(u32 c = 0; c < arrayEntries(counts); c++)
+	{
+		if(!TEST_CHECK(checkRun(counts[c], 0))) return;
+		if(!TEST_CHECK(checkRun(counts[c], 20000))) return;
+	}
+
+	// Back to back runs catch helpers joining the wrong run
+	for(u32 r = 0; r < RUNS; r++)
+	{
+		if(!TEST_CHECK(checkRun(1 + testRand(&seed) % 300, testRand(&seed) % 2000))) return;
+	}
+
+	TEST_CHECK(checkConvert(SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP, &seed));
+	TEST_CHECK(checkConvert(SCREEN_WIDTH_SUB * SCREEN_HEIGHT_SUB, &seed));
+	TEST_CHECK(checkConvert(1, &seed));
+	TEST_CHECK(checkConvert(CONV_JOB_PIXELS + 1, &seed));
+}
+
+#ifdef JOBS_BENCH
+static void bench(void)
+{
+	const u32 pixels = SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP;
+	u8 *const in = (u8*)malloc(pixels * 3);
+	u16 *const out = (u16*)malloc(pixels * 2);
+	u32 seed = 0xBE7C4u;
+	for(u32 i = 0; i < pixels * 3; i++) in[i] = testRand(&seed);
+
+	// The inline path jobsRun() takes without worker cores
+	ConvJob job = {in, out, pixels};
+	const u32 count = (pixels + CONV_JOB_PIXELS - 1) / CONV_JOB_PIXELS;
+	u64 start = testNowNs();
+	for(u32 n = 0; n < BENCH_ITERS; n++)
+	{
+		for(u32 i = 0; i < count; i++) convertRgb888Job(&job, i);
+	}
+	const u64 oneNs = testNowNs() - start;
+
+	start = testNowNs();
+	for(u32 n = 0; n < BENCH_ITERS; n++) splashConvertRgb888(in, out, pixels);
+	const u64 allNs = testNowNs() - start;
+
+	// Worker threads only run in parallel if the host has the CPUs for them
+	printf("400x240 splash conversion  1 core %7.1f us  4 cores %7.1f us  (%ld host CPUs)\n",
+	       (double)oneNs / BENCH_ITERS / 1000, (double)allNs / BENCH_ITERS / 1000, sysconf(_SC_NPROCESSORS_ONLN));
+
+	free(out);
+	free(in);
+}
+#endif
+
+int main(void)
+{
+	checkJobs();
+
+#ifdef JOBS_BENCH
+	bench();
+#endif
+
+	// Without worker cores everything runs inline on the caller
+	workStopCores();
+	TEST_CHECK(workGetCoreMask() == 0);
+	TEST_CHECK(checkRun(1000, 100));
+	u32 seed = 0x5EEDu;
+	TEST_CHECK(checkConvert(SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP, &seed));
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,407 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round trip and bounds tests for lz11DecompressStrided(). Streams come from
+ * a small greedy LZ11 compressor below that uses all three match encodings.
+ * Built with AddressSanitizer so any read or write outside the exact size
+ * buffers fails the test. Built without it, with LZ11_BENCH, it times the
+ * decoder against a host port of the removed asm lz11Decompress(), linear
+ * and in the old splash path of decompressing to a buffer and then copying
+ * the columns into the framebuffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "util.h"
+#include "arm11/lz11.h"
+#include "test.h"
+
+
+#define GUARD        (0xA5u)
+#define BENCH_ITERS  (50)
+#define BENCH_ROUNDS (10)
+
+
+
+// Greedy LZ11 compressor without the 4 byte header. Returns the stream size.
+static u32 lz11Compress(const u8 *in, u32 size, u8 *out)
+{
+	u32 pos = 0, outPos = 0;
+
+	while(pos < size)
+	{
+		const u32 flagsPos = outPos++;
+		out[flagsPos] = 0;
+
+		for(u32 bit = 0; bit < 8 && pos < size; bit++)
+		{
+			u32 bestLen = 0, bestDisp = 0;
+			const u32 maxLen = (size - pos < 0x10110 ? size - pos : 0x10110);
+			for(u32 disp = 1; disp <= 0x1000 && disp <= pos; disp++)
+			{
+				u32 len = 0;
+				while(len < maxLen && in[pos + len - disp] == in[pos + len]) len++;
+				if(len > bestLen)
+				{
+					bestLen = len;
+					bestDisp = disp;
+				}
+			}
+
+			if(bestLen < 3)
+			{
+				out[outPos++] = in[pos++];
+				continue;
+			}
+
+			out[flagsPos] |= 0x80u>>bit;
+			const u32 d = bestDisp - 1;
+			if(bestLen <= 0x10)
+			{
+				out[outPos++] = (bestLen - 1)<<4 | d>>8;
+			}
+			else if(bestLen <= 0x110)
+			{
+				const u32 l = bestLen - 0x11;
+				out[outPos++] = l>>4;
+				out[outPos++] = (l & 0xFu)<<4 | d>>8;
+			}
+			else
+			{
+				const u32 l = bestLen - 0x111;
+				out[outPos++] = 0x10u | l>>12;
+				out[outPos++] = l>>4;
+				out[outPos++] = (l & 0xFu)<<4 | d>>8;
+			}
+			out[outPos++] = d;
+			pos += bestLen;
+		}
+	}
+
+	return outPos;
+}
+
+// Mix of literals, short repeats, long runs and far references.
+static void makeData(u8 *buf, u32 size, u32 seed)
+{
+	u32 state = seed;
+	u32 pos = 0;
+	while(pos < size)
+	{
+		const u32 r = testRand(&state);
+		u32 len = 1 + (r>>8) % 64;
+		if(len > size - pos) len = size - pos;
+
+		switch(r & 3u)
+		{
+			case 0: // Noise
+				for(u32 i = 0; i < len; i++) buf[pos + i] = testRand(&state);
+				break;
+			case 1: // Run, sometimes very long
+				if(r & 0x100000u) len = (size - pos < 3000 ? size - pos : 3000);
+				memset(&buf[pos], r>>24, len);
+				break;
+			default: // Copy of earlier data
+				if(pos == 0)
+				{
+					buf[pos] = r;
+					len = 1;
+					break;
+				}
+				const u32 disp = 1 + testRand(&state) % (pos < 0x1000 ? pos : 0x1000);
+				for(u32 i = 0; i < len; i++) buf[pos + i] = buf[pos + i - disp];
+		}
+		pos += len;
+	}
+}
+
+// Decompresses into a strided buffer and checks runs and gaps.
+static bool checkStrided(const u8 *ref, u32 size, const u8 *comp, u32 compSize, u32 runSize, u32 stride)
+{
+	const u32 runs = (size + runSize - 1) / runSize;
+	const u32 outSize = (runs - 1) * stride + (size - (runs - 1) * runSize);
+	u8 *const out = malloc(outSize);
+	memset(out, GUARD, outSize);
+
+	bool ok = lz11DecompressStrided(comp, compSize, out, size, runSize, stride);
+	for(u32 i = 0; ok && i < outSize; i++)
+	{
+		const u32 run = i / stride, inRun = i % stride;
+		if(inRun < runSize) ok = (out[i] == ref[run * runSize + inRun]);
+		else                ok = (out[i] == GUARD);
+	}
+	free(out);
+
+	return ok;
+}
+
+static void testRoundTrip(void)
+{
+	static const u32 sizes[] = {1, 2, 3, 17, 273, 4096, 4097, 70000, 96000};
+
+	for(u32 s = 0; s < (u32)arrayEntries(sizes); s++)
+	{
+		const u32 size = sizes[s];
+		u8 *const data = malloc(size);
+		u8 *const comp = malloc(size * 9 / 8 + 16);
+		makeData(data, size, 0x1234567u + s);
+		const u32 compSize = lz11Compress(data, size, comp);
+
+		// Linear, rotated splash like (240 pixel columns), tiny odd runs and
+		// runs around the 0x1000 byte match window
+		TEST_CHECK(checkStrided(data, size, comp, compSize, size, size));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 240 * 2, 240 * 2));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 160 * 2, 240 * 2));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 7, 13));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 1, 2));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 0x1000, 0x1003));
+		TEST_CHECK(checkStrided(data, size, comp, compSize, 0x1001, 0x1003));
+
+		free(comp);
+		free(data);
+	}
+}
+
+static void testBounds(void)
+{
+	const u32 size = 5000;
+	u8 *const data = malloc(size);
+	u8 *const comp = malloc(size * 9 / 8 + 16);
+	makeData(data, size, 42);
+	const u32 compSize = lz11Compress(data, size, comp);
+
+	// Every truncated stream must fail. The exact size copy makes ASan
+	// catch reads past the end.
+	for(u32 cut = 0; cut < compSize; cut++)
+	{
+		u8 *const in = malloc(cut ? cut : 1);
+		memcpy(in, comp, cut);
+		u8 *const out = malloc(size);
+		if(!TEST_CHECK(!lz11DecompressStrided(in, cut, out, size, 64, 64)))
+			fprintf(stderr, "truncated stream of %" PRIu32 " bytes accepted\n", cut);
+		free(out);
+		free(in);
+	}
+
+	// A smaller output must never be overrun. Matches crossing the end fail.
+	for(u32 outSize = 1; outSize < size; outSize += 97)
+	{
+		u8 *const out = malloc(outSize);
+		if(lz11DecompressStrided(comp, compSize, out, outSize, outSize, outSize))
+			TEST_CHECK(memcmp(out, data, outSize) == 0);
+		free(out);
+	}
+
+	// Back reference before the start of the output
+	static const u8 badRef[] = {0x80, 0x20, 0x00};
+	u8 out[16];
+	TEST_CHECK(!lz11DecompressStrided(badRef, sizeof(badRef), out, sizeof(out), 16, 16));
+
+	// Reference one byte past what was written
+	static const u8 badRef2[] = {0x40, 'a', 0x20, 0x01};
+	TEST_CHECK(!lz11DecompressStrided(badRef2, sizeof(badRef2), out, sizeof(out), 16, 16));
+
+	// Invalid run parameters
+	TEST_CHECK(!lz11DecompressStrided(comp, compSize, out, sizeof(out), 0, 16));
+	TEST_CHECK(!lz11DecompressStrided(comp, compSize, out, sizeof(out), 16, 8));
+
+	free(comp);
+	free(data);
+}
+
+// Random garbage must never read or write out of bounds
+static void testFuzz(void)
+{
+	u32 state = 0xC0FFEEu;
+	for(u32 iter = 0; iter < 20000; iter++)
+	{
+		const u32 inSize = 1 + testRand(&state) % 64;
+		const u32 runSize = 1 + testRand(&state) % 32;
+		const u32 stride = runSize + testRand(&state) % 8;
+		const u32 size = 1 + testRand(&state) % 256;
+		const u32 runs = (size + runSize - 1) / runSize;
+		const u32 outSize = (runs - 1) * stride + (size - (runs - 1) * runSize);
+
+		u8 *const in = malloc(inSize);
+		for(u32 i = 0; i < inSize; i++) in[i] = testRand(&state);
+		u8 *const out = malloc(outSize);
+		lz11DecompressStrided(in, inSize, out, size, runSize, stride);
+		free(out);
+		free(in);
+	}
+}
+
+#ifdef LZ11_BENCH
+// Host port of the removed lz11Decompress() (lz11.s, code by mtheall). Same
+// structure: no bounds checks and halfword copies for even displacements.
+static void asmLz11Decompress(const u8 *in, u8 *out, s32 size)
+{
+	u32 flags = 0, mask = 0;
+
+	while(size > 0)
+	{
+		if(!mask)
+		{
+			flags = *in++;
+			mask = 0x80;
+		}
+		const bool isMatch = flags & mask;
+		mask >>= 1;
+
+		if(!isMatch)
+		{
+			*out++ = *in++;
+			size--;
+			continue;
+		}
+
+		u32 tmp = *in++;
+		u32 len;
+		switch(tmp & 0xF0u)
+		{
+			case 0x00:
+				len = tmp<<4;
+				tmp = *in++;
+				len = (len | tmp>>4) + 0x11;
+				break;
+			case 0x10:
+				len = (tmp & 0xFu)<<12;
+				tmp = *in++;
+				len |= tmp<<4;
+				tmp = *in++;
+				len = (len | tmp>>4) + 0x111;
+				break;
+			default:
+				len = (tmp>>4) + 1;
+		}
+		const u32 disp = ((tmp & 0xFu)<<8 | *in++) + 1;
+		size -= len;
+
+		if(disp & 1u)
+		{
+			do {*out = *(out - disp); out++;} while(--len);
+			continue;
+		}
+
+		if((uintptr_t)out & 1u)
+		{
+			*out = *(out - disp);
+			out++;
+			len--;
+		}
+		for(; len >= 2; len -= 2, out += 2)
+		{
+			u16 hword;
+			memcpy(&hword, out - disp, 2);
+			memcpy(out, &hword, 2);
+		}
+		if(len) {*out = *(out - disp); out++;}
+	}
+}
+
+// Rotated RGB565 gradient with noise in the low bits, like a photo
+static void makeImage(u8 *buf, u32 width, u32 height)
+{
+	u32 state = 0x1234u;
+	u16 *const px = (u16*)buf;
+	for(u32 x = 0; x < width; x++)
+	{
+		for(u32 y = 0; y < height; y++)
+		{
+			const u32 noise = testRand(&state);
+			px[x * height + y] = (x * 31 / width)<<11 | (y * 63 / height)<<5 | ((noise & 1u) ? (noise>>8) % 4 : 0);
+		}
+	}
+}
+
+static void bench(const char *name, bool photo)
+{
+	// A 320x200 RGB565 splash, rotated, centered on the 240 pixel high top screen
+	const u32 width = 320, height = 200, screenHeight = 240;
+	const u32 size = width * height * 2;
+	u8 *const data = malloc(size);
+	u8 *const comp = malloc(size * 9 / 8 + 16);
+	u8 *const tmp = malloc(size);
+	u8 *const fb = malloc(width * screenHeight * 2);
+	if(photo) makeImage(data, width, height);
+	else makeData(data, size, 0x5A1A5Au);
+	const u32 compSize = lz11Compress(data, size, comp);
+
+	// Check the port before trusting its numbers
+	asmLz11Decompress(comp, tmp, size);
+	TEST_CHECK(memcmp(tmp, data, size) == 0);
+
+	// Best of several interleaved rounds. Host timings are noisy.
+	u64 asmNs = UINT64_MAX, linearNs = UINT64_MAX, oldSplashNs = UINT64_MAX, newSplashNs = UINT64_MAX;
+	for(u32 r = 0; r < BENCH_ROUNDS; r++)
+	{
+		u64 start = testNowNs();
+		for(u32 i = 0; i < BENCH_ITERS; i++) asmLz11Decompress(comp, tmp, size);
+		u64 ns = testNowNs() - start;
+		if(ns < asmNs) asmNs = ns;
+
+		start = testNowNs();
+		for(u32 i = 0; i < BENCH_ITERS; i++) lz11DecompressStrided(comp, compSize, tmp, size, size, size);
+		ns = testNowNs() - start;
+		if(ns < linearNs) linearNs = ns;
+
+		start = testNowNs();
+		for(u32 i = 0; i < BENCH_ITERS; i++)
+		{
+			asmLz11Decompress(comp, tmp, size);
+			for(u32 x = 0; x < width; x++)
+				memcpy(&fb[x * screenHeight * 2], &tmp[x * height * 2], height * 2);
+		}
+		ns = testNowNs() - start;
+		if(ns < oldSplashNs) oldSplashNs = ns;
+
+		start = testNowNs();
+		for(u32 i = 0; i < BENCH_ITERS; i++)
+			lz11DecompressStrided(comp, compSize, fb, size, height * 2, screenHeight * 2);
+		ns = testNowNs() - start;
+		if(ns < newSplashNs) newSplashNs = ns;
+	}
+
+	printf("%s: %" PRIu32 " bytes, %" PRIu32 " compressed\n", name, size, compSize);
+	printf("  linear  asm port %7.1f us                C strided %7.1f us\n",
+	       (double)asmNs / BENCH_ITERS / 1000, (double)linearNs / BENCH_ITERS / 1000);
+	printf("  splash  asm port + column copy %7.1f us  C strided into fb %7.1f us\n",
+	       (double)oldSplashNs / BENCH_ITERS / 1000, (double)newSplashNs / BENCH_ITERS / 1000);
+
+	free(fb);
+	free(tmp);
+	free(comp);
+	free(data);
+}
+#endif
+
+int main(void)
+{
+	testRoundTrip();
+	testBounds();
+	testFuzz();
+
+#ifdef LZ11_BENCH
+	bench("Flat art", false);
+	bench("Photo", true);
+#endif
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host stand-in for the GFX header. Keeps all real definitions but moves
+// the render buffers out of VRAM into arrays provided by the test.
+
+#include_next "hardware/gfx.h"
+
+extern u16 testRenderbufTop[SCREEN_WIDTH_TOP * SCREEN_HEIGHT_TOP];
+extern u16 testRenderbufSub[SCREEN_WIDTH_SUB * SCREEN_HEIGHT_SUB];
+
+#undef RENDERBUF_TOP
+#undef RENDERBUF_SUB
+#define RENDERBUF_TOP  ((uintptr_t)testRenderbufTop)
+#define RENDERBUF_SUB  ((uintptr_t)testRenderbufSub)
@@ -0,0 +1,64 @@
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "fb_assert.h"
+#include "test.h"
+
+
+u32 testFailures = 0;
+
+
+
+noreturn void __fb_assert(const char *const str, u32 line)
+{
+	fprintf(stderr, "Assertion failed: %s:%" PRIu32 "\n", str, line);
+	abort();
+}
+
+void testHex(u8 *out, const char *hex)
+{
+	const size_t len = strlen(hex) / 2;
+	for(size_t i = 0; i < len; i++)
+	{
+		unsigned int byte;
+		sscanf(&hex[i * 2], "%2x", &byte);
+		out[i] = (u8)byte;
+	}
+}
+
+u64 testNowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+u32 testRand(u32 *state)
+{
+	u32 x = *state;
+	x ^= x<<13;
+	x ^= x>>17;
+	x ^= x<<5;
+	*state = x;
+
+	return x;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ *   This file is part of fastboot 3DS
+ *   Copyright (C) 2017 derrek, profi200
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Minimal helpers shared by the host tests and benchmarks in this directory.
+ * Every test is a standalone program returning 0 on success.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "types.h"
+
+
+extern u32 testFailures;
+
+#define TEST_CHECK(cond)                                                     \
+({                                                                           \
+	const bool __ok = (cond);                                                \
+	if(!__ok)                                                                \
+	{                                                                        \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		testFailures++;                                                      \
+	}                                                                        \
+	__ok;                                                                    \
+})
+
+#define TEST_RESULT()                                                        \
+({                                                                           \
+	if(testFailures) fprintf(stderr, "%" PRIu32 " check(s) failed\n", testFailures); \
+	(testFailures ? 1 : 0);                                                  \
+})
+
+
+/**
+ * @brief      Parses a hex string into bytes.
+ *
+ * @param      out   The output buffer. Must hold strlen(hex) / 2 bytes.
+ * @param[in]  hex   The hex string.
+ */
+void testHex(u8 *out, const char *hex);
+
+/**
+ * @brief      Returns a monotonic timestamp in nanoseconds for benchmarks.
+ */
+u64 testNowNs(void);
+
+/**
+ * @brief      Deterministic xorshift PRNG so fuzz runs are reproducible.
+ *
+ * @param      state  The PRNG state. Must not be 0.
+ *
+ * @return     The next random value.
+ */
+u32 testRand(u32 *state);
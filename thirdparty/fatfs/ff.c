@@ -21,6 +21,7 @@
 
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of device I/O functions */
+#include "perf.h"		/* Sector window hit/miss counters */
 
 
 /*--------------------------------------------------------------------------
@@ -1070,6 +1071,7 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	if (sector != fs->winsect) {	/* Window offset changed? */
+		PERF_COUNT(fatfsMisses, 1);
 #if !FF_FS_READONLY
 		res = sync_window(fs);		/* Write-back changes */
 #endif
@@ -1080,6 +1082,8 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 			}
 			fs->winsect = sector;
 		}
+	} else {
+		PERF_COUNT(fatfsHits, 1);
 	}
 	return res;
 }